@@ -19,6 +19,9 @@
 #include "config.h"
 
 #include <stdio.h>
+
+#include <algorithm>
+
 #include "configfile.h"
 #include "entrytracker.h"
 #include "messagebus.h"
@@ -26,7 +29,8 @@
 
 #include "adsb_icao.h"
 
-kis_adsb_icao::kis_adsb_icao() {
+kis_adsb_icao::kis_adsb_icao() :
+    zmfile{nullptr} {
     mutex.set_name("kis_adsb_icao");
 
     auto entrytracker = Globalreg::fetch_mandatory_global_as<entry_tracker>();
@@ -82,16 +86,45 @@ kis_adsb_icao::kis_adsb_icao() {
         return;
     }
 
-    auto fname = 
-        Globalreg::globalreg->kismet_config->fetch_opt_dfl("icaofile", 
-                "%S/kismet/kismet_adsb_icao.txt.gz");
+    auto fnames = Globalreg::globalreg->kismet_config->fetch_opt_vec("icaofile");
+
+    if (fnames.size() == 0)
+        fnames.push_back("%S/kismet/kismet_adsb_icao.txt.gz");
+
+    // Files which don't exist are only worth mentioning if nothing else opens; the
+    // prebuilt table is listed first but is only installed when python is available
+    std::vector<std::string> missing;
+
+    for (const auto& f : fnames) {
+        auto expanded =
+            Globalreg::globalreg->kismet_config->expand_log_path(f, "", "", 0, 1);
+
+        // Prebuilt tables are searched in place and need no indexing
+        if (kis_lookup_db::is_lookup_db(expanded)) {
+            if (icao_db.open(expanded, "ICAO", 5)) {
+                _MSG_INFO("Opened ADSB ICAO table {}, {} records", expanded, icao_db.size());
+                return;
+            }
+
+            continue;
+        }
+
+        if ((zmfile = gzopen(expanded.c_str(), "r")) != nullptr)
+            break;
+
+        if (errno == ENOENT) {
+            missing.push_back(expanded);
+            continue;
+        }
+
+        _MSG_INFO("Could not open ICAO database {}: {}", expanded, kis_strerror_r(errno));
+    }
 
-    auto expanded =
-        Globalreg::globalreg->kismet_config->expand_log_path(fname, "", "", 0, 1);
+    if (zmfile == nullptr) {
+        for (const auto& m : missing)
+            _MSG_INFO("Could not open ICAO database {}: {}", m, kis_strerror_r(ENOENT));
 
-    if ((zmfile = gzopen(expanded.c_str(), "r")) == nullptr) {
-        _MSG_ERROR("Could not open ICAO database {}, ADSB ICAO lookup will not be available.",
-                expanded);
+        _MSG_ERROR("No ICAO databases were available, ADSB ICAO lookup will not be available.");
         return;
     }
 
@@ -158,11 +191,34 @@ void kis_adsb_icao::index() {
             line, index_vec.size());
 }
 
+std::shared_ptr<tracked_adsb_icao> kis_adsb_icao::make_icao_record(uint32_t icao,
+        const std::string& regid, const std::string& model_type, const std::string& model,
+        const std::string& owner, char atype) {
+    auto icao_rec = std::make_shared<tracked_adsb_icao>(icao_id);
+    icao_rec->set_icao(icao);
+    icao_rec->set_regid(munge_to_printable(regid));
+    icao_rec->set_model_type(munge_to_printable(model_type));
+    icao_rec->set_model(munge_to_printable(model));
+    icao_rec->set_owner(munge_to_printable(owner));
+
+    auto atype_l = atype_map.find(atype);
+
+    if (atype_l == atype_map.end()) {
+        icao_rec->set_atype(atype_map['U']);
+        icao_rec->set_atype_short('U');
+    } else {
+        icao_rec->set_atype(atype_l->second);
+        icao_rec->set_atype_short(atype);
+    }
+
+    return icao_rec;
+}
+
 std::shared_ptr<tracked_adsb_icao> kis_adsb_icao::lookup_icao(uint32_t icao) {
     int matched = -1;
     char buf[2048];
 
-    if (zmfile == nullptr) {
+    if (zmfile == nullptr && !icao_db.is_open()) {
         return unknown_icao;
     }
 
@@ -172,86 +228,79 @@ std::shared_ptr<tracked_adsb_icao> kis_adsb_icao::lookup_icao(uint32_t icao) {
         auto cached = icao_map.find(icao);
         if (cached != icao_map.end())
             return cached->second;
+    }
 
-        for (unsigned int x = 0; x < index_vec.size(); x++) {
-            if (icao > index_vec[x].icao) {
-                matched = x;
-                continue;
-            }
+    // The prebuilt table is read-only and needs no locking to search
+    if (icao_db.is_open()) {
+        auto icao_rec = unknown_icao;
+        auto rec = icao_db.find(icao);
 
-            break;
-        }
+        if (rec != nullptr)
+            icao_rec = make_icao_record(icao, icao_db.field(rec, 0), icao_db.field(rec, 1),
+                    icao_db.field(rec, 2), icao_db.field(rec, 3), icao_db.field(rec, 4)[0]);
 
-        if (matched < 0) {
-            icao_map[icao] = unknown_icao;
-            return unknown_icao;
-        }
+        local_locker l(&mutex, "icao table lookup");
+        icao_map[icao] = icao_rec;
+        return icao_rec;
+    }
+
+    local_locker l(&mutex, "icao file lookup");
+
+    if (zmfile == nullptr)
+        return unknown_icao;
 
-        if (matched > 0)
-            matched -= 1;
+    auto ii = std::lower_bound(index_vec.begin(), index_vec.end(), icao,
+            [](const index_pos& ip, uint32_t i) { return ip.icao < i; });
+    matched = (int) (ii - index_vec.begin()) - 1;
+
+    if (matched < 0) {
+        icao_map[icao] = unknown_icao;
+        return unknown_icao;
     }
 
-    {
-        local_locker l(&mutex, "icao file lookup");
+    if (matched > 0)
+        matched -= 1;
 
-        gzseek(zmfile, index_vec[matched].pos, SEEK_SET);
-    
-        while (!gzeof(zmfile)) {
-            if (gzgets(zmfile, buf, 2048) == NULL || gzeof(zmfile))
-                break;
+    gzseek(zmfile, index_vec[matched].pos, SEEK_SET);
 
-            if (buf[0] == '#') {
-                continue;
-            }
+    while (!gzeof(zmfile)) {
+        if (gzgets(zmfile, buf, 2048) == NULL || gzeof(zmfile))
+            break;
 
-            auto fields = quote_str_tokenize(buf, "\t");
+        if (buf[0] == '#') {
+            continue;
+        }
 
-            if (fields.size() != 6) {
+        auto fields = quote_str_tokenize(buf, "\t");
+
+        if (fields.size() != 6) {
+            _MSG_ERROR("Invalid ICAO entry: '{}'", buf);
+            gzclose(zmfile);
+            zmfile = nullptr;
+            return unknown_icao;
+        }
+
+        auto f_icao = string_to_n<uint32_t>(fields[0], std::hex);
+
+        if (f_icao == icao) {
+            if (fields[5].length() == 0) {
                 _MSG_ERROR("Invalid ICAO entry: '{}'", buf);
                 gzclose(zmfile);
                 zmfile = nullptr;
                 return unknown_icao;
             }
 
-            auto f_icao = string_to_n<uint32_t>(fields[0], std::hex);
-
-            if (f_icao == icao) {
-                if (fields[5].length() == 0) {
-                    _MSG_ERROR("Invalid ICAO entry: '{}'", buf);
-                    gzclose(zmfile);
-                    zmfile = nullptr;
-                    return unknown_icao;
-                }
-
-                auto icao_rec = 
-                    std::make_shared<tracked_adsb_icao>(icao_id);
-                icao_rec->set_icao(icao);
-                icao_rec->set_regid(munge_to_printable(fields[1]));
-                icao_rec->set_model_type(munge_to_printable(fields[2]));
-                icao_rec->set_model(munge_to_printable(fields[3]));
-                icao_rec->set_owner(munge_to_printable(fields[4]));
-
-                auto atype_l = atype_map.find(fields[5][0]);
-
-                if (atype_l == atype_map.end()) {
-                    icao_rec->set_atype(atype_map['U']);
-                    icao_rec->set_atype_short('U');
-                } else {
-                    icao_rec->set_atype(atype_l->second);
-                    icao_rec->set_atype_short(fields[5][0]);
-                }
-
-                icao_map[icao] = icao_rec;
-                return icao_rec;
-            } else if (f_icao > icao) {
-                icao_map[icao] = unknown_icao;
-                return unknown_icao;
-            }
+            auto icao_rec = make_icao_record(icao, fields[1], fields[2], fields[3],
+                    fields[4], fields[5][0]);
+
+            icao_map[icao] = icao_rec;
+            return icao_rec;
+        } else if (f_icao > icao) {
+            icao_map[icao] = unknown_icao;
+            return unknown_icao;
         }
     }
 
     return unknown_icao;
 }
 
-
-
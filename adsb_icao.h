@@ -39,6 +39,7 @@
 #include "util.h"
 #include "globalregistry.h"
 
+#include "kis_lookup_db.h"
 #include "robin_hood.h"
 #include "trackedelement.h"
 #include "trackedcomponent.h"
@@ -143,11 +144,18 @@ public:
     };
 
 protected:
+    std::shared_ptr<tracked_adsb_icao> make_icao_record(uint32_t icao, const std::string& regid,
+            const std::string& model_type, const std::string& model, const std::string& owner,
+            char atype);
+
     kis_recursive_timed_mutex mutex;
     std::map<char, std::shared_ptr<tracker_element_string>> atype_map;
 
     gzFile zmfile;
 
+    // Prebuilt table, used instead of the text file when available
+    kis_lookup_db icao_db;
+
     int icao_id;
     int icao_type_id;
     std::shared_ptr<tracked_adsb_icao> unknown_icao;
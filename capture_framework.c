@@ -34,6 +34,8 @@
 #include <sys/wait.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #ifdef HAVE_CAPABILITY
 #include <sys/capability.h>
@@ -368,6 +370,20 @@ kis_capture_handler_t *cf_handler_init(const char *in_type) {
     ch->out_fd = -1;
     ch->tcp_fd = -1;
 
+    ch->shm_fd = -1;
+    ch->shm_event_fd = -1;
+    ch->shm_ring = NULL;
+    ch->shm_ring_sz = 0;
+    ch->shm_head = 0;
+    ch->shm_ipc_sent = 0;
+    pthread_mutex_init(&(ch->shm_lock), NULL);
+
+    ch->batch_data = 0;
+    ch->batch_buf = NULL;
+    ch->batch_buf_used = 0;
+    ch->batch_num = 0;
+    pthread_mutex_init(&(ch->batch_lock), NULL);
+
     /* Disable retry by default */
     ch->remote_retry = 0;
 
@@ -465,6 +481,18 @@ void cf_handler_free(kis_capture_handler_t *caph) {
     if (caph->tcp_fd >= 0)
         close(caph->tcp_fd);
 
+    if (caph->shm_ring != NULL)
+        munmap(caph->shm_ring, caph->shm_ring_sz);
+
+    if (caph->shm_fd >= 0)
+        close(caph->shm_fd);
+
+    if (caph->shm_event_fd >= 0)
+        close(caph->shm_event_fd);
+
+    if (caph->batch_buf != NULL)
+        free(caph->batch_buf);
+
     if (caph->in_ringbuf != NULL)
         kis_simple_ringbuf_free(caph->in_ringbuf);
 
@@ -500,6 +528,8 @@ void cf_handler_free(kis_capture_handler_t *caph) {
 
     pthread_mutex_destroy(&(caph->out_ringbuf_lock));
     pthread_mutex_destroy(&(caph->handler_lock));
+    pthread_mutex_destroy(&(caph->shm_lock));
+    pthread_mutex_destroy(&(caph->batch_lock));
 }
 
 cf_params_interface_t *cf_params_interface_new() {
@@ -722,6 +752,43 @@ void cf_handler_list_devices(kis_capture_handler_t *caph) {
     }
 }
 
+/* Map the shared-memory packet ring offered by the server; if anything about it is
+ * wrong we simply keep using the IPC channel */
+static void cf_map_shm_ring(kis_capture_handler_t *caph) {
+    struct stat sb;
+    void *m;
+    kis_shm_ring_header_t *ring;
+
+    if (fstat(caph->shm_fd, &sb) < 0 || (size_t) sb.st_size < sizeof(kis_shm_ring_header_t)) {
+        fprintf(stderr, "WARNING: Unable to use shared memory packet ring, sending "
+                "packets over IPC\n");
+        return;
+    }
+
+    m = mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, caph->shm_fd, 0);
+
+    if (m == MAP_FAILED) {
+        fprintf(stderr, "WARNING: Unable to map shared memory packet ring (%s), sending "
+                "packets over IPC\n", strerror(errno));
+        return;
+    }
+
+    ring = (kis_shm_ring_header_t *) m;
+
+    if (__atomic_load_n(&(ring->magic), __ATOMIC_ACQUIRE) != KIS_SHM_RING_MAGIC ||
+            ring->version != KIS_SHM_RING_VERSION || ring->num_slots == 0 ||
+            ring->slot_sz <= sizeof(kis_shm_ring_slot_t) ||
+            kis_shm_ring_size(ring->num_slots, ring->slot_sz) > (size_t) sb.st_size) {
+        fprintf(stderr, "WARNING: Unexpected shared memory packet ring format, sending "
+                "packets over IPC\n");
+        munmap(m, sb.st_size);
+        return;
+    }
+
+    caph->shm_ring = ring;
+    caph->shm_ring_sz = sb.st_size;
+}
+
 int cf_handler_parse_opts(kis_capture_handler_t *caph, int argc, char *argv[]) {
     int option_idx;
 
@@ -755,6 +822,8 @@ int cf_handler_parse_opts(kis_capture_handler_t *caph, int argc, char *argv[]) {
         { "apikey", required_argument, 0, 16},
         { "endpoint", required_argument, 0, 17},
         { "ssl-certificate", required_argument, 0, 18},
+        { "shm-fd", required_argument, 0, 19},
+        { "shm-event-fd", required_argument, 0, 20},
         { "help", no_argument, 0, 'h'},
         { 0, 0, 0, 0 }
     };
@@ -886,6 +955,18 @@ int cf_handler_parse_opts(kis_capture_handler_t *caph, int argc, char *argv[]) {
             return -1;
             goto cleanup;
 #endif
+        } else if (r == 19) {
+            if (sscanf(optarg, "%d", &(caph->shm_fd)) != 1) {
+                fprintf(stderr, "FATAL: Unable to parse shared memory file descriptor\n");
+                ret = -1;
+                goto cleanup;
+            }
+        } else if (r == 20) {
+            if (sscanf(optarg, "%d", &(caph->shm_event_fd)) != 1) {
+                fprintf(stderr, "FATAL: Unable to parse shared memory event descriptor\n");
+                ret = -1;
+                goto cleanup;
+            }
         } 
     }
 
@@ -1011,6 +1092,9 @@ int cf_handler_parse_opts(kis_capture_handler_t *caph, int argc, char *argv[]) {
         goto cleanup;
     }
 
+    if (caph->shm_fd >= 0 && caph->shm_event_fd >= 0)
+        cf_map_shm_ring(caph);
+
 cleanup:
     if (gps_arg != NULL)
         free(gps_arg);
@@ -1643,6 +1727,9 @@ int cf_handle_rx_content(kis_capture_handler_t *caph, const uint8_t *buffer, siz
                 goto finish;
             }
             
+            /* Newer servers accept batched data reports */
+            caph->batch_data = open_cmd->has_batch_data && open_cmd->batch_data;
+
             msgstr[0] = 0;
             cbret = (*(caph->open_cb))(caph,
                     kds_cmd->seqno, open_cmd->definition,
@@ -2254,6 +2341,8 @@ static void ws_destroy_msg(void *in_msg) {
 }
 #endif
 
+static int cf_flush_data_aged(kis_capture_handler_t *caph, int force);
+
 int cf_handler_loop(kis_capture_handler_t *caph) {
     fd_set rset, wset;
     int max_fd;
@@ -2325,6 +2414,13 @@ int cf_handler_loop(kis_capture_handler_t *caph) {
 
             pthread_mutex_unlock(&(caph->handler_lock));
 
+            /* Send a packet batch which has waited long enough, or anything still 
+             * queued if we're spinning down */
+            if (cf_flush_data_aged(caph, spindown) < 0) {
+                rv = -1;
+                break;
+            }
+
             max_fd = 0;
 
             /* Only set read sets if we're not spinning down */
@@ -2352,6 +2448,12 @@ int cf_handler_loop(kis_capture_handler_t *caph) {
             tm.tv_sec = 0;
             tm.tv_usec = 500000;
 
+            /* Wake up in time to send a pending packet batch */
+            pthread_mutex_lock(&(caph->batch_lock));
+            if (caph->batch_num != 0)
+                tm.tv_usec = CF_BATCH_MAX_USEC;
+            pthread_mutex_unlock(&(caph->batch_lock));
+
             if ((ret = select(max_fd + 1, &rset, &wset, NULL, &tm)) < 0) {
                 if (errno != EINTR && errno != EAGAIN) {
                     fprintf(stderr, "FATAL:  Error during select(): %s\n", strerror(errno));
@@ -2486,9 +2588,13 @@ int cf_handler_loop(kis_capture_handler_t *caph) {
 
         ret = 0;
 
-        while (ret >= 0 && !caph->shutdown)
+        while (ret >= 0 && !caph->shutdown) {
             lws_service(caph->lwscontext, 0);
 
+            if (cf_flush_data_aged(caph, 0) < 0)
+                break;
+        }
+
 #endif
     } else {
         fprintf(stderr, "FATAL:  Could not determine mode?\n");
@@ -2719,6 +2825,7 @@ int cf_send_ws_packet(kis_capture_handler_t *caph, KismetExternal__Command *cmd,
 int cf_send_packet(kis_capture_handler_t *caph, const char *packtype, uint8_t *data, size_t len) {
     uint32_t seqno;
     KismetExternal__Command cmd;
+    int r;
 
     kismet_external__command__init(&cmd);
 
@@ -2735,15 +2842,24 @@ int cf_send_packet(kis_capture_handler_t *caph, const char *packtype, uint8_t *d
     cmd.content.len = len;
 
     if (caph->use_tcp || caph->use_ipc) {
-        return cf_send_rb_packet(caph, &cmd, data, len);
+        r = cf_send_rb_packet(caph, &cmd, data, len);
 #ifdef HAVE_LIBWEBSOCKETS
     } else if (caph->use_ws) {
-        return cf_send_ws_packet(caph, &cmd, data, len);
+        r = cf_send_ws_packet(caph, &cmd, data, len);
 #endif
     } else {
         fprintf(stderr, "ERROR:  cf_send_packet with unknown connection type\n");
         return -1;
     }
+
+    /* The server counts the data reports it has handled in the shared-memory ring,
+     * so we can tell when it has caught up with the pipe */
+    if (r > 0 && caph->shm_ring != NULL &&
+            (strcmp(packtype, "KDSDATAREPORT") == 0 || 
+             strcmp(packtype, "KDSDATAREPORTBATCH") == 0))
+        __atomic_add_fetch(&(caph->shm_ipc_sent), 1, __ATOMIC_RELEASE);
+
+    return r;
 }
 
 int cf_send_message(kis_capture_handler_t *caph, const char *msg, unsigned int flags) {
@@ -3172,7 +3288,167 @@ int cf_send_openresp(kis_capture_handler_t *caph, uint32_t seq, unsigned int suc
     return cf_send_packet(caph, "KDSOPENSOURCEREPORT", buf, buf_len);
 }
 
-int cf_send_data(kis_capture_handler_t *caph,
+/* Send the pending packet batch; batch_lock must be held */
+static int cf_flush_data_locked(kis_capture_handler_t *caph) {
+    KismetDatasource__DataReportBatch kebatch;
+    KismetDatasource__SubGps kegps;
+    uint8_t *buf;
+    size_t buf_len;
+    int r;
+
+    if (caph->batch_num == 0)
+        return 1;
+
+    kismet_datasource__data_report_batch__init(&kebatch);
+    kismet_datasource__sub_gps__init(&kegps);
+
+    kebatch.n_packets = caph->batch_num;
+    kebatch.packets = caph->batch_packet_ptrs;
+
+    if (caph->gps_fixed_lat != 0) {
+        struct timeval tv;
+
+        kegps.lat = caph->gps_fixed_lat;
+        kegps.lon = caph->gps_fixed_lon;
+        kegps.alt = caph->gps_fixed_alt;
+        kegps.fix = 3;
+
+        gettimeofday(&tv, NULL);
+        kegps.time_sec = tv.tv_sec;
+        kegps.time_usec = tv.tv_usec;
+
+        kegps.type = strdup("remote-fixed");
+
+        if (caph->gps_name != NULL)
+            kegps.name = strdup(caph->gps_name);
+        else
+            kegps.name = strdup("remote-fixed");
+
+        kebatch.gps = &kegps;
+    }
+
+    buf_len = kismet_datasource__data_report_batch__get_packed_size(&kebatch);
+    buf = (uint8_t *) malloc(buf_len);
+
+    if (buf == NULL) {
+        r = -1;
+    } else {
+        kismet_datasource__data_report_batch__pack(&kebatch, buf);
+        r = cf_send_packet(caph, "KDSDATAREPORTBATCH", buf, buf_len);
+    }
+
+    if (kegps.name != NULL)
+        free(kegps.name);
+    if (kegps.type != NULL)
+        free(kegps.type);
+
+    /* Keep the batch to try again if there wasn't room */
+    if (r != 0) {
+        caph->batch_num = 0;
+        caph->batch_buf_used = 0;
+    }
+
+    return r < 0 ? -1 : r;
+}
+
+int cf_flush_data(kis_capture_handler_t *caph) {
+    int r;
+
+    pthread_mutex_lock(&(caph->batch_lock));
+    r = cf_flush_data_locked(caph);
+    pthread_mutex_unlock(&(caph->batch_lock));
+
+    return r;
+}
+
+/* Has the oldest packet in the batch waited long enough?  batch_lock must be held */
+static int cf_batch_aged(kis_capture_handler_t *caph) {
+    struct timeval now, age;
+
+    gettimeofday(&now, NULL);
+    timersub(&now, &(caph->batch_start), &age);
+
+    return age.tv_sec > 0 || age.tv_usec >= CF_BATCH_MAX_USEC;
+}
+
+/* Called from the IO loop to send a batch which has aged out, or any batch when
+ * we're spinning down */
+static int cf_flush_data_aged(kis_capture_handler_t *caph, int force) {
+    int r = 1;
+
+    pthread_mutex_lock(&(caph->batch_lock));
+
+    if (caph->batch_num != 0 && (force || cf_batch_aged(caph)))
+        r = cf_flush_data_locked(caph);
+
+    pthread_mutex_unlock(&(caph->batch_lock));
+
+    return r;
+}
+
+/* Queue a packet in the batch, sending the batch if it fills */
+static int cf_batch_data(kis_capture_handler_t *caph, struct timeval ts,
+        uint32_t dlt, uint32_t packet_sz, uint8_t *pack) {
+    KismetDatasource__SubPacket *kepkt;
+    int r;
+
+    pthread_mutex_lock(&(caph->batch_lock));
+
+    /* Make room; if the batch can't go out yet, the caller retries this packet */
+    if (caph->batch_num == CF_BATCH_MAX_PACKETS ||
+            caph->batch_buf_used + packet_sz > CF_BATCH_MAX_BYTES) {
+        if ((r = cf_flush_data_locked(caph)) != 1) {
+            pthread_mutex_unlock(&(caph->batch_lock));
+            return r;
+        }
+    }
+
+    if (caph->batch_buf == NULL) {
+        caph->batch_buf = (uint8_t *) malloc(CF_BATCH_MAX_BYTES);
+
+        if (caph->batch_buf == NULL) {
+            pthread_mutex_unlock(&(caph->batch_lock));
+            return -1;
+        }
+    }
+
+    if (caph->batch_num == 0)
+        gettimeofday(&(caph->batch_start), NULL);
+
+    memcpy(caph->batch_buf + caph->batch_buf_used, pack, packet_sz);
+
+    kepkt = &(caph->batch_packets[caph->batch_num]);
+    kismet_datasource__sub_packet__init(kepkt);
+
+    kepkt->time_sec = ts.tv_sec;
+    kepkt->time_usec = ts.tv_usec;
+    kepkt->dlt = dlt;
+    kepkt->size = packet_sz;
+    kepkt->data.len = packet_sz;
+    kepkt->data.data = caph->batch_buf + caph->batch_buf_used;
+
+    caph->batch_packet_ptrs[caph->batch_num] = kepkt;
+
+    caph->batch_num++;
+    caph->batch_buf_used += packet_sz;
+
+    /* The packet is queued either way; a full batch which doesn't fit in the 
+     * output buffer yet is retried later */
+    r = 1;
+
+    if (caph->batch_num == CF_BATCH_MAX_PACKETS || 
+            caph->batch_buf_used == CF_BATCH_MAX_BYTES || cf_batch_aged(caph)) {
+        if (cf_flush_data_locked(caph) < 0)
+            r = -1;
+    }
+
+    pthread_mutex_unlock(&(caph->batch_lock));
+
+    return r;
+}
+
+/* Send a packet over the IPC channel, batching it if we can */
+static int cf_send_data_ipc(kis_capture_handler_t *caph,
         KismetExternal__MsgbusMessage *kv_message,
         KismetDatasource__SubSignal *kv_signal,
         KismetDatasource__SubGps *kv_gps,
@@ -3186,6 +3462,18 @@ int cf_send_data(kis_capture_handler_t *caph,
     kismet_datasource__sub_packet__init(&kepkt);
     kismet_datasource__sub_gps__init(&kegps);
 
+    int r;
+
+    if (caph->batch_data && packet_sz > 0 && pack != NULL) {
+        if (kv_message == NULL && kv_signal == NULL && kv_gps == NULL &&
+                packet_sz <= CF_BATCH_MAX_BYTES)
+            return cf_batch_data(caph, ts, dlt, packet_sz, pack);
+
+        /* Keep packets in order behind anything already queued */
+        if ((r = cf_flush_data(caph)) != 1)
+            return r;
+    }
+
     kedata.signal = kv_signal;
     kedata.message = kv_message;
 
@@ -3244,6 +3532,127 @@ int cf_send_data(kis_capture_handler_t *caph,
     return cf_send_packet(caph, "KDSDATAREPORT", buf, buf_len);
 }
 
+/* Has the server handled every data report we've sent over the IPC channel?  A
+ * pending batch hasn't been sent at all yet; send it now instead of leaving the
+ * ring waiting for it to age out */
+static int cf_shm_ipc_idle(kis_capture_handler_t *caph) {
+    if (cf_flush_data(caph) != 1)
+        return 0;
+
+    return __atomic_load_n(&(caph->shm_ipc_sent), __ATOMIC_ACQUIRE) ==
+        __atomic_load_n(&(caph->shm_ring->ipc_consumed), __ATOMIC_ACQUIRE);
+}
+
+/* Has the server taken every frame out of the ring?  It frees slots in order, so
+ * only the last slot we filled needs to be checked; shm_lock must be held */
+static int cf_shm_ring_idle(kis_capture_handler_t *caph) {
+    uint32_t last = (caph->shm_head + caph->shm_ring->num_slots - 1) % 
+        caph->shm_ring->num_slots;
+
+    return kis_shm_ring_slot_state(kis_shm_ring_slot(caph->shm_ring, last)) == 
+        KIS_SHM_SLOT_FREE;
+}
+
+/* Has the next slot been freed?  shm_lock must be held */
+static int cf_shm_slot_free(kis_capture_handler_t *caph) {
+    return kis_shm_ring_slot_state(kis_shm_ring_slot(caph->shm_ring, caph->shm_head)) == 
+        KIS_SHM_SLOT_FREE;
+}
+
+/* Wait for the server to catch up with the ring or the IPC channel; shm_lock must be
+ * held.  Returns 0 if we're shutting down instead */
+static int cf_shm_wait(kis_capture_handler_t *caph, int (*idle)(kis_capture_handler_t *)) {
+    while (!idle(caph)) {
+        if (caph->spindown || caph->shutdown)
+            return 0;
+
+        usleep(CF_SHM_WAIT_USEC);
+    }
+
+    return 1;
+}
+
+/* Send a packet while the shared-memory ring is in use.  The server reads the ring
+ * and the IPC channel on different threads, so packets are only outstanding on one
+ * of them at a time:  a packet which can use the ring waits for the server to handle
+ * everything sent over the IPC channel, and one which can't waits for the ring to
+ * drain.  Waits hold shm_lock, so other producers queue up behind us in order. */
+static int cf_send_shm_data(kis_capture_handler_t *caph,
+        KismetExternal__MsgbusMessage *kv_message,
+        KismetDatasource__SubSignal *kv_signal,
+        KismetDatasource__SubGps *kv_gps,
+        struct timeval ts, uint32_t dlt, uint32_t packet_sz, uint8_t *pack) {
+    kis_shm_ring_slot_t *slot;
+    uint64_t doorbell = 1;
+    int r;
+
+    pthread_mutex_lock(&(caph->shm_lock));
+
+    /* Only plain frames which fit in a slot use the ring; anything with records
+     * attached is carried in a DATAREPORT */
+    if (kv_message == NULL && kv_signal == NULL && kv_gps == NULL &&
+            caph->gps_fixed_lat == 0 &&
+            packet_sz <= kis_shm_ring_slot_capacity(caph->shm_ring)) {
+        /* Wait for the IPC channel, including any pending batch, to drain, and then 
+         * for a free slot if the ring is full, as we would for IPC buffer space */
+        if (!cf_shm_wait(caph, cf_shm_ipc_idle) || !cf_shm_wait(caph, cf_shm_slot_free)) {
+            pthread_mutex_unlock(&(caph->shm_lock));
+            return -1;
+        }
+
+        slot = kis_shm_ring_slot(caph->shm_ring, caph->shm_head);
+
+        slot->dlt = dlt;
+        slot->ts_sec = ts.tv_sec;
+        slot->ts_usec = ts.tv_usec;
+        slot->caplen = packet_sz;
+        memcpy(slot->data, pack, packet_sz);
+
+        kis_shm_ring_set_slot_state(slot, KIS_SHM_SLOT_READY);
+
+        caph->shm_head = (caph->shm_head + 1) % caph->shm_ring->num_slots;
+
+        pthread_mutex_unlock(&(caph->shm_lock));
+
+        __atomic_add_fetch(&(caph->shm_ring->produced), 1, __ATOMIC_RELAXED);
+
+        if (__atomic_load_n(&(caph->shm_ring->consumer_waiting), __ATOMIC_SEQ_CST)) {
+            if (write(caph->shm_event_fd, &doorbell, sizeof(doorbell)) < 0) { }
+        }
+
+        return 1;
+    }
+
+    /* Everything in the ring has to reach the server before this packet */
+    if (!cf_shm_wait(caph, cf_shm_ring_idle)) {
+        pthread_mutex_unlock(&(caph->shm_lock));
+        return -1;
+    }
+
+    r = cf_send_data_ipc(caph, kv_message, kv_signal, kv_gps, ts, dlt, packet_sz, pack);
+
+    if (r > 0)
+        __atomic_add_fetch(&(caph->shm_ring->fallback), 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_unlock(&(caph->shm_lock));
+
+    return r;
+}
+
+int cf_send_data(kis_capture_handler_t *caph,
+        KismetExternal__MsgbusMessage *kv_message,
+        KismetDatasource__SubSignal *kv_signal,
+        KismetDatasource__SubGps *kv_gps,
+        struct timeval ts, uint32_t dlt, uint32_t packet_sz, uint8_t *pack) {
+
+    if (caph->shm_ring != NULL && packet_sz > 0 && pack != NULL)
+        return cf_send_shm_data(caph, kv_message, kv_signal, kv_gps, ts, dlt, 
+                packet_sz, pack);
+
+    return cf_send_data_ipc(caph, kv_message, kv_signal, kv_gps, ts, dlt, 
+            packet_sz, pack);
+}
+
 int cf_send_json(kis_capture_handler_t *caph,
         KismetExternal__MsgbusMessage *kv_message,
         KismetDatasource__SubSignal *kv_signal,
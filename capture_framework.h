@@ -58,10 +58,22 @@
 #endif
 
 #include "simple_ringbuf_c.h"
+#include "kis_shm_ring_c.h"
 
 #include "protobuf_c/kismet.pb-c.h"
 #include "protobuf_c/datasource.pb-c.h"
 
+/* Plain packets are coalesced into KDSDATAREPORTBATCH reports when the server 
+ * supports it; a batch is sent when it holds this many packets or bytes, or once
+ * its oldest packet has waited this long */
+#define CF_BATCH_MAX_PACKETS    64
+#define CF_BATCH_MAX_BYTES      (64 * 1024)
+#define CF_BATCH_MAX_USEC       10000
+
+/* How long to sleep while waiting for the server to catch up with the shared-memory
+ * ring or the IPC pipe */
+#define CF_SHM_WAIT_USEC        100
+
 struct kis_capture_handler;
 typedef struct kis_capture_handler kis_capture_handler_t;
 
@@ -268,6 +280,31 @@ struct kis_capture_handler {
     /* Use websockets mode */
     int use_ws;
 
+    /* Shared-memory packet ring and doorbell handed to us by a local server with
+     * --shm-fd and --shm-event-fd; packets go through the ring when possible and
+     * fall back to the IPC pipe, without being reordered (see kis_shm_ring_c.h).
+     * shm_lock serializes producers, and shm_ipc_sent counts the data reports sent
+     * over the pipe, for comparison with the server's count in the ring. */
+    int shm_fd;
+    int shm_event_fd;
+    kis_shm_ring_header_t *shm_ring;
+    size_t shm_ring_sz;
+    uint32_t shm_head;
+    uint64_t shm_ipc_sent;
+    pthread_mutex_t shm_lock;
+
+    /* Pending packet batch, used when the server announces batch support in the
+     * open command.  Packet data is copied into batch_buf and the sub-packets
+     * reference it until the batch is sent. */
+    int batch_data;
+    pthread_mutex_t batch_lock;
+    uint8_t *batch_buf;
+    size_t batch_buf_used;
+    KismetDatasource__SubPacket batch_packets[CF_BATCH_MAX_PACKETS];
+    KismetDatasource__SubPacket *batch_packet_ptrs[CF_BATCH_MAX_PACKETS];
+    size_t batch_num;
+    struct timeval batch_start;
+
     /* Remote host and port if acting as a remote drone in TCP mode, also used to
      * synthesize the websocket info */
     char *remote_host;
@@ -602,6 +639,9 @@ void cf_handler_set_hop_shuffle_spacing(kis_capture_handler_t *capf, int spacing
  *
  * Parse command line for --in-fd, --out-fd, --connect, --source, --host, and populate
  * the caph config.
+ *
+ * --shm-fd and --shm-event-fd are passed by a local server which offers a shared-memory
+ * packet ring; they are only honored in IPC mode.
  * 
  * Returns:
  * -1   Missing in-fd/out-fd or --connect, or unknown argument, caller should print
@@ -826,6 +866,13 @@ int cf_send_openresp(kis_capture_handler_t *caph, uint32_t seq, unsigned int suc
  *
  * If present, include message_kv, signal_kv, or gps_kv along with the packet data.
  *
+ * Plain packets are placed directly in the shared-memory ring when the server
+ * provided one and a slot is free; otherwise they are sent over the IPC channel.
+ *
+ * When the server supports it, plain packets are queued into a batch report which
+ * is sent when it fills or ages out (see CF_BATCH_*); a packet carrying its own
+ * message, signal, or GPS data first sends any queued batch, so ordering is kept.
+ *
  * Returns:
  * -1   An error occurred 
  *  0   Insufficient space in buffer
@@ -837,6 +884,17 @@ int cf_send_data(kis_capture_handler_t *caph,
         KismetDatasource__SubGps *kv_gps,
         struct timeval ts, uint32_t dlt, uint32_t packet_sz, uint8_t *pack);
 
+/* Send any packets queued by cf_send_data immediately; capture sources which read
+ * packets in groups can call this at the end of each group.
+ * Can be called from any thread
+ *
+ * Returns:
+ * -1   An error occurred
+ *  0   Insufficient space in buffer, try again
+ *  1   Success, or nothing to send
+ */
+int cf_flush_data(kis_capture_handler_t *caph);
+
 /* Send a DATA frame with JSON non-packet data
  * Can be called from any thread
  *
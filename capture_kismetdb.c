@@ -43,6 +43,7 @@
 
 #include "config.h"
 #include "capture_framework.h"
+#include "kismetdb_compress.h"
 
 #include <sqlite3.h>
 
@@ -501,6 +502,16 @@ void capture_thread(kis_capture_handler_t *caph) {
     char *data_type = NULL;
     char *data_json = NULL;
 
+    /* Decompression of v7 packets; dictionaries are per-dlt so the last one is
+     * usually the right one */
+    z_stream zs;
+    uint8_t *comp_dict = NULL;
+    long comp_dict_len = 0;
+    uint32_t comp_dict_id = 0;
+    uint8_t *comp_buf = NULL;
+    size_t comp_buf_sz = 0;
+    uint32_t blob_dict_id, blob_len;
+
     /* V4 didn't have speed, heading, etc, and used the normalized encoding */
     const char *basic_packet_sql_v4 = 
         "SELECT ts_sec, ts_usec, frequency, (lat / 100000.0), (lon / 100000.0), dlt, packet FROM packets ORDER BY ts_sec, ts_usec";
@@ -516,10 +527,22 @@ void capture_thread(kis_capture_handler_t *caph) {
     const char *basic_data_sql_v5 =
         "SELECT ts_sec, ts_usec, lat, lon, alt, speed, heading, type, json FROM data ORDER BY ts_sec, ts_usec";
 
+    /* V7 may compress packets */
+    const char *basic_packet_sql_v7 = 
+        "SELECT ts_sec, ts_usec, frequency, lat, lon, alt, speed, heading, dlt, packet, compression FROM packets ORDER BY ts_sec, ts_usec";
+
     int colno;
 
+    if (kismetdb_inflate_init(&zs) < 0) {
+        snprintf(errstr, 4096, "KismetDB '%s' could not initialize zlib", local_pcap->dbname);
+        cf_send_error(caph, 0, errstr);
+        return;
+    }
+
     if (local_pcap->db_version <= 4) {
         sql_r = sqlite3_prepare(local_pcap->db, basic_packet_sql_v4, strlen(basic_packet_sql_v4), &packet_stmt, &packet_pz);
+    } else if (local_pcap->db_version >= 7) {
+        sql_r = sqlite3_prepare(local_pcap->db, basic_packet_sql_v7, strlen(basic_packet_sql_v7), &packet_stmt, &packet_pz);
     } else if (local_pcap->db_version >= 5) {
         sql_r = sqlite3_prepare(local_pcap->db, basic_packet_sql_v5, strlen(basic_packet_sql_v5), &packet_stmt, &packet_pz);
     }  else {
@@ -612,6 +635,46 @@ void capture_thread(kis_capture_handler_t *caph) {
             packet_len = sqlite3_column_bytes(packet_stmt, colno);
             packet_data = sqlite3_column_blob(packet_stmt, colno++);
 
+            if (local_pcap->db_version >= 7 && packet_len > 0 &&
+                    sqlite3_column_int(packet_stmt, colno++) == KISMETDB_COMP_ZLIB) {
+                if (kismetdb_comp_header((const uint8_t *) packet_data, packet_len, 
+                            &blob_dict_id, &blob_len) < 0) {
+                    packet_r = sqlite3_step(packet_stmt);
+                    continue;
+                }
+
+                if (blob_dict_id != 0 && blob_dict_id != comp_dict_id) {
+                    if (comp_dict == NULL && (comp_dict = (uint8_t *) malloc(KISMETDB_DICT_MAX)) == NULL) {
+                        cf_send_error(caph, 0, "Could not allocate kismetdb dictionary");
+                        break;
+                    }
+
+                    comp_dict_len = kismetdb_fetch_dict(local_pcap->db, blob_dict_id, comp_dict);
+                    comp_dict_id = comp_dict_len < 0 ? 0 : blob_dict_id;
+                }
+
+                if (blob_len > comp_buf_sz) {
+                    free(comp_buf);
+                    comp_buf_sz = blob_len;
+
+                    if ((comp_buf = (uint8_t *) malloc(comp_buf_sz)) == NULL) {
+                        cf_send_error(caph, 0, "Could not allocate kismetdb packet buffer");
+                        break;
+                    }
+                }
+
+                /* Skip packets we can't decompress */
+                if ((blob_dict_id != 0 && comp_dict_id != blob_dict_id) ||
+                        kismetdb_decompress(&zs, (const uint8_t *) packet_data, packet_len,
+                            comp_dict, comp_dict_len, comp_buf, comp_buf_sz) < 0) {
+                    packet_r = sqlite3_step(packet_stmt);
+                    continue;
+                }
+
+                packet_data = comp_buf;
+                packet_len = blob_len;
+            }
+
             kismetdb_dispatch_packet_cb((u_char *) caph, packet_ts_sec, packet_ts_usec, dlt,
                     packet_len, (const u_char *) packet_data,
                     lat, lon, alt, speed, heading);
@@ -643,6 +706,10 @@ void capture_thread(kis_capture_handler_t *caph) {
         }
     }
 
+    inflateEnd(&zs);
+    free(comp_dict);
+    free(comp_buf);
+
     snprintf(errstr, 4096, "KismetDB '%s' closed, all packets and data processed.", 
             local_pcap->dbname);
     cf_send_message(caph, errstr, MSGFLAG_INFO);
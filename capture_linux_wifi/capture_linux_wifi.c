@@ -32,6 +32,10 @@
  * The packets undergo as little processing as possible and are passed to Kismet
  * to process the DLT.
  *
+ * Packets are normally captured with libpcap; with the 'tpacket=true' source option
+ * they are read from an AF_PACKET TPACKET_V3 block ring instead, which hands us a
+ * whole block of frames per wakeup on busy interfaces.
+ *
  * This binary needs to run as root to be able to control and capture from
  * the interface - and it needs to continue running as root to be able to control
  * the channels.
@@ -74,6 +78,15 @@
 #include <sys/stat.h>
 #include <semaphore.h>
 
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <net/if_arp.h>
+#include <linux/if_ether.h>
+#include <linux/if_packet.h>
+#include <linux/filter.h>
+
 #include "../config.h"
 
 #include "nl80211.h"
@@ -95,6 +108,12 @@
 
 #define MAX_PACKET_LEN  8192
 
+/* TPACKET_V3 ring defaults; blocks are handed to us when full or when the
+ * timeout expires, whichever comes first */
+#define TPACKET_BLOCK_SIZE      (256 * 1024)
+#define TPACKET_BLOCK_NR        32
+#define TPACKET_TIMEOUT_MS      50
+
 /* State tracking, put in userdata */
 typedef struct {
     pcap_t *pd;
@@ -147,6 +166,16 @@ typedef struct {
     unsigned long channel_set_ns_avg;
     unsigned int channel_set_ns_count;
 
+    /* Capture from a TPACKET_V3 ring instead of pcap; when active, pd is a dead
+     * pcap handle used only to compile filters */
+    int use_tpacket;
+    int tpacket_fd;
+    uint8_t *tpacket_map;
+    unsigned int tpacket_block_sz;
+    unsigned int tpacket_block_nr;
+    unsigned int tpacket_timeout;
+    char tpacket_errstr[STATUS_MAX];
+
 } local_wifi_t;
 
 /* Linux Wi-Fi Channels:
@@ -1185,6 +1214,171 @@ int build_explicit_filters(char **stringmacs, int num_macs, char **filter) {
 }
 
 
+/* Parse an unsigned source option, leaving the value unchanged if it's not present */
+int parse_uint_flag(const char *flag, const char *definition, unsigned int *ret) {
+    char *placeholder = NULL;
+    int placeholder_len;
+    char *val;
+    int r;
+
+    if ((placeholder_len = cf_find_flag(&placeholder, flag, definition)) <= 0)
+        return 0;
+
+    val = strndup(placeholder, placeholder_len);
+    r = sscanf(val, "%u", ret);
+    free(val);
+
+    return r == 1 ? 1 : -1;
+}
+
+void close_tpacket(local_wifi_t *local_wifi) {
+    if (local_wifi->tpacket_map != NULL) {
+        munmap(local_wifi->tpacket_map, 
+                (size_t) local_wifi->tpacket_block_sz * local_wifi->tpacket_block_nr);
+        local_wifi->tpacket_map = NULL;
+    }
+
+    if (local_wifi->tpacket_fd >= 0) {
+        close(local_wifi->tpacket_fd);
+        local_wifi->tpacket_fd = -1;
+    }
+}
+
+/* Open a TPACKET_V3 ring on the capture interface.  Returns the DLT of the
+ * interface, or -1 on failure */
+int open_tpacket(local_wifi_t *local_wifi, char *errstr) {
+    struct tpacket_req3 req;
+    struct sockaddr_ll sll;
+    struct ifreq ifr;
+    int ver = TPACKET_V3;
+    int ifidx;
+    int dlt;
+    long pagesz = sysconf(_SC_PAGESIZE);
+    void *map;
+
+    /* Blocks must be page multiples and hold at least one full frame */
+    local_wifi->tpacket_block_sz = 
+        ((local_wifi->tpacket_block_sz + pagesz - 1) / pagesz) * pagesz;
+
+    if (local_wifi->tpacket_block_sz < MAX_PACKET_LEN + TPACKET3_HDRLEN)
+        local_wifi->tpacket_block_sz = 
+            ((MAX_PACKET_LEN + TPACKET3_HDRLEN + pagesz - 1) / pagesz) * pagesz;
+
+    if (local_wifi->tpacket_block_nr == 0)
+        local_wifi->tpacket_block_nr = 1;
+
+    if ((ifidx = if_nametoindex(local_wifi->cap_interface)) == 0) {
+        snprintf(errstr, STATUS_MAX, "could not find interface index: %s", strerror(errno));
+        return -1;
+    }
+
+    if ((local_wifi->tpacket_fd = socket(AF_PACKET, SOCK_RAW, htons(ETH_P_ALL))) < 0) {
+        snprintf(errstr, STATUS_MAX, "could not create packet socket: %s", strerror(errno));
+        return -1;
+    }
+
+    memset(&ifr, 0, sizeof(struct ifreq));
+    snprintf(ifr.ifr_name, IFNAMSIZ, "%s", local_wifi->cap_interface);
+
+    if (ioctl(local_wifi->tpacket_fd, SIOCGIFHWADDR, &ifr) < 0) {
+        snprintf(errstr, STATUS_MAX, "could not get interface link type: %s", strerror(errno));
+        close_tpacket(local_wifi);
+        return -1;
+    }
+
+    switch (ifr.ifr_hwaddr.sa_family) {
+        case ARPHRD_IEEE80211_RADIOTAP:
+            dlt = DLT_IEEE802_11_RADIO;
+            break;
+        case ARPHRD_IEEE80211_PRISM:
+            dlt = DLT_PRISM_HEADER;
+            break;
+        case ARPHRD_IEEE80211:
+            dlt = DLT_IEEE802_11;
+            break;
+        default:
+            snprintf(errstr, STATUS_MAX, "interface is not in a supported monitor mode "
+                    "(link type %u)", ifr.ifr_hwaddr.sa_family);
+            close_tpacket(local_wifi);
+            return -1;
+    }
+
+    if (setsockopt(local_wifi->tpacket_fd, SOL_PACKET, PACKET_VERSION, 
+                &ver, sizeof(ver)) < 0) {
+        snprintf(errstr, STATUS_MAX, "could not set TPACKET_V3: %s", strerror(errno));
+        close_tpacket(local_wifi);
+        return -1;
+    }
+
+    /* Frames are variable length in V3; the frame size is only used for the kernel 
+     * to sanity check the ring */
+    memset(&req, 0, sizeof(struct tpacket_req3));
+    req.tp_block_size = local_wifi->tpacket_block_sz;
+    req.tp_block_nr = local_wifi->tpacket_block_nr;
+    req.tp_frame_size = 2048;
+    req.tp_frame_nr = (req.tp_block_size / req.tp_frame_size) * req.tp_block_nr;
+    req.tp_retire_blk_tov = local_wifi->tpacket_timeout;
+
+    if (setsockopt(local_wifi->tpacket_fd, SOL_PACKET, PACKET_RX_RING, 
+                &req, sizeof(req)) < 0) {
+        snprintf(errstr, STATUS_MAX, "could not create packet ring: %s", strerror(errno));
+        close_tpacket(local_wifi);
+        return -1;
+    }
+
+    map = mmap(NULL, (size_t) req.tp_block_size * req.tp_block_nr,
+            PROT_READ | PROT_WRITE, MAP_SHARED, local_wifi->tpacket_fd, 0);
+
+    if (map == MAP_FAILED) {
+        snprintf(errstr, STATUS_MAX, "could not map packet ring: %s", strerror(errno));
+        close_tpacket(local_wifi);
+        return -1;
+    }
+
+    local_wifi->tpacket_map = (uint8_t *) map;
+
+    memset(&sll, 0, sizeof(struct sockaddr_ll));
+    sll.sll_family = AF_PACKET;
+    sll.sll_protocol = htons(ETH_P_ALL);
+    sll.sll_ifindex = ifidx;
+
+    if (bind(local_wifi->tpacket_fd, (struct sockaddr *) &sll, sizeof(sll)) < 0) {
+        snprintf(errstr, STATUS_MAX, "could not bind packet socket: %s", strerror(errno));
+        close_tpacket(local_wifi);
+        return -1;
+    }
+
+    return dlt;
+}
+
+/* Assign a compiled filter to the pcap or TPACKET capture; on failure the error is
+ * available from wifi_geterr */
+int wifi_setfilter(local_wifi_t *local_wifi, struct bpf_program *bpf) {
+    struct sock_fprog fprog;
+
+    if (local_wifi->tpacket_fd < 0)
+        return pcap_setfilter(local_wifi->pd, bpf);
+
+    /* pcap and the kernel share the classic BPF instruction layout */
+    fprog.len = bpf->bf_len;
+    fprog.filter = (struct sock_filter *) bpf->bf_insns;
+
+    if (setsockopt(local_wifi->tpacket_fd, SOL_SOCKET, SO_ATTACH_FILTER, 
+                &fprog, sizeof(fprog)) < 0) {
+        snprintf(local_wifi->tpacket_errstr, STATUS_MAX, "%s", strerror(errno));
+        return -1;
+    }
+
+    return 0;
+}
+
+char *wifi_geterr(local_wifi_t *local_wifi) {
+    if (local_wifi->tpacket_fd < 0)
+        return pcap_geterr(local_wifi->pd);
+
+    return local_wifi->tpacket_errstr;
+}
+
 int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
         char *msg, uint32_t *dlt, char **uuid, KismetExternal__Command *frame,
         cf_params_interface_t **ret_interface,
@@ -1285,6 +1479,8 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
         local_wifi->pd = NULL;
     }
 
+    close_tpacket(local_wifi);
+
     /* Start processing the open */
 
     if ((placeholder_len = cf_parse_interface(&placeholder, definition)) <= 0) {
@@ -1321,6 +1517,29 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
         }
     }
 
+    /* Do we capture from a TPACKET_V3 ring instead of pcap? */
+    local_wifi->use_tpacket = 0;
+    local_wifi->tpacket_block_sz = TPACKET_BLOCK_SIZE;
+    local_wifi->tpacket_block_nr = TPACKET_BLOCK_NR;
+    local_wifi->tpacket_timeout = TPACKET_TIMEOUT_MS;
+
+    if ((placeholder_len = 
+                cf_find_flag(&placeholder, "tpacket", definition)) > 0) {
+        if (strncasecmp(placeholder, "false", placeholder_len) == 0) {
+            local_wifi->use_tpacket = 0;
+        } else if (strncasecmp(placeholder, "true", placeholder_len) == 0) {
+            local_wifi->use_tpacket = 1;
+        }
+    }
+
+    if (parse_uint_flag("tpacket_block_size", definition, &local_wifi->tpacket_block_sz) < 0 ||
+            parse_uint_flag("tpacket_blocks", definition, &local_wifi->tpacket_block_nr) < 0 ||
+            parse_uint_flag("tpacket_timeout", definition, &local_wifi->tpacket_timeout) < 0) {
+        snprintf(msg, STATUS_MAX, "%s could not parse tpacket_block_size=, tpacket_blocks=, "
+                "or tpacket_timeout= option provided in source definition", local_wifi->name);
+        return -1;
+    }
+
     /* Do we ignore any other interfaces on this device? */
     if ((placeholder_len = 
                 cf_find_flag(&placeholder, "filter_locals", definition)) > 0) {
@@ -2341,9 +2560,24 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
 
     (*ret_interface)->hardware = strdup(driver);
 
+    /* Open the TPACKET ring if requested, falling back to pcap if the interface or 
+     * kernel can't support it */
+    if (local_wifi->use_tpacket) {
+        if ((ret = open_tpacket(local_wifi, errstr)) < 0) {
+            snprintf(errstr2, STATUS_MAX, "%s could not capture from '%s' with TPACKET_V3, "
+                    "falling back to pcap: %s", local_wifi->name, local_wifi->cap_interface,
+                    errstr);
+            cf_send_message(caph, errstr2, MSGFLAG_INFO);
+        } else {
+            /* Filters are still compiled by pcap, then attached to the socket */
+            local_wifi->pd = pcap_open_dead(ret, MAX_PACKET_LEN);
+        }
+    }
+
     /* Open the pcap */
-    local_wifi->pd = pcap_open_live(local_wifi->cap_interface, 
-            MAX_PACKET_LEN, 1, 1000, pcap_errstr);
+    if (local_wifi->pd == NULL)
+        local_wifi->pd = pcap_open_live(local_wifi->cap_interface, 
+                MAX_PACKET_LEN, 1, 1000, pcap_errstr);
 
     if (local_wifi->pd == NULL || strlen(pcap_errstr) != 0) {
         snprintf(msg, STATUS_MAX, "%s could not open capture interface '%s' on '%s' "
@@ -2367,10 +2601,10 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
                         local_wifi->name, pcap_geterr(local_wifi->pd));
                 cf_send_message(caph, errstr, MSGFLAG_INFO);
             } else {
-                if (pcap_setfilter(local_wifi->pd, &bpf) < 0) {
+                if (wifi_setfilter(local_wifi, &bpf) < 0) {
                     snprintf(errstr, STATUS_MAX, "%s unable to assign filter to exclude other "
                             "local interfaces: %s",
-                            local_wifi->name, pcap_geterr(local_wifi->pd));
+                            local_wifi->name, wifi_geterr(local_wifi));
                     cf_send_message(caph, errstr, MSGFLAG_INFO);
                 }
             }
@@ -2385,10 +2619,10 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
                         local_wifi->name, pcap_geterr(local_wifi->pd));
                 cf_send_message(caph, errstr, MSGFLAG_INFO);
             } else {
-                if (pcap_setfilter(local_wifi->pd, &bpf) < 0) {
+                if (wifi_setfilter(local_wifi, &bpf) < 0) {
                     snprintf(errstr, STATUS_MAX, "%s unable to assign filter to exclude "
                             "local interfaces: %s",
-                            local_wifi->name, pcap_geterr(local_wifi->pd));
+                            local_wifi->name, wifi_geterr(local_wifi));
                     cf_send_message(caph, errstr, MSGFLAG_INFO);
                 }
             }
@@ -2410,10 +2644,10 @@ int open_callback(kis_capture_handler_t *caph, uint32_t seqno, char *definition,
                         local_wifi->name, pcap_geterr(local_wifi->pd));
                 cf_send_message(caph, errstr, MSGFLAG_INFO);
             } else {
-                if (pcap_setfilter(local_wifi->pd, &bpf) < 0) {
+                if (wifi_setfilter(local_wifi, &bpf) < 0) {
                     snprintf(errstr, STATUS_MAX, "%s unable to assign filter to exclude "
                             "specific addresses: %s",
-                            local_wifi->name, pcap_geterr(local_wifi->pd));
+                            local_wifi->name, wifi_geterr(local_wifi));
                     cf_send_message(caph, errstr, MSGFLAG_INFO);
                 }
             }
@@ -2621,9 +2855,119 @@ void pcap_dispatch_cb(u_char *user, const struct pcap_pkthdr *header,
     }
 }
 
+/* Send every frame in a retired TPACKET block */
+int tpacket_send_block(kis_capture_handler_t *caph, struct tpacket_block_desc *bd) {
+    local_wifi_t *local_wifi = (local_wifi_t *) caph->userdata;
+    struct tpacket3_hdr *hdr;
+    struct timeval ts;
+    uint32_t caplen;
+    uint32_t i;
+    int ret;
+
+    hdr = (struct tpacket3_hdr *) ((uint8_t *) bd + bd->hdr.bh1.offset_to_first_pkt);
+
+    for (i = 0; i < bd->hdr.bh1.num_pkts; i++) {
+        ts.tv_sec = hdr->tp_sec;
+        ts.tv_usec = hdr->tp_nsec / 1000;
+
+        caplen = hdr->tp_snaplen;
+        if (caplen > MAX_PACKET_LEN)
+            caplen = MAX_PACKET_LEN;
+
+        while (1) {
+            if ((ret = cf_send_data(caph, 
+                            NULL, NULL, NULL,
+                            ts, 
+                            local_wifi->datalink_type,
+                            caplen, (uint8_t *) hdr + hdr->tp_mac)) < 0) {
+                cf_send_error(caph, 0, "unable to send DATA frame");
+                cf_handler_spindown(caph);
+                return -1;
+            } else if (ret == 0) {
+                /* Go into a wait for the write buffer to get flushed */
+                cf_handler_wait_ringbuffer(caph);
+                continue;
+            } else {
+                break;
+            }
+        }
+
+        hdr = (struct tpacket3_hdr *) ((uint8_t *) hdr + hdr->tp_next_offset);
+    }
+
+    /* Send the block as one batch if the server supports it */
+    while ((ret = cf_flush_data(caph)) == 0)
+        cf_handler_wait_ringbuffer(caph);
+
+    if (ret < 0) {
+        cf_send_error(caph, 0, "unable to send DATA frame");
+        cf_handler_spindown(caph);
+        return -1;
+    }
+
+    return 1;
+}
+
+/* Consume blocks from the TPACKET ring in order, sleeping until the kernel retires 
+ * the next one.  Returns when the interface fails, with the reason in errstr */
+void tpacket_loop(kis_capture_handler_t *caph, char *errstr, size_t errstr_sz) {
+    local_wifi_t *local_wifi = (local_wifi_t *) caph->userdata;
+    struct tpacket_block_desc *bd;
+    struct pollfd pfd;
+    unsigned int block = 0;
+    int serr;
+    socklen_t serr_len;
+    int r;
+
+    pfd.fd = local_wifi->tpacket_fd;
+    pfd.events = POLLIN | POLLERR;
+    pfd.revents = 0;
+
+    while (1) {
+        bd = (struct tpacket_block_desc *) (local_wifi->tpacket_map + 
+                (size_t) block * local_wifi->tpacket_block_sz);
+
+        if ((__atomic_load_n(&(bd->hdr.bh1.block_status), __ATOMIC_ACQUIRE) & 
+                    TP_STATUS_USER) == 0) {
+            r = poll(&pfd, 1, -1);
+
+            if (r < 0) {
+                if (errno == EINTR)
+                    continue;
+
+                snprintf(errstr, errstr_sz, "%s", strerror(errno));
+                return;
+            }
+
+            if (pfd.revents & (POLLERR | POLLHUP | POLLNVAL)) {
+                serr = 0;
+                serr_len = sizeof(serr);
+
+                getsockopt(local_wifi->tpacket_fd, SOL_SOCKET, SO_ERROR, &serr, &serr_len);
+                snprintf(errstr, errstr_sz, "%s", 
+                        serr != 0 ? strerror(serr) : "interface closed");
+                return;
+            }
+
+            continue;
+        }
+
+        if (tpacket_send_block(caph, bd) < 0) {
+            snprintf(errstr, errstr_sz, "unable to send DATA frame");
+            return;
+        }
+
+        /* Hand the block back to the kernel */
+        __atomic_store_n(&(bd->hdr.bh1.block_status), TP_STATUS_KERNEL, __ATOMIC_RELEASE);
+
+        block = (block + 1) % local_wifi->tpacket_block_nr;
+    }
+}
+
 void capture_thread(kis_capture_handler_t *caph) {
     local_wifi_t *local_wifi = (local_wifi_t *) caph->userdata;
     char errstr[PCAP_ERRBUF_SIZE];
+    char tpacket_errstr[STATUS_MAX] = "";
     char *pcap_errstr;
     char iferrstr[STATUS_MAX];
     int ifflags = 0, ifret;
@@ -2632,9 +2976,13 @@ void capture_thread(kis_capture_handler_t *caph) {
      * channel control is managed by the channel hopping thread, all we have
      * to do is enter a blocking pcap loop */
 
-    pcap_loop(local_wifi->pd, -1, pcap_dispatch_cb, (u_char *) caph);
-
-    pcap_errstr = pcap_geterr(local_wifi->pd);
+    if (local_wifi->tpacket_fd >= 0) {
+        tpacket_loop(caph, tpacket_errstr, STATUS_MAX);
+        pcap_errstr = tpacket_errstr;
+    } else {
+        pcap_loop(local_wifi->pd, -1, pcap_dispatch_cb, (u_char *) caph);
+        pcap_errstr = pcap_geterr(local_wifi->pd);
+    }
 
     snprintf(errstr, PCAP_ERRBUF_SIZE, "%s interface '%s' closed: %s", 
             local_wifi->name, local_wifi->cap_interface, 
@@ -2758,6 +3106,12 @@ int main(int argc, char *argv[]) {
         .verbose_statistics = 0,
         .channel_set_ns_avg = 0,
         .channel_set_ns_count = 0,
+        .use_tpacket = 0,
+        .tpacket_fd = -1,
+        .tpacket_map = NULL,
+        .tpacket_block_sz = TPACKET_BLOCK_SIZE,
+        .tpacket_block_nr = TPACKET_BLOCK_NR,
+        .tpacket_timeout = TPACKET_TIMEOUT_MS,
     };
 
 #ifdef HAVE_LIBNM
@@ -0,0 +1,418 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <string.h>
+#include <sstream>
+
+#include "columnar_adapter.h"
+#include "endian_magic.h"
+#include "entrytracker.h"
+#include "json_adapter.h"
+
+namespace {
+
+void put_u16(std::string& buf, uint16_t v) {
+    v = kis_htole16(v);
+    buf.append((const char *) &v, sizeof(v));
+}
+
+void put_u32(std::string& buf, uint32_t v) {
+    v = kis_htole32(v);
+    buf.append((const char *) &v, sizeof(v));
+}
+
+void pad8(std::string& buf) {
+    buf.append((8 - (buf.size() % 8)) % 8, '\0');
+}
+
+template<typename T>
+void put_le(std::string& buf, T v) {
+    static_assert(sizeof(T) == 1 || sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8,
+            "unsupported column width");
+
+    if (sizeof(T) == 1) {
+        buf.append((const char *) &v, 1);
+    } else if (sizeof(T) == 2) {
+        uint16_t u;
+        memcpy(&u, &v, sizeof(u));
+        put_u16(buf, u);
+    } else if (sizeof(T) == 4) {
+        uint32_t u;
+        memcpy(&u, &v, sizeof(u));
+        put_u32(buf, u);
+    } else {
+        uint64_t u;
+        memcpy(&u, &v, sizeof(u));
+        u = kis_htole64(u);
+        buf.append((const char *) &u, sizeof(u));
+    }
+}
+
+}
+
+columnar_adapter::column_type columnar_adapter::column_type_for(tracker_type type) {
+    switch (type) {
+        case tracker_type::tracker_string:
+        case tracker_type::tracker_mac_addr:
+        case tracker_type::tracker_uuid:
+        case tracker_type::tracker_key:
+            return column_type::utf8;
+        case tracker_type::tracker_int8:
+            return column_type::int8;
+        case tracker_type::tracker_uint8:
+            return column_type::uint8;
+        case tracker_type::tracker_int16:
+            return column_type::int16;
+        case tracker_type::tracker_uint16:
+            return column_type::uint16;
+        case tracker_type::tracker_int32:
+            return column_type::int32;
+        case tracker_type::tracker_uint32:
+            return column_type::uint32;
+        case tracker_type::tracker_int64:
+            return column_type::int64;
+        case tracker_type::tracker_uint64:
+            return column_type::uint64;
+        case tracker_type::tracker_float:
+            return column_type::float32;
+        case tracker_type::tracker_double:
+            return column_type::float64;
+        case tracker_type::tracker_byte_array:
+            return column_type::binary;
+        default:
+            return column_type::json;
+    }
+}
+
+void columnar_adapter::column::set_valid(bool valid) {
+    if (rows % 8 == 0)
+        validity.push_back(0);
+
+    if (valid)
+        validity.back() |= (1 << (rows % 8));
+
+    rows++;
+}
+
+template<typename T>
+void columnar_adapter::column::append_fixed(T v) {
+    set_valid(true);
+    put_le<T>(values, v);
+}
+
+void columnar_adapter::column::append_variable(const std::string& v) {
+    if (offsets.size() == 0)
+        offsets.push_back(0);
+
+    set_valid(true);
+    values.append(v);
+    offsets.push_back(values.size());
+}
+
+void columnar_adapter::column::append_null() {
+    if (is_variable()) {
+        if (offsets.size() == 0)
+            offsets.push_back(0);
+
+        offsets.push_back(values.size());
+    } else {
+        // Null slots still occupy their width
+        switch (type) {
+            case column_type::int8:
+            case column_type::uint8:
+                values.append(1, '\0');
+                break;
+            case column_type::int16:
+            case column_type::uint16:
+                values.append(2, '\0');
+                break;
+            case column_type::int32:
+            case column_type::uint32:
+            case column_type::float32:
+                values.append(4, '\0');
+                break;
+            default:
+                values.append(8, '\0');
+                break;
+        }
+    }
+
+    set_valid(false);
+}
+
+void columnar_adapter::column::append(shared_tracker_element e,
+        const std::shared_ptr<tracker_element_serializer::rename_map>& name_map) {
+
+    if (e != nullptr && e->get_type() == tracker_type::tracker_alias)
+        e = std::static_pointer_cast<tracker_element_alias>(e)->get();
+
+    if (e == nullptr) {
+        append_null();
+        return;
+    }
+
+    serializer_scope s(e, name_map);
+
+    auto etype = column_type_for(e->get_type());
+
+    if (etype != type) {
+        append_null();
+        return;
+    }
+
+    switch (type) {
+        case column_type::utf8:
+            append_variable(e->as_string());
+            break;
+        case column_type::binary:
+            append_variable(std::static_pointer_cast<tracker_element_byte_array>(e)->get());
+            break;
+        case column_type::json:
+            {
+                std::stringstream ss;
+                json_adapter::pack(ss, e, name_map);
+                append_variable(ss.str());
+            }
+            break;
+        case column_type::int8:
+            append_fixed(get_tracker_value<int8_t>(e));
+            break;
+        case column_type::uint8:
+            append_fixed(get_tracker_value<uint8_t>(e));
+            break;
+        case column_type::int16:
+            append_fixed(get_tracker_value<int16_t>(e));
+            break;
+        case column_type::uint16:
+            append_fixed(get_tracker_value<uint16_t>(e));
+            break;
+        case column_type::int32:
+            append_fixed(get_tracker_value<int32_t>(e));
+            break;
+        case column_type::uint32:
+            append_fixed(get_tracker_value<uint32_t>(e));
+            break;
+        case column_type::int64:
+            append_fixed(get_tracker_value<int64_t>(e));
+            break;
+        case column_type::uint64:
+            append_fixed(get_tracker_value<uint64_t>(e));
+            break;
+        case column_type::float32:
+            append_fixed(get_tracker_value<float>(e));
+            break;
+        case column_type::float64:
+            append_fixed(get_tracker_value<double>(e));
+            break;
+    }
+}
+
+void columnar_adapter::column::write_batch(std::ostream& stream) {
+    std::string block;
+
+    // Length placeholder
+    put_u32(block, 0);
+    put_u32(block, 0);
+
+    block.append((const char *) validity.data(), validity.size());
+    pad8(block);
+
+    if (is_variable()) {
+        if (offsets.size() == 0)
+            offsets.push_back(0);
+
+        for (auto o : offsets)
+            put_u32(block, o);
+        pad8(block);
+    }
+
+    block.append(values);
+    pad8(block);
+
+    uint32_t len = kis_htole32((uint32_t) block.size());
+    memcpy(&block[0], &len, sizeof(len));
+
+    stream.write(block.data(), block.size());
+
+    rows = 0;
+    validity.clear();
+    values.clear();
+    offsets.clear();
+}
+
+std::string columnar_adapter::serializer::field_name(int id, const shared_tracker_element& e,
+        const std::shared_ptr<rename_map>& name_map) {
+
+    if (name_map != nullptr) {
+        auto nmi = name_map->find(e);
+        if (nmi != name_map->end() && nmi->second->rename.length() != 0)
+            return nmi->second->rename;
+    }
+
+    if (e->has_local_name())
+        return e->get_local_name();
+
+    auto ni = name_cache.find(id);
+    if (ni != name_cache.end())
+        return ni->second;
+
+    auto name = Globalreg::globalreg->entrytracker->get_field_name(id);
+    name_cache[id] = name;
+
+    return name;
+}
+
+int columnar_adapter::serializer::serialize(shared_tracker_element in_elem, std::ostream &stream,
+        std::shared_ptr<rename_map> name_map) {
+    local_locker lock(&mutex);
+
+    if (in_elem->get_type() != tracker_type::tracker_vector) {
+        stream << "Invalid data supplied for kcol.  Columnar endpoints can only be serialized from vectors.\n";
+        return -1;
+    }
+
+    auto vec = std::static_pointer_cast<tracker_element_vector>(in_elem);
+
+    std::vector<column> columns;
+    robin_hood::unordered_map<std::string, size_t> column_index;
+    bool as_records = false;
+
+    // Build the schema from the first record
+    for (auto r : *vec) {
+        if (r == nullptr)
+            continue;
+
+        if (r->get_type() == tracker_type::tracker_alias)
+            r = std::static_pointer_cast<tracker_element_alias>(r)->get();
+
+        if (r == nullptr)
+            continue;
+
+        if (r->get_type() == tracker_type::tracker_map) {
+            as_records = true;
+
+            for (const auto& f : *std::static_pointer_cast<tracker_element_map>(r)) {
+                if (f.second == nullptr)
+                    continue;
+
+                auto fe = f.second;
+                if (fe->get_type() == tracker_type::tracker_alias)
+                    fe = std::static_pointer_cast<tracker_element_alias>(fe)->get();
+
+                if (fe == nullptr)
+                    continue;
+
+                auto name = field_name(f.first, f.second, name_map);
+
+                if (column_index.find(name) != column_index.end())
+                    continue;
+
+                column_index[name] = columns.size();
+                columns.push_back(column(name, column_type_for(fe->get_type())));
+            }
+        } else {
+            columns.push_back(column("value", column_type_for(r->get_type())));
+        }
+
+        break;
+    }
+
+    std::string header;
+
+    header.append("KISCOL\x00\x01", 8);
+    put_u32(header, columns.size());
+    put_u32(header, 0);
+
+    for (const auto& c : columns) {
+        header.append(1, (char) c.type);
+        header.append(1, '\0');
+        put_u16(header, c.name.length());
+        header.append(c.name);
+    }
+    pad8(header);
+
+    stream.write(header.data(), header.size());
+
+    size_t batch_sz = 0;
+    std::vector<shared_tracker_element> row(columns.size());
+
+    auto write_batch = [&]() {
+        std::string bh;
+        put_u32(bh, batch_sz);
+        put_u32(bh, 0);
+        stream.write(bh.data(), bh.size());
+
+        for (auto& c : columns)
+            c.write_batch(stream);
+
+        batch_sz = 0;
+    };
+
+    for (const auto& r : *vec) {
+        if (r == nullptr)
+            continue;
+
+        serializer_scope s(r, name_map);
+
+        auto re = r;
+        if (re->get_type() == tracker_type::tracker_alias)
+            re = std::static_pointer_cast<tracker_element_alias>(re)->get();
+
+        if (re == nullptr)
+            continue;
+
+        std::fill(row.begin(), row.end(), nullptr);
+
+        if (as_records) {
+            if (re->get_type() == tracker_type::tracker_map) {
+                for (const auto& f : *std::static_pointer_cast<tracker_element_map>(re)) {
+                    if (f.second == nullptr)
+                        continue;
+
+                    auto ci = column_index.find(field_name(f.first, f.second, name_map));
+                    if (ci == column_index.end())
+                        continue;
+
+                    row[ci->second] = f.second;
+                }
+            }
+        } else if (columns.size() != 0) {
+            row[0] = re;
+        }
+
+        for (size_t i = 0; i < columns.size(); i++)
+            columns[i].append(row[i], name_map);
+
+        if (++batch_sz >= batch_rows)
+            write_batch();
+    }
+
+    if (batch_sz > 0)
+        write_batch();
+
+    // End of stream
+    std::string trailer;
+    put_u32(trailer, 0);
+    put_u32(trailer, 0);
+    stream.write(trailer.data(), trailer.size());
+
+    return 0;
+}
+
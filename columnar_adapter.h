@@ -0,0 +1,138 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __COLUMNAR_ADAPTER_H__
+#define __COLUMNAR_ADAPTER_H__
+
+#include "config.h"
+
+#include <string>
+#include <vector>
+
+#include "globalregistry.h"
+#include "trackedelement.h"
+#include "robin_hood.h"
+
+// Columnar binary adapter ("kcol").  Like ekjson, this serializes a vector of records
+// (typically the devices of a view, simplified with a 'fields' request), but emits
+// them as typed columns which a client can map directly into arrays instead of
+// parsing text.  The layout follows the Arrow model (validity bitmap, fixed width
+// values, offsets + data for variable width) without requiring the Arrow libraries
+// on either end.
+//
+// All integers are little-endian, and every block is padded to 8 bytes so that
+// column values are naturally aligned relative to the start of the stream.
+//
+// Stream:
+//   magic       8 bytes, "KISCOL" followed by 0x00 and the format version (0x01)
+//
+//   schema      u32 column count, u32 reserved
+//               per column:  u8 column type, u8 reserved, u16 name length, name
+//               padded to 8
+//
+//   batches     u32 row count, u32 reserved.  A row count of 0 ends the stream.
+//               per column, in schema order:
+//                 u32 block length (including the length header), u32 reserved
+//                 validity:  1 bit per row, LSB first, 1 = present, padded to 8
+//                 fixed width columns:  row count values, padded to 8
+//                 variable width columns:  u32 offsets[row count + 1], padded
+//                   to 8, followed by the data, padded to 8
+//
+// The schema is taken from the first record.  The column names are the field
+// names (or renames) the json serializers would use.  Fields missing from a record,
+// or which don't match the type of the column, are null.
+namespace columnar_adapter {
+
+// Scalar column types share the tracker_type numbering
+enum class column_type : uint8_t {
+    utf8 = 0,
+    int8 = 1,
+    uint8 = 2,
+    int16 = 3,
+    uint16 = 4,
+    int32 = 5,
+    uint32 = 6,
+    int64 = 7,
+    uint64 = 8,
+    float32 = 9,
+    float64 = 10,
+    binary = 19,
+
+    // Complex elements (maps, vectors) are carried as json text
+    json = 128,
+};
+
+class column {
+public:
+    column(const std::string& name, column_type type) :
+        name{name},
+        type{type},
+        rows{0} { }
+
+    void append(shared_tracker_element e,
+            const std::shared_ptr<tracker_element_serializer::rename_map>& name_map);
+    void append_null();
+
+    // Write the current batch of this column and reset it
+    void write_batch(std::ostream& stream);
+
+    std::string name;
+    column_type type;
+
+protected:
+    bool is_variable() const {
+        return type == column_type::utf8 || type == column_type::binary ||
+            type == column_type::json;
+    }
+
+    void set_valid(bool valid);
+    void append_variable(const std::string& v);
+
+    template<typename T>
+    void append_fixed(T v);
+
+    size_t rows;
+    std::vector<uint8_t> validity;
+    std::string values;
+    std::vector<uint32_t> offsets;
+};
+
+class serializer : public tracker_element_serializer {
+public:
+    serializer() :
+        tracker_element_serializer() { }
+
+    virtual int serialize(shared_tracker_element in_elem, std::ostream &stream,
+            std::shared_ptr<rename_map> name_map = nullptr) override;
+
+    // Rows per record batch
+    static constexpr size_t batch_rows = 4096;
+
+protected:
+    std::string field_name(int id, const shared_tracker_element& e,
+            const std::shared_ptr<rename_map>& name_map);
+
+    robin_hood::unordered_map<int, std::string> name_cache;
+};
+
+column_type column_type_for(tracker_type type);
+
+}
+
+#endif
+
@@ -95,6 +95,9 @@ public:
 
         // We're capable of opening a source
         set_local_capable(true);
+
+        // Local capture can deliver packets via shared memory
+        set_shm_capable(true);
 #else
         // Only remote on other platforms
         set_probe_capable(false);
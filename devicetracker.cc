@@ -25,6 +25,7 @@
 #include <list>
 #include <map>
 #include <vector>
+#include <thread>
 
 #include "kismet_algorithm.h"
 
@@ -195,6 +196,25 @@ device_tracker::device_tracker() :
         map_phy_views = true;
     }
 
+    if (!globalreg->kismet_config->fetch_opt_bool("track_device_view_indexes", true)) {
+        _MSG("Not building device view search indexes to save RAM", MSGFLAG_INFO);
+        map_view_indexes = false;
+    } else {
+        map_view_indexes = true;
+    }
+
+    // Sorted views are maintained from the per-packet view updates, which are only 
+    // performed when seenby views are enabled
+    if (!globalreg->kismet_config->fetch_opt_bool("track_device_view_sorting", true)) {
+        _MSG("Not maintaining sorted device views to save RAM", MSGFLAG_INFO);
+        map_view_sorting = false;
+    } else if (!map_seenby_views) {
+        _MSG("Not maintaining sorted device views because seenby views are disabled", MSGFLAG_INFO);
+        map_view_sorting = false;
+    } else {
+        map_view_sorting = true;
+    }
+
     if (globalreg->kismet_config->fetch_opt_bool("kis_log_devices", true)) {
         unsigned int lograte = 
             globalreg->kismet_config->fetch_opt_uint("kis_log_device_rate", 30);
@@ -249,9 +269,22 @@ device_tracker::device_tracker() :
     unsigned int preload_sz = 
         globalreg->kismet_config->fetch_opt_uint("tracker_device_presize", 1000);
 
-    tracked_vec.reserve(preload_sz);
     immutable_tracked_vec->reserve(preload_sz);
 
+    parallel_serialize_min =
+        globalreg->kismet_config->fetch_opt_uint("tracker_parallel_serialize", 2000);
+    serialize_threads =
+        globalreg->kismet_config->fetch_opt_uint("tracker_serialize_threads", 0);
+
+    if (serialize_threads == 0)
+        serialize_threads = std::max(1U, std::thread::hardware_concurrency());
+
+    if (serialize_threads < 2)
+        parallel_serialize_min = 0;
+
+    serialize_pool_ = std::unique_ptr<kis_thread_pool>(new kis_thread_pool("device serialize", 
+                serialize_threads, serialize_threads / 4));
+
     // Set up the device timeout
     device_idle_expiration =
         globalreg->kismet_config->fetch_opt_int("tracker_device_timeout", 0);
@@ -362,7 +395,7 @@ device_tracker::device_tracker() :
                     unlock_device_range(devs);
                 }));
 
-    httpd->register_route("/devices/all_devices", {"GET", "POST"}, httpd->RO_ROLE, {"ekjson", "itjson"},
+    httpd->register_route("/devices/all_devices", {"GET", "POST"}, httpd->RO_ROLE, {"ekjson", "itjson", "kcol"},
             std::make_shared<kis_net_web_tracked_endpoint>(
                 [this](shared_con con) -> std::shared_ptr<tracker_element> {
                     auto device_ro = std::make_shared<tracker_element_vector>();
@@ -647,6 +680,8 @@ void device_tracker::trigger_deferred_startup() {
                 [](std::shared_ptr<kis_tracked_device_base>) -> bool {
                     return true;
                 });
+
+    enable_view_indexes(all_view);
     add_view(all_view);
 
 }
@@ -687,7 +722,6 @@ device_tracker::~device_tracker() {
     for (auto p : phy_handler_map)
         delete(p.second);
 
-    tracked_vec.clear();
     immutable_tracked_vec->clear();
     tracked_mac_multimap.clear();
 }
@@ -790,6 +824,8 @@ int device_tracker::register_phy_handler(kis_phy_handler *in_weak_handler) {
                         }
                         );
             phy_view_map[phy_id] = phy_view;
+
+            enable_view_indexes(phy_view);
             add_view(phy_view);
         }
     }
@@ -1130,12 +1166,13 @@ std::shared_ptr<kis_tracked_device_base>
     if (new_device) {
         tracked_map[key] = device;
 
-        tracked_vec.push_back(device);
         immutable_tracked_vec->push_back(device);
 
         auto mm_pair = std::make_pair(in_mac, device);
         tracked_mac_multimap.insert(mm_pair);
 
+        queue_device_expiry(device);
+
         // Unlock the device list before adding it to the device views
         list_locker.unlock();
 
@@ -1177,12 +1214,35 @@ std::shared_ptr<tracker_element_vector> device_tracker::do_readonly_device_work(
     return all_view->do_readonly_device_work(worker);
 }
 
-// Simple std::sort comparison function to order by the least frequently
-// seen devices
-bool devicetracker_sort_lastseen(std::shared_ptr<kis_tracked_device_base> a,
-	std::shared_ptr<kis_tracked_device_base> b) {
+void device_tracker::queue_device_expiry(std::shared_ptr<kis_tracked_device_base> device) {
+    // Only index devices if something is going to expire them
+    if (device_idle_expiration != 0)
+        device_idle_heap.push({device->get_last_time(), device->get_key()});
 
-	return a->get_last_time() < b->get_last_time();
+    if (max_num_devices != 0)
+        device_expiry_heap.push({device->get_last_time(), device->get_key()});
+}
+
+void device_tracker::remove_tracked_device(std::shared_ptr<kis_tracked_device_base> device) {
+    device_itr mi = tracked_map.find(device->get_key());
+
+    if (mi != tracked_map.end())
+        tracked_map.erase(mi);
+
+    // Erase it from the multimap
+    auto mmp = tracked_mac_multimap.equal_range(device->get_macaddr());
+
+    for (auto mmpi = mmp.first; mmpi != mmp.second; ++mmpi) {
+        if (mmpi->second->get_key() == device->get_key()) {
+            tracked_mac_multimap.erase(mmpi);
+            break;
+        }
+    }
+
+    // Forget it from the immutable vec, but keep its 
+    // position; we need to have vecpos = devid
+    auto iti = immutable_tracked_vec->begin() + device->get_kis_internal_id();
+    (*iti).reset();
 }
 
 void device_tracker::timetracker_event(int eventid) {
@@ -1190,51 +1250,59 @@ void device_tracker::timetracker_event(int eventid) {
         local_locker lock(&devicelist_mutex);
 
         time_t ts_now = globalreg->timestamp.tv_sec;
-        bool purged = false;
-
-        // Find all eligible devices, remove them from the tracked vec
-        tracked_vec.erase(std::remove_if(tracked_vec.begin(), tracked_vec.end(),
-                [&](std::shared_ptr<kis_tracked_device_base> d) {
-                    // Lock the device itself
-                    local_locker devlocker(&(d->device_mutex));
-
-                    if (ts_now - d->get_last_time() > device_idle_expiration &&
-                            (d->get_packets() < device_idle_min_packets || 
-                             device_idle_min_packets <= 0)) {
-                        device_itr mi = tracked_map.find(d->get_key());
-
-                        if (mi != tracked_map.end())
-                            tracked_map.erase(mi);
-
-                        // Erase it from the multimap
-                        auto mmp = tracked_mac_multimap.equal_range(d->get_macaddr());
-
-                        for (auto mmpi = mmp.first; mmpi != mmp.second; ++mmpi) {
-                            if (mmpi->second->get_key() == d->get_key()) {
-                                tracked_mac_multimap.erase(mmpi);
-                                break;
-                            }
-                        }
 
-                        // Forget it from any views
-                        remove_view_device(d);
+        std::vector<std::shared_ptr<kis_tracked_device_base>> purged;
 
-                        // Forget it from the immutable vec, but keep its 
-                        // position; we need to have vecpos = devid
-                        auto iti = immutable_tracked_vec->begin() + d->get_kis_internal_id();
-                        (*iti).reset();
+        // Only look at devices whose last known time has passed the timeout
+        while (!device_idle_heap.empty() &&
+                ts_now - device_idle_heap.top().last_time > device_idle_expiration) {
+            auto e = device_idle_heap.top();
+            device_idle_heap.pop();
 
-                        purged = true;
+            auto di = tracked_map.find(e.key);
 
-                        return true;
-                    }
+            // Already removed
+            if (di == tracked_map.end())
+                continue;
+
+            auto d = di->second;
+
+            // Lock the device itself
+            local_locker devlocker(&(d->device_mutex));
+
+            // Seen since it was queued, re-queue it at the current time
+            if (d->get_last_time() != e.last_time) {
+                device_idle_heap.push({d->get_last_time(), e.key});
+                continue;
+            }
+
+            // Devices with enough packets are never idle-expired, and packet counts
+            // only go up, so they leave the idle index for good
+            if (device_idle_min_packets > 0 && d->get_packets() >= device_idle_min_packets)
+                continue;
+
+            remove_tracked_device(d);
+            purged.push_back(d);
+        }
+
+        // The max devices index keeps entries for idle-expired devices until they reach
+        // the top; rebuild it if they come to outnumber the live devices
+        if (max_num_devices > 0 && device_expiry_heap.size() > (tracked_map.size() * 2) + 1024) {
+            std::vector<device_expiry_entry> live;
+            live.reserve(tracked_map.size());
 
-                    return false;
-         
-                    }), tracked_vec.end());
+            for (const auto& ti : tracked_map)
+                live.push_back({ti.second->get_last_time(), ti.first});
 
-        if (purged)
+            device_expiry_heap = device_expiry_heap_t(std::greater<device_expiry_entry>(),
+                    std::move(live));
+        }
+
+        if (purged.size() > 0) {
+            // Forget them from any views
+            remove_view_devices(purged);
             update_full_refresh();
+        }
 
     } else if (eventid == max_devices_timer) {
 		local_locker lock(&devicelist_mutex);
@@ -1244,46 +1312,39 @@ void device_tracker::timetracker_event(int eventid) {
             return;
 
 		// Do nothing if the number of devices is less than the max
-		if (tracked_vec.size() <= max_num_devices)
+		if (tracked_map.size() <= max_num_devices)
             return;
 
-        // Do an update since we're trimming something
-        update_full_refresh();
+        std::vector<std::shared_ptr<kis_tracked_device_base>> purged;
 
-		// Now things start getting expensive.  Start by sorting the
-		// vector of devices - anything else that has to sort the entire list
-        // has to sort it themselves
-        std::stable_sort(tracked_vec.begin(), tracked_vec.end(), 
-                devicetracker_sort_lastseen);
+        // Remove the least recently seen devices until we're under the limit; the
+        // top of the heap is the oldest device once its entry is current
+        while (tracked_map.size() > max_num_devices && !device_expiry_heap.empty()) {
+            auto e = device_expiry_heap.top();
+            device_expiry_heap.pop();
 
-        tracked_vec.erase(std::remove_if(tracked_vec.begin() + max_num_devices, tracked_vec.end(),
-                [&](std::shared_ptr<kis_tracked_device_base> d) {
-                    // Lock the device itself
-                    local_locker devlocker(&(d->device_mutex));
+            auto di = tracked_map.find(e.key);
 
-                    device_itr mi = tracked_map.find(d->get_key());
+            if (di == tracked_map.end())
+                continue;
 
-                    if (mi != tracked_map.end())
-                        tracked_map.erase(mi);
+            auto d = di->second;
 
-                    // Erase it from the multimap
-                    auto mmp = tracked_mac_multimap.equal_range(d->get_macaddr());
+            local_locker devlocker(&(d->device_mutex));
 
-                    for (auto mmpi = mmp.first; mmpi != mmp.second; ++mmpi) {
-                        if (mmpi->second->get_key() == d->get_key()) {
-                            tracked_mac_multimap.erase(mmpi);
-                            break;
-                        }
-                    }
+            if (d->get_last_time() != e.last_time) {
+                device_expiry_heap.push({d->get_last_time(), e.key});
+                continue;
+            }
 
-                    // Forget it from the immutable vec, but keep its 
-                    // position; we need to have vecpos = devid
-                    auto iti = immutable_tracked_vec->begin() + d->get_kis_internal_id();
-                    (*iti).reset();
+            remove_tracked_device(d);
+            purged.push_back(d);
+        }
 
-                    return true;
-         
-                    }), tracked_vec.end());
+        if (purged.size() > 0) {
+            remove_view_devices(purged);
+            update_full_refresh();
+        }
 	}
 }
 
@@ -1401,11 +1462,12 @@ void device_tracker::add_device(std::shared_ptr<kis_tracked_device_base> device)
     device->set_kis_internal_id(immutable_tracked_vec->size());
 
     tracked_map[device->get_key()] = device;
-    tracked_vec.push_back(device);
     immutable_tracked_vec->push_back(device);
 
     auto mm_pair = std::make_pair(device->get_macaddr(), device);
     tracked_mac_multimap.emplace(mm_pair);
+
+    queue_device_expiry(device);
 }
 
 bool device_tracker::add_view(std::shared_ptr<device_tracker_view> in_view) {
@@ -1427,6 +1489,18 @@ bool device_tracker::add_view(std::shared_ptr<device_tracker_view> in_view) {
     return true;
 }
 
+void device_tracker::enable_view_indexes(std::shared_ptr<device_tracker_view> in_view) {
+    if (map_view_indexes)
+        in_view->enable_search_index();
+
+    if (map_view_sorting) {
+        in_view->enable_sort_index("kismet.device.base.last_time");
+        in_view->enable_sort_index("kismet.device.base.packets.total");
+        in_view->enable_sort_index("kismet.device.base.signal/kismet.common.signal.last_signal");
+        in_view->enable_sort_index("kismet.device.base.commonname");
+    }
+}
+
 void device_tracker::remove_view(const std::string& in_id) {
     local_locker l(&view_mutex);
         
@@ -1457,6 +1531,36 @@ void device_tracker::update_view_device(std::shared_ptr<kis_tracked_device_base>
     }
 }
 
+void device_tracker::rename_view_device(const device_key& in_key, const std::string& in_name) {
+    std::lock_guard<std::mutex> l(pending_rename_mutex);
+    pending_view_renames[in_key] = in_name;
+}
+
+void device_tracker::apply_view_renames() {
+    // One thread applies renames at a time, so an older name never lands after a newer one
+    std::lock_guard<std::mutex> al(apply_rename_mutex);
+
+    std::unordered_map<device_key, std::string> renames;
+
+    {
+        std::lock_guard<std::mutex> l(pending_rename_mutex);
+
+        if (pending_view_renames.size() == 0)
+            return;
+
+        renames.swap(pending_view_renames);
+    }
+
+    local_shared_locker l(&view_mutex);
+
+    for (const auto& i : *view_vec) {
+        auto vi = std::static_pointer_cast<device_tracker_view>(i);
+
+        for (const auto& r : renames)
+            vi->rename_device(r.first, r.second);
+    }
+}
+
 void device_tracker::remove_view_device(std::shared_ptr<kis_tracked_device_base> in_device) {
     local_shared_locker l(&view_mutex);
 
@@ -1466,6 +1570,15 @@ void device_tracker::remove_view_device(std::shared_ptr<kis_tracked_device_base>
     }
 }
 
+void device_tracker::remove_view_devices(const std::vector<std::shared_ptr<kis_tracked_device_base>>& in_devices) {
+    local_shared_locker l(&view_mutex);
+
+    for (const auto& i : *view_vec) {
+        auto vi = std::static_pointer_cast<device_tracker_view>(i);
+        vi->remove_devices(in_devices);
+    }
+}
+
 std::shared_ptr<device_tracker_view> device_tracker::get_phy_view(int in_phyid) {
     local_shared_locker l(&view_mutex);
 
@@ -26,6 +26,8 @@
 #include <time.h>
 #include <list>
 #include <map>
+#include <mutex>
+#include <queue>
 #include <unordered_map>
 #include <vector>
 #include <algorithm>
@@ -214,7 +216,13 @@ public:
 
     virtual void new_view_device(std::shared_ptr<kis_tracked_device_base> in_device);
     virtual void update_view_device(std::shared_ptr<kis_tracked_device_base> in_device);
+    // Common names change while the device is locked, and views lock devices while holding
+    // their own lock, so renames are queued and applied to the view indexes by
+    // apply_view_renames() before the indexes are used
+    virtual void rename_view_device(const device_key& in_key, const std::string& in_name);
+    virtual void apply_view_renames();
     virtual void remove_view_device(std::shared_ptr<kis_tracked_device_base> in_device);
+    virtual void remove_view_devices(const std::vector<std::shared_ptr<kis_tracked_device_base>>& in_devices);
 
     // Get phy views
     std::shared_ptr<device_tracker_view> get_phy_view(int in_phy);
@@ -240,6 +248,13 @@ public:
     void unlock_device_range(std::shared_ptr<tracker_element_device_key_map> device_map);
     void unlock_device_range(std::shared_ptr<tracker_element_mac_map> device_map);
 
+    // View responses with at least this many devices are serialized in parallel by
+    // get_serialize_threads() workers; 0 disables parallel serialization
+    unsigned int get_parallel_serialize_min() const { return parallel_serialize_min; }
+    unsigned int get_serialize_threads() const { return serialize_threads; }
+    // Bounded pool shared by every parallel serialization
+    kis_thread_pool& serialize_pool() { return *serialize_pool_; }
+
 protected:
     std::shared_ptr<entry_tracker> entrytracker;
     std::shared_ptr<packet_chain> packetchain;
@@ -264,6 +279,11 @@ protected:
     bool map_phy_views;
     std::unordered_map<int, std::shared_ptr<device_tracker_view>> phy_view_map;
 
+    // Search indexes and sorted orders on the all and phy views
+    bool map_view_indexes;
+    bool map_view_sorting;
+    void enable_view_indexes(std::shared_ptr<device_tracker_view> in_view);
+
     // Base IDs for tracker components
     int device_list_base_id, device_base_id;
     int device_summary_base_id;
@@ -286,6 +306,11 @@ protected:
     // Total packet history
     std::shared_ptr<kis_tracked_rrd<> > packets_rrd;
 
+    // Parallel serialization of large view responses
+    unsigned int parallel_serialize_min;
+    unsigned int serialize_threads;
+    std::unique_ptr<kis_thread_pool> serialize_pool_;
+
     // Timeout of idle devices
     int device_idle_expiration;
     int device_idle_timer;
@@ -298,6 +323,33 @@ protected:
     unsigned int max_num_devices;
     int max_devices_timer;
 
+    // Time-ordered expiry indexes, one for idle timeouts and one for the maximum device
+    // limit.  Entries record the last-seen time of a device when they were queued,
+    // which is never later than the real last-seen time; stale entries are refreshed
+    // when they reach the top of the heap, so the packet path never touches the index
+    // and each expiry pass only examines devices which may be due.  Devices which can
+    // no longer be idle-expired are dropped from the idle index.
+    struct device_expiry_entry {
+        time_t last_time;
+        device_key key;
+
+        bool operator>(const device_expiry_entry& e) const {
+            return last_time > e.last_time;
+        }
+    };
+
+    using device_expiry_heap_t = std::priority_queue<device_expiry_entry, 
+          std::vector<device_expiry_entry>, std::greater<device_expiry_entry>>;
+
+    device_expiry_heap_t device_idle_heap;
+    device_expiry_heap_t device_expiry_heap;
+
+    void queue_device_expiry(std::shared_ptr<kis_tracked_device_base> device);
+
+    // Remove a device from the tracked maps; must be called under the devicelist_mutex.  
+    // Views are updated separately, in bulk, by remove_view_devices
+    void remove_tracked_device(std::shared_ptr<kis_tracked_device_base> device);
+
     // Timer event for storing devices
     int device_storage_timer;
 
@@ -340,8 +392,6 @@ protected:
 
 	// Tracked devices
     device_map_t tracked_map;
-	// Vector of tracked devices so we can iterate them quickly
-    std::vector<std::shared_ptr<kis_tracked_device_base> > tracked_vec;
     // MAC address lookups are incredibly expensive from the webui if we don't
     // track by map; in theory multiple objects in different PHYs could have the
     // same MAC so it's not a simple 1:1 map
@@ -356,6 +406,12 @@ protected:
     kis_recursive_timed_mutex view_mutex;
     std::shared_ptr<tracker_element_vector> view_vec;
 
+    // Latest common name of each renamed device not yet applied to the views; the
+    // pending mutex is only ever held on its own
+    std::mutex pending_rename_mutex;
+    std::mutex apply_rename_mutex;
+    std::unordered_map<device_key, std::string> pending_view_renames;
+
     using shared_con = std::shared_ptr<kis_net_beast_httpd_connection>;
     std::shared_ptr<tracker_element> multimac_endp_handler(shared_con con);
     std::shared_ptr<tracker_element> all_phys_endp_handler(shared_con con);
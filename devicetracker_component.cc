@@ -30,6 +30,7 @@
 #include <arpa/inet.h>
 #include <pthread.h>
 
+#include "devicetracker.h"
 #include "devicetracker_component.h"
 #include "kis_datasource.h"
 
@@ -538,6 +539,13 @@ void kis_tracked_device_base::reserve_fields(std::shared_ptr<tracker_element_map
     }
 }
 
+void kis_tracked_device_base::commonname_changed() {
+    auto devicetracker = Globalreg::fetch_global_as<device_tracker>();
+
+    if (devicetracker != nullptr)
+        devicetracker->rename_view_device(get_key(), get_commonname());
+}
+
 void kis_tracked_device_base::add_related_device(const std::string& in_relationship, const device_key in_key) {
     auto related_group_i = related_devices_map->find(in_relationship);
 
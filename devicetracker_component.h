@@ -464,7 +464,22 @@ public:
             return true;
             });
 
-    __Proxy(commonname, std::string, std::string, std::string, commonname);
+    virtual shared_tracker_element get_tracker_commonname() const {
+        return commonname;
+    }
+
+    virtual std::string get_commonname() const {
+        return get_tracker_value<std::string>(commonname);
+    }
+
+    // Views index the common name, so they are told when it actually changes
+    virtual void set_commonname(const std::string& in) {
+        if (commonname->get() == in)
+            return;
+
+        commonname->set(in);
+        commonname_changed();
+    }
 
     // __Proxy(type_string, std::string, std::string, std::string, type_string);
     __ProxySwappingTrackable(type_string, tracker_element_string, type_string);
@@ -605,6 +620,9 @@ protected:
     virtual void register_fields() override;
     virtual void reserve_fields(std::shared_ptr<tracker_element_map> e) override;
 
+    // Notify the device views of a new common name
+    void commonname_changed();
+
     // Unique, meaningless, incremental ID.  Practically, this is the order
     // in which kismet saw devices; it has no purpose other than a sorting
     // key which will always preserve order - time, etc, will not.  Used for breaking
@@ -21,11 +21,15 @@
 #include "devicetracker_view.h"
 #include "devicetracker.h"
 #include "devicetracker_component.h"
+#include "json_adapter.h"
+#include "messagebus.h"
 #include "util.h"
 
 #include "kis_mutex.h"
 #include "kismet_algorithm.h"
 
+#include <condition_variable>
+
 device_tracker_view::device_tracker_view(const std::string& in_id, const std::string& in_description, 
         new_device_cb in_new_cb, updated_device_cb in_update_cb) :
     tracker_component{},
@@ -132,6 +136,11 @@ std::shared_ptr<tracker_element_vector> device_tracker_view::do_device_work(devi
 }
 
 std::shared_ptr<tracker_element_vector> device_tracker_view::do_readonly_device_work(device_tracker_view_worker& worker) {
+    // Searches which can be answered from the index only need to check the candidates
+    auto candidates = search_candidates(worker);
+    if (candidates != nullptr)
+        return do_readonly_device_work(worker, candidates);
+
     // Make a copy of the vector
     std::shared_ptr<tracker_element_vector> immutable_copy;
     {
@@ -142,6 +151,104 @@ std::shared_ptr<tracker_element_vector> device_tracker_view::do_readonly_device_
     return do_readonly_device_work(worker, immutable_copy);
 }
 
+void device_tracker_view::enable_search_index() {
+    local_locker l(&mutex);
+
+    if (search_index != nullptr)
+        return;
+
+    search_index = std::make_shared<device_tracker_view_index>();
+
+    for (const auto& d : *device_list)
+        search_index->add_device(std::static_pointer_cast<kis_tracked_device_base>(d));
+}
+
+void device_tracker_view::enable_sort_index(const std::string& in_field_path) {
+    local_locker l(&mutex);
+
+    auto sort_index = std::make_shared<device_tracker_view_sort_index>(in_field_path);
+
+    if (sort_index->get_path().size() == 0 || find_sort_index(sort_index->get_path()) != nullptr)
+        return;
+
+    for (const auto& d : *device_list)
+        sort_index->update_device(std::static_pointer_cast<kis_tracked_device_base>(d));
+
+    sort_indexes.push_back(sort_index);
+
+    if (in_field_path == "kismet.device.base.last_time")
+        last_time_sort_index = sort_index;
+}
+
+std::shared_ptr<device_tracker_view_sort_index> device_tracker_view::find_sort_index(const std::vector<int>& in_path) {
+    for (const auto& s : sort_indexes) 
+        if (s->get_path() == in_path)
+            return s;
+
+    return nullptr;
+}
+
+void device_tracker_view::index_device(std::shared_ptr<kis_tracked_device_base> device) {
+    if (search_index != nullptr)
+        search_index->add_device(device);
+
+    for (const auto& s : sort_indexes)
+        s->update_device(device);
+}
+
+void device_tracker_view::unindex_device(const device_key& key) {
+    if (search_index != nullptr)
+        search_index->remove_device(key);
+
+    for (const auto& s : sort_indexes)
+        s->remove_device(key);
+}
+
+std::shared_ptr<tracker_element_vector> device_tracker_view::search_candidates(device_tracker_view_worker& worker) {
+    std::string query;
+    std::vector<std::vector<int>> paths;
+
+    if (!worker.get_search_terms(query, paths))
+        return nullptr;
+
+    devicetracker->apply_view_renames();
+
+    local_shared_locker l(&mutex);
+
+    if (search_index == nullptr)
+        return nullptr;
+
+    std::vector<std::shared_ptr<kis_tracked_device_base>> devices;
+
+    if (!search_index->search_candidates(query, paths, devices))
+        return nullptr;
+
+    // Return the candidates in view order, so results come back the same as a full scan
+    std::vector<std::pair<size_t, std::shared_ptr<kis_tracked_device_base>>> ordered;
+    ordered.reserve(devices.size());
+
+    for (const auto& d : devices) {
+        auto dpmi = device_presence_map.find(d->get_key());
+
+        if (dpmi != device_presence_map.end())
+            ordered.emplace_back(dpmi->second, d);
+    }
+
+    std::sort(ordered.begin(), ordered.end(),
+            [](const std::pair<size_t, std::shared_ptr<kis_tracked_device_base>>& a,
+                const std::pair<size_t, std::shared_ptr<kis_tracked_device_base>>& b) -> bool {
+                return a.first < b.first;
+            });
+
+    auto ret = std::make_shared<tracker_element_vector>();
+    ret->reserve(ordered.size());
+
+    for (const auto& d : ordered)
+        ret->push_back(d.second);
+
+    return ret;
+}
+
 std::shared_ptr<tracker_element_vector> device_tracker_view::do_device_work(device_tracker_view_worker& worker,
         std::shared_ptr<tracker_element_vector> devices) {
     auto ret = std::make_shared<tracker_element_vector>();
@@ -212,8 +319,9 @@ void device_tracker_view::new_device(std::shared_ptr<kis_tracked_device_base> de
             auto dpmi = device_presence_map.find(device->get_key());
 
             if (dpmi == device_presence_map.end()) {
-                device_presence_map[device->get_key()] = true;
-                device_list->push_back(device);
+                append_device(device);
+
+                index_device(device);
             }
 
             list_sz->set(device_list->size());
@@ -235,47 +343,85 @@ void device_tracker_view::update_device(std::shared_ptr<kis_tracked_device_base>
         // If we're adding the device (or keeping it) and we don't have it tracked,
         // add it and record it in the presence map
         if (retain && dpmi == device_presence_map.end()) {
-            device_list->push_back(device);
-            device_presence_map[device->get_key()] = true;
+            append_device(device);
+
+            index_device(device);
+
             list_sz->set(device_list->size());
             return;
         }
 
-        // if we're removing the device, find it in the vector and remove it, and remove
-        // it from the presence map; this is expensive
+        // If we're removing the device, remove it from the vector and presence map
         if (!retain && dpmi != device_presence_map.end()) {
-            for (auto di = device_list->begin(); di != device_list->end(); ++di) {
-                if (*di == device) {
-                    device_list->erase(di);
-                    break;
-                }
-            }
-            device_presence_map.erase(dpmi);
+            erase_device(dpmi);
+
+            unindex_device(device->get_key());
+
             list_sz->set(device_list->size());
             return;
         }
+
+        // Otherwise a device we're keeping may have moved in the sort order
+        if (retain) {
+            for (const auto& s : sort_indexes)
+                s->update_device(device);
+        }
     }
 }
 
+void device_tracker_view::append_device(std::shared_ptr<kis_tracked_device_base> device) {
+    device_presence_map[device->get_key()] = device_list->size();
+    device_list->push_back(device);
+}
+
+void device_tracker_view::erase_device(presence_map_t::iterator dpmi) {
+    auto& devices = device_list->get();
+    auto pos = dpmi->second;
+
+    if (pos != devices.size() - 1) {
+        devices[pos] = devices.back();
+        auto moved = std::static_pointer_cast<kis_tracked_device_base>(devices[pos]);
+        device_presence_map[moved->get_key()] = pos;
+    }
+
+    devices.pop_back();
+    device_presence_map.erase(dpmi);
+}
+
 void device_tracker_view::remove_device(std::shared_ptr<kis_tracked_device_base> device) {
     local_locker l(&mutex);
 
     auto di = device_presence_map.find(device->get_key());
 
     if (di != device_presence_map.end()) {
-        device_presence_map.erase(di);
+        erase_device(di);
+
+        unindex_device(device->get_key());
 
-        for (auto vi = device_list->begin(); vi != device_list->end(); ++vi) {
-            if (*vi == device) {
-                device_list->erase(vi);
-                break;
-            }
-        }
-        
         list_sz->set(device_list->size());
     }
 }
 
+void device_tracker_view::remove_devices(const std::vector<std::shared_ptr<kis_tracked_device_base>>& devices) {
+    local_locker l(&mutex);
+
+    bool removed = false;
+
+    for (const auto& d : devices) {
+        auto di = device_presence_map.find(d->get_key());
+
+        if (di != device_presence_map.end()) {
+            erase_device(di);
+            removed = true;
+
+            unindex_device(d->get_key());
+        }
+    }
+
+    if (removed)
+        list_sz->set(device_list->size());
+}
+
 void device_tracker_view::add_device_direct(std::shared_ptr<kis_tracked_device_base> device) {
     local_locker l(&mutex);
 
@@ -284,27 +430,34 @@ void device_tracker_view::add_device_direct(std::shared_ptr<kis_tracked_device_b
     if (di != device_presence_map.end())
         return;
 
-    device_presence_map[device->get_key()] = true;
-    device_list->push_back(device);
+    append_device(device);
+
+    index_device(device);
 
     list_sz->set(device_list->size());
 }
 
+void device_tracker_view::rename_device(const device_key& key, const std::string& name) {
+    local_locker l(&mutex);
+
+    if (search_index != nullptr)
+        search_index->rename_device(key, name);
+
+    for (const auto& s : sort_indexes)
+        if (!s->is_numeric())
+            s->update_device(key);
+}
+
 void device_tracker_view::remove_device_direct(std::shared_ptr<kis_tracked_device_base> device) {
     local_locker l(&mutex);
 
     auto di = device_presence_map.find(device->get_key());
 
     if (di != device_presence_map.end()) {
-        device_presence_map.erase(di);
+        erase_device(di);
+
+        unindex_device(device->get_key());
 
-        for (auto vi = device_list->begin(); vi != device_list->end(); ++vi) {
-            if (*vi == device) {
-                device_list->erase(vi);
-                break;
-            }
-        }
-        
         list_sz->set(device_list->size());
     }
 }
@@ -326,6 +479,21 @@ device_tracker_view::device_time_endpoint(std::shared_ptr<kis_net_beast_httpd_co
         ts = tv;
     }
 
+    // Devices are kept in last_time order, take everything from the timestamp on
+    {
+        local_shared_locker l(&mutex);
+
+        if (last_time_sort_index != nullptr) {
+            std::vector<std::shared_ptr<kis_tracked_device_base>> devices;
+            last_time_sort_index->window(true, 0, 0, devices, true, ts);
+
+            for (const auto& d : devices)
+                ret->push_back(d);
+
+            return ret;
+        }
+    }
+
     auto worker = 
         device_tracker_view_function_worker([&](std::shared_ptr<kis_tracked_device_base> dev) -> bool {
                 if (dev->get_last_time() < ts)
@@ -501,17 +669,116 @@ void device_tracker_view::device_endpoint_handler(std::shared_ptr<kis_net_beast_
         os << "Invalid request: " << e.what() << "\n";
     }
 
+    // Summarize the final window of devices into the output element and send it
+    auto send_window = 
+        [&](tracker_element_vector::iterator si, tracker_element_vector::iterator ei) {
+            // Large plain json arrays are summarized and serialized in parallel, without 
+            // locking the entire range for the whole response
+            auto parallel_min = devicetracker->get_parallel_serialize_min();
+            auto uri = static_cast<std::string>(con->uri());
+            auto dpos = uri.find_last_of(".");
+
+            if (transmit == nullptr && parallel_min > 0 && 
+                    static_cast<unsigned int>(ei - si) >= parallel_min &&
+                    dpos != std::string::npos && uri.substr(dpos + 1) == "json") {
+                // Headers and part of the array may already be out; fail the request
+                // instead of ending the response as if the array were complete
+                if (!serialize_devices_parallel(os, si, ei, summary_vec))
+                    throw std::runtime_error(fmt::format("failed to serialize devices "
+                                "in view {}", get_view_id()));
+                return;
+            }
+
+            auto final_devices_vec = std::make_shared<tracker_element_vector>();
+
+            for (auto i = si; i != ei; ++i) {
+                final_devices_vec->push_back(*i);
+                output_devices_elem->push_back(summarize_tracker_element(*i, summary_vec, rename_map));
+            }
+
+            // If the transmit wasn't assigned to a wrapper...
+            if (transmit == nullptr)
+                transmit = output_devices_elem;
+
+            devicetracker->lock_device_range(final_devices_vec);
+            Globalreg::globalreg->entrytracker->serialize(static_cast<std::string>(con->uri()), os, transmit, rename_map);
+            devicetracker->unlock_device_range(final_devices_vec);
+        };
+
+    // Sorted requests the view keeps an order for only need to collect the window,
+    // as long as there is no filter other than a time filter on the sorted field itself
+    if (search_term.length() == 0 && regex.isNull() && 
+            in_order_column_num.length() && order_field.size() > 0) {
+        auto window_vec = std::make_shared<tracker_element_vector>();
+        bool presorted = false;
+
+        // Sorting by name needs any queued renames
+        devicetracker->apply_view_renames();
+
+        {
+            local_shared_locker l(&mutex);
+
+            auto sort_index = find_sort_index(order_field);
+
+            if (sort_index != nullptr && (timestamp_min == 0 || sort_index == last_time_sort_index)) {
+                std::vector<std::shared_ptr<kis_tracked_device_base>> window;
+
+                // Same order as the full sort below, which is ascending for direction 0
+                auto filtered_sz = sort_index->window(in_order_direction != 0, in_window_start, 
+                        in_window_len, window, timestamp_min > 0, timestamp_min);
+
+                if (in_window_start >= filtered_sz && in_window_start != 0) {
+                    in_window_start = 0;
+                    window.clear();
+                    sort_index->window(in_order_direction != 0, in_window_start, 
+                            in_window_len, window, timestamp_min > 0, timestamp_min);
+                }
+
+                total_sz_elem->set(device_list->size());
+                filtered_sz_elem->set(filtered_sz);
+
+                for (const auto& d : window)
+                    window_vec->push_back(d);
+
+                presorted = true;
+            }
+        }
+
+        if (presorted) {
+            start_elem->set(in_window_start);
+            length_elem->set(window_vec->size());
+
+            send_window(window_vec->begin(), window_vec->end());
+            return;
+        }
+    }
+
     // Next vector we do work on
     auto next_work_vec = std::make_shared<tracker_element_vector>();
 
     // Copy the entire vector list, under lock, to the next work vector; this makes it an independent copy
     // which is protected from the main vector being grown/shrank.  While we're in there, log the total
     // size of the original vector for windowed ops.
+    //
+    // String searches which can be answered by the search index start from the candidate
+    // devices instead of the entire list; the search filter below still checks them.
+    std::shared_ptr<tracker_element_vector> search_vec;
+
+    if (search_term.length() > 0 && search_paths.size() > 0) {
+        auto worker =
+            device_tracker_view_icasestringmatch_worker(search_term, search_paths);
+        search_vec = search_candidates(worker);
+    }
+
     {
         local_shared_locker l(&mutex);
 
-        next_work_vec->set(device_list->begin(), device_list->end());
-        total_sz_elem->set(next_work_vec->size());
+        if (search_vec != nullptr)
+            next_work_vec = search_vec;
+        else
+            next_work_vec->set(device_list->begin(), device_list->end());
+
+        total_sz_elem->set(device_list->size());
     }
 
     // If we have a time filter, apply that first, it's the fastest.
@@ -593,21 +860,183 @@ void device_tracker_view::device_endpoint_handler(std::shared_ptr<kis_net_beast_
             });
     }
 
-    // Summarize into the output element
-    auto final_devices_vec = std::make_shared<tracker_element_vector>();
+    send_window(si, ei);
+}
 
-    for (auto i = si; i != ei; ++i) {
-        final_devices_vec->push_back(*i);
-        output_devices_elem->push_back(summarize_tracker_element(*i, summary_vec, rename_map));
-    }
+bool device_tracker_view::serialize_devices_parallel(std::ostream& os,
+        tracker_element_vector::iterator si, tracker_element_vector::iterator ei,
+        const std::vector<SharedElementSummary>& summary_vec) {
+
+    // Devices per chunk; large enough to amortize the packer setup and the handoff
+    // to the writer, small enough that the first bytes go out quickly
+    const size_t chunk_sz = 256;
+
+    struct serialize_chunk {
+        std::string data;
+        bool done = false;
+        bool error = false;
+    };
+
+    size_t n_devices = ei - si;
+    size_t n_chunks = (n_devices + chunk_sz - 1) / chunk_sz;
+    size_t n_threads = std::min<size_t>(devicetracker->get_serialize_threads(), n_chunks);
+
+    // Workers stay a limited number of chunks ahead of the writer so that a slow 
+    // client doesn't cause the entire response to be held in RAM
+    size_t lookahead = n_threads * 4;
+
+    // Workers may still be queued on the pool when we return; they hold their own
+    // reference to the shared state, and only touch our stack while active
+    struct serialize_state {
+        std::vector<serialize_chunk> chunks;
+        std::mutex mutex;
+        std::condition_variable cv;
+        size_t next_chunk = 0;
+        size_t written = 0;
+        bool cancelled = false;
+        size_t active = 0;
+    };
+
+    auto state = std::make_shared<serialize_state>();
+    state->chunks.resize(n_chunks);
+
+    auto serialize = [&](size_t c, std::string& data) -> bool {
+        std::ostringstream ss;
 
-    // If the transmit wasn't assigned to a wrapper...
-    if (transmit == nullptr)
-        transmit = output_devices_elem;
+        try {
+            // Summaries are renamed per chunk so that workers never share a rename map
+            auto rename_map = std::make_shared<tracker_element_serializer::rename_map>();
+            json_adapter::packer packer(ss, rename_map);
 
-    devicetracker->lock_device_range(final_devices_vec);
-    Globalreg::globalreg->entrytracker->serialize(static_cast<std::string>(con->uri()), os, transmit, rename_map);
-    devicetracker->unlock_device_range(final_devices_vec);
-}
+            auto cs = std::next(si, c * chunk_sz);
+            auto ce = std::next(si, std::min(n_devices, (c + 1) * chunk_sz));
+
+            for (auto i = cs; i != ce; ++i) {
+                auto dev = std::static_pointer_cast<kis_tracked_device_base>(*i);
+
+                local_locker dl(&dev->device_mutex, "device_tracker_view::serialize_devices_parallel");
 
+                if (i != cs)
+                    packer.stream() << ",";
 
+                packer.pack(summarize_tracker_element(*i, summary_vec, rename_map));
+            }
+        } catch (const std::exception& e) {
+            _MSG_ERROR("Failed to serialize devices in view {}: {}", get_view_id(), e.what());
+            return false;
+        }
+
+        data = ss.str();
+        return true;
+    };
+
+    auto worker = [state, &serialize, n_chunks, lookahead]() {
+        {
+            std::lock_guard<std::mutex> l(state->mutex);
+
+            if (state->cancelled)
+                return;
+
+            state->active++;
+        }
+
+        while (true) {
+            size_t c;
+
+            {
+                std::unique_lock<std::mutex> l(state->mutex);
+                state->cv.wait(l, [&]() { 
+                        return state->cancelled || state->next_chunk >= n_chunks || 
+                            state->next_chunk < state->written + lookahead; 
+                        });
+
+                if (state->cancelled || state->next_chunk >= n_chunks) {
+                    // The last worker out lets the writer return
+                    if (--state->active == 0)
+                        state->cv.notify_all();
+                    return;
+                }
+
+                c = state->next_chunk++;
+            }
+
+            std::string data;
+            bool error = !serialize(c, data);
+
+            {
+                std::lock_guard<std::mutex> l(state->mutex);
+                state->chunks[c].data = std::move(data);
+                state->chunks[c].done = true;
+                state->chunks[c].error = error;
+            }
+
+            state->cv.notify_all();
+        }
+    };
+
+    // Workers share a bounded pool with every other request, and the writer serializes
+    // any chunk no worker has picked up yet, so a busy pool only costs parallelism
+    for (size_t t = 0; t < n_threads; t++)
+        devicetracker->serialize_pool().post(worker);
+
+    bool ok = true;
+
+    try {
+        os << "[";
+
+        for (size_t c = 0; c < n_chunks; c++) {
+            std::string data;
+            bool claimed = false;
+            bool error = false;
+
+            {
+                std::unique_lock<std::mutex> l(state->mutex);
+
+                if (state->next_chunk == c) {
+                    state->next_chunk++;
+                    claimed = true;
+                } else {
+                    state->cv.wait(l, [&]() { return state->chunks[c].done; });
+                    error = state->chunks[c].error;
+                    data = std::move(state->chunks[c].data);
+                }
+            }
+
+            if (claimed)
+                error = !serialize(c, data);
+
+            if (error) {
+                ok = false;
+                break;
+            }
+
+            if (c > 0)
+                os << ",";
+
+            os.write(data.data(), data.length());
+            os.flush();
+
+            {
+                std::lock_guard<std::mutex> l(state->mutex);
+                state->written = c + 1;
+            }
+
+            state->cv.notify_all();
+        }
+
+        if (ok)
+            os << "]";
+    } catch (const std::exception&) {
+        ok = false;
+    }
+
+    // Active workers reference our stack, so wait for them to finish
+    {
+        std::unique_lock<std::mutex> l(state->mutex);
+        state->cancelled = true;
+        state->cv.notify_all();
+        state->cv.wait(l, [&]() { return state->active == 0; });
+    }
+
+    return ok;
+}
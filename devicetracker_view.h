@@ -30,6 +30,7 @@
 #include "trackedcomponent.h"
 #include "devicetracker_component.h"
 #include "devicetracker_view_workers.h"
+#include "devicetracker_view_index.h"
 #include "kis_net_beast_httpd.h"
 
 // Common view holder mechanism which handles view endpoints, view filtering, and so on.
@@ -120,6 +121,15 @@ public:
     virtual void add_device_direct(std::shared_ptr<kis_tracked_device_base> device);
     virtual void remove_device_direct(std::shared_ptr<kis_tracked_device_base> device);
 
+    // Maintain secondary indexes used to answer common searches without scanning every
+    // device in the view; see devicetracker_view_index.h
+    void enable_search_index();
+
+    // Keep the view sorted by a field so that sorted windows (such as datatables pages) 
+    // don't need to sort the entire view; the order is maintained as devices are updated
+    // through update_device, so this is only useful on views which receive updates
+    void enable_sort_index(const std::string& in_field_path);
+
 protected:
     std::shared_ptr<device_tracker> devicetracker;
 
@@ -146,10 +156,43 @@ protected:
 
     // Main vector of devices
     std::shared_ptr<tracker_element_vector> device_list;
-    // Map of device presence in our list for fast reference during updates
-    std::unordered_map<device_key, bool> device_presence_map;
+    // Map of device presence in our list, and the position of the device in the list,
+    // for fast reference during updates and removal
+    using presence_map_t = std::unordered_map<device_key, size_t>;
+    presence_map_t device_presence_map;
+
+    // Add or remove a device from the list and presence map; must be called under the
+    // view mutex.  Removal moves the last device into the empty slot, so the list is
+    // not kept in insertion order.
+    void append_device(std::shared_ptr<kis_tracked_device_base> device);
+    void erase_device(presence_map_t::iterator dpmi);
+
+    // Optional search index, protected by the view mutex
+    std::shared_ptr<device_tracker_view_index> search_index;
+
+    // Narrow the devices a worker needs to examine using the search index; returns nullptr
+    // if there is no index or the worker can't be answered from it
+    std::shared_ptr<tracker_element_vector> search_candidates(device_tracker_view_worker& worker);
+
+    // Optional sort indexes, protected by the view mutex; the last_time index is also
+    // used for time-limited queries
+    std::vector<std::shared_ptr<device_tracker_view_sort_index>> sort_indexes;
+    std::shared_ptr<device_tracker_view_sort_index> last_time_sort_index;
+
+    std::shared_ptr<device_tracker_view_sort_index> find_sort_index(const std::vector<int>& in_path);
+
+    void index_device(std::shared_ptr<kis_tracked_device_base> device);
+    void unindex_device(const device_key& key);
 
     void device_endpoint_handler(std::shared_ptr<kis_net_beast_httpd_connection> con);
+
+    // Serialize a range of devices as a json array, summarizing and packing chunks of
+    // devices on the httpd generator pool.  Each device is locked only while it is packed,
+    // and chunks are written to the stream in order as they complete.  Returns false
+    // if serialization failed; the output is then incomplete.
+    bool serialize_devices_parallel(std::ostream& os,
+            tracker_element_vector::iterator si, tracker_element_vector::iterator ei,
+            const std::vector<SharedElementSummary>& summary_vec);
     std::shared_ptr<tracker_element> device_time_endpoint(std::shared_ptr<kis_net_beast_httpd_connection> con);
 
     // device_tracker has direct access to protected methods for new devices and purging devices,
@@ -162,6 +205,12 @@ protected:
     // Remove a device from any views; this is called when the devicetracker times out a 
     // device record.
     virtual void remove_device(std::shared_ptr<kis_tracked_device_base> device);
+    // Called when a batch of devices is purged; this removes them in a single pass over
+    // the device list
+    virtual void remove_devices(const std::vector<std::shared_ptr<kis_tracked_device_base>>& devices);
+
+    // Called when the common name of a device changes, to update the search index
+    virtual void rename_device(const device_key& key, const std::string& name);
 
 };
 
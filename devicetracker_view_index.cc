@@ -0,0 +1,424 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+
+#include "devicetracker_view_index.h"
+#include "entrytracker.h"
+
+namespace {
+
+std::string index_upper(const std::string& s) {
+    std::string r(s);
+
+    for (auto& c : r)
+        c = std::toupper(c);
+
+    return r;
+}
+
+// MACs are stored as the most significant bytes of longmac; shifting off the leading
+// bytes gives each suffix, left-aligned
+uint64_t mac_suffix(uint64_t longmac, unsigned int pos) {
+    return longmac << (8 * pos);
+}
+
+// Only suffixes which start inside the address are indexed; the rest are nothing but
+// zero padding, identical for every device
+unsigned int mac_suffix_count(const mac_addr& mac) {
+    return mac.length();
+}
+
+}
+
+device_tracker_view_index::device_tracker_view_index() {
+
+    macaddr_id =
+        Globalreg::globalreg->entrytracker->get_field_id("kismet.device.base.macaddr");
+    commonname_id =
+        Globalreg::globalreg->entrytracker->get_field_id("kismet.device.base.commonname");
+}
+
+void device_tracker_view_index::add_device(std::shared_ptr<kis_tracked_device_base> device) {
+    auto key = device->get_key();
+
+    if (devices.find(key) != devices.end())
+        return;
+
+    auto name = index_upper(device->get_commonname());
+
+    devices[key] = index_entry{device, name};
+
+    auto mac = device->get_macaddr();
+    for (unsigned int p = 0; p < mac_suffix_count(mac); p++)
+        mac_suffixes.emplace(mac_suffix(mac.longmac, p), key);
+
+    index_name(key, name);
+}
+
+void device_tracker_view_index::remove_device(const device_key& key) {
+    auto di = devices.find(key);
+
+    if (di == devices.end())
+        return;
+
+    auto mac = di->second.device->get_macaddr();
+    for (unsigned int p = 0; p < mac_suffix_count(mac); p++)
+        mac_suffixes.erase(std::make_pair(mac_suffix(mac.longmac, p), key));
+
+    unindex_name(key, di->second.name);
+
+    devices.erase(di);
+}
+
+void device_tracker_view_index::rename_device(const device_key& key, const std::string& name) {
+    auto di = devices.find(key);
+
+    if (di == devices.end())
+        return;
+
+    auto uname = index_upper(name);
+
+    if (uname == di->second.name)
+        return;
+
+    unindex_name(key, di->second.name);
+    index_name(key, uname);
+    di->second.name = uname;
+}
+
+void device_tracker_view_index::clear() {
+    devices.clear();
+    mac_suffixes.clear();
+    name_trigrams.clear();
+}
+
+void device_tracker_view_index::index_name(const device_key& key, const std::string& name) {
+    for (size_t p = 0; p + 3 <= name.length(); p++)
+        name_trigrams[trigram(name, p)].insert(key);
+}
+
+void device_tracker_view_index::unindex_name(const device_key& key, const std::string& name) {
+    for (size_t p = 0; p + 3 <= name.length(); p++) {
+        auto ti = name_trigrams.find(trigram(name, p));
+
+        if (ti == name_trigrams.end())
+            continue;
+
+        ti->second.erase(key);
+
+        if (ti->second.size() == 0)
+            name_trigrams.erase(ti);
+    }
+}
+
+bool device_tracker_view_index::mac_candidates(uint64_t term, unsigned int term_len,
+        std::unordered_set<device_key>& ret) {
+
+    if (term_len == 0 || term_len > MAC_LEN_MAX)
+        return false;
+
+    // A term of nothing but zeros also matches inside the zero padding after a short MAC,
+    // which isn't indexed
+    if (term == 0)
+        return false;
+
+    // Left-align the term to match the suffixes, and take every suffix it prefixes
+    auto shift = 8 * (MAC_LEN_MAX - term_len);
+    uint64_t lower = term << shift;
+    uint64_t upper = shift == 0 ? lower : lower | ((1ULL << shift) - 1);
+
+    for (auto mi = mac_suffixes.lower_bound(std::make_pair(lower, device_key()));
+            mi != mac_suffixes.end() && mi->first <= upper; ++mi)
+        ret.insert(mi->second);
+
+    return true;
+}
+
+bool device_tracker_view_index::name_candidates(const std::string& query,
+        std::unordered_set<device_key>& ret) {
+
+    auto uquery = index_upper(query);
+
+    if (uquery.length() < 3)
+        return false;
+
+    // Start from the rarest trigram and intersect the rest
+    std::vector<const std::unordered_set<device_key> *> sets;
+
+    for (size_t p = 0; p + 3 <= uquery.length(); p++) {
+        auto ti = name_trigrams.find(trigram(uquery, p));
+
+        // A trigram nobody has means no name matches
+        if (ti == name_trigrams.end())
+            return true;
+
+        sets.push_back(&ti->second);
+    }
+
+    std::sort(sets.begin(), sets.end(),
+            [](const std::unordered_set<device_key> *a, const std::unordered_set<device_key> *b) -> bool {
+                return a->size() < b->size();
+            });
+
+    for (const auto& k : *sets[0]) {
+        bool found = true;
+
+        for (size_t s = 1; s < sets.size(); s++) {
+            if (sets[s]->find(k) == sets[s]->end()) {
+                found = false;
+                break;
+            }
+        }
+
+        if (found)
+            ret.insert(k);
+    }
+
+    return true;
+}
+
+bool device_tracker_view_index::search_candidates(const std::string& query,
+        const std::vector<std::vector<int>>& paths,
+        std::vector<std::shared_ptr<kis_tracked_device_base>>& ret) {
+
+    bool search_mac = false;
+    bool search_name = false;
+
+    for (const auto& p : paths) {
+        if (p.size() == 0)
+            continue;
+
+        if (p.size() == 1 && p[0] == macaddr_id) {
+            search_mac = true;
+            continue;
+        }
+
+        if (p.size() == 1 && p[0] == commonname_id) {
+            search_name = true;
+            continue;
+        }
+
+        // String searches only ever match string, binary, and mac fields; any other
+        // type of field can't contribute a match and doesn't need an index
+        auto f = Globalreg::globalreg->entrytracker->get_shared_instance(p[p.size() - 1]);
+
+        if (f == nullptr)
+            return false;
+
+        switch (f->get_type()) {
+            case tracker_type::tracker_string:
+            case tracker_type::tracker_byte_array:
+            case tracker_type::tracker_mac_addr:
+                return false;
+            default:
+                break;
+        }
+    }
+
+    std::unordered_set<device_key> keys;
+
+    if (search_mac) {
+        uint64_t term;
+        unsigned int term_len;
+
+        // If the query can't be a MAC the workers won't match against MACs at all
+        if (mac_addr::prepare_search_term(query, term, term_len) && term_len != 0) {
+            if (!mac_candidates(term, term_len, keys))
+                return false;
+        }
+    }
+
+    if (search_name) {
+        if (!name_candidates(query, keys))
+            return false;
+    }
+
+    ret.reserve(keys.size());
+
+    for (const auto& k : keys) {
+        auto di = devices.find(k);
+        if (di != devices.end())
+            ret.push_back(di->second.device);
+    }
+
+    return true;
+}
+
+device_tracker_view_sort_index::device_tracker_view_sort_index(const std::string& in_path) :
+    numeric{true},
+    next_seq{0} {
+
+    path = tracker_element_summary(in_path).resolved_path;
+
+    if (path.size() > 0) {
+        auto f = Globalreg::globalreg->entrytracker->get_shared_instance(path[path.size() - 1]);
+
+        if (f != nullptr && f->get_type() == tracker_type::tracker_string)
+            numeric = false;
+    }
+}
+
+bool device_tracker_view_sort_index::read_num(const std::shared_ptr<tracker_element>& f,
+        double& num) {
+    if (f == nullptr)
+        return false;
+
+    switch (f->get_type()) {
+        case tracker_type::tracker_int8:
+            num = get_tracker_value<int8_t>(f);
+            break;
+        case tracker_type::tracker_uint8:
+            num = get_tracker_value<uint8_t>(f);
+            break;
+        case tracker_type::tracker_int16:
+            num = get_tracker_value<int16_t>(f);
+            break;
+        case tracker_type::tracker_uint16:
+            num = get_tracker_value<uint16_t>(f);
+            break;
+        case tracker_type::tracker_int32:
+            num = get_tracker_value<int32_t>(f);
+            break;
+        case tracker_type::tracker_uint32:
+            num = get_tracker_value<uint32_t>(f);
+            break;
+        case tracker_type::tracker_int64:
+            num = get_tracker_value<int64_t>(f);
+            break;
+        case tracker_type::tracker_uint64:
+            num = get_tracker_value<uint64_t>(f);
+            break;
+        case tracker_type::tracker_float:
+            num = get_tracker_value<float>(f);
+            break;
+        case tracker_type::tracker_double:
+            num = get_tracker_value<double>(f);
+            break;
+        default:
+            return false;
+    }
+
+    // NaN has no place in an ordering
+    return !std::isnan(num);
+}
+
+device_tracker_view_sort_index::sort_value 
+device_tracker_view_sort_index::read_value(const std::shared_ptr<tracker_element>& f,
+        uint64_t seq) {
+    sort_value v{true, 0, "", seq};
+
+    if (f != nullptr && f->get_type() == tracker_type::tracker_string) {
+        v.missing = false;
+        v.str = get_tracker_value<std::string>(f);
+    } else if (read_num(f, v.num)) {
+        v.missing = false;
+    } else {
+        v.num = 0;
+    }
+
+    return v;
+}
+
+bool device_tracker_view_sort_index::value_changed(const std::shared_ptr<tracker_element>& f,
+        const sort_value& v) {
+    if (f != nullptr && f->get_type() == tracker_type::tracker_string) 
+        return v.missing || v.num != 0 ||
+            v.str != std::static_pointer_cast<tracker_element_string>(f)->get();
+
+    double num = 0;
+
+    if (!read_num(f, num))
+        return !v.missing;
+
+    return v.missing || v.num != num || !v.str.empty();
+}
+
+void device_tracker_view_sort_index::update_device(std::shared_ptr<kis_tracked_device_base> device) {
+    auto key = device->get_key();
+    auto pi = positions.find(key);
+    auto f = get_tracker_element_path(path, device);
+
+    if (pi == positions.end()) {
+        auto v = read_value(f, next_seq++);
+        ordered.emplace(v, device);
+        positions.emplace(key, v);
+        return;
+    }
+
+    // Most updates leave the sort key alone (a timestamp in the same second, the same 
+    // name); check the snapshot in place before copying anything or touching the map
+    if (!value_changed(f, pi->second))
+        return;
+
+    auto v = read_value(f, pi->second.seq);
+
+    // Counters and timestamps generally only grow, so the new position is usually at 
+    // or just past the old one; hint from there, or from the end if it moved further
+    auto hint = ordered.end();
+    auto oi = ordered.find(pi->second);
+
+    if (oi != ordered.end()) {
+        hint = ordered.erase(oi);
+
+        if (hint != ordered.end() && hint->first < v)
+            hint = ordered.end();
+    }
+
+    ordered.emplace_hint(hint, v, device);
+    pi->second = std::move(v);
+}
+
+void device_tracker_view_sort_index::update_device(const device_key& key) {
+    auto pi = positions.find(key);
+
+    if (pi == positions.end())
+        return;
+
+    auto oi = ordered.find(pi->second);
+
+    if (oi == ordered.end())
+        return;
+
+    update_device(oi->second);
+}
+
+void device_tracker_view_sort_index::remove_device(const device_key& key) {
+    auto pi = positions.find(key);
+
+    if (pi == positions.end())
+        return;
+
+    ordered.erase(pi->second);
+    positions.erase(pi);
+}
+
+void device_tracker_view_sort_index::clear() {
+    ordered.clear();
+    positions.clear();
+}
+
+size_t device_tracker_view_sort_index::window(bool descending, size_t start, size_t len,
+        std::vector<std::shared_ptr<kis_tracked_device_base>>& ret,
+        bool use_min, double min) {
+    return walk_window(ordered, descending, start, len, ret, use_min, min);
+}
@@ -0,0 +1,218 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __DEVICE_VIEW_INDEX_H__
+#define __DEVICE_VIEW_INDEX_H__
+
+#include "config.h"
+
+#include <map>
+#include <set>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "devicetracker_component.h"
+
+// Secondary search indexes for a device view.
+//
+// Searches on views are normally a linear scan which resolves each field path on every
+// device.  The index maintains the values of the fields which are both commonly searched
+// and cheap to keep current, and narrows a search to the devices which could match:
+//
+// MAC address - every byte suffix of each device MAC, up to the length of the MAC;
+// partial MAC searches match any contiguous run of bytes, which is a prefix of one of
+// the suffixes, so a search resolves to a range of the suffix map.  Searches also
+// match the zero padding after a 6-byte MAC, which is not indexed, so a term of only
+// zeros falls back to a full scan.  Device MACs never change.
+//
+// Common name - the trigrams of the uppercased name; a name search resolves to the
+// devices containing every trigram of the query.  Devices queue a rename with the
+// device tracker when their common name changes, which is applied before a search.
+//
+// Lookups only produce candidates; the search worker still checks every candidate, so
+// false positives in the index are harmless.  Candidates are returned in no particular
+// order.
+//
+// The index is not locked independently; it is protected by the owning view.
+class device_tracker_view_index {
+public:
+    device_tracker_view_index();
+
+    void add_device(std::shared_ptr<kis_tracked_device_base> device);
+    void remove_device(const device_key& key);
+    void rename_device(const device_key& key, const std::string& name);
+    void clear();
+
+    // Collect the candidate devices for a string search over the given field paths.
+    // Returns false if any path which could match the query is not indexed, in which
+    // case the caller must fall back to a full scan.
+    bool search_candidates(const std::string& query, const std::vector<std::vector<int>>& paths,
+            std::vector<std::shared_ptr<kis_tracked_device_base>>& ret);
+
+protected:
+    struct index_entry {
+        std::shared_ptr<kis_tracked_device_base> device;
+        std::string name;
+    };
+
+    void index_name(const device_key& key, const std::string& name);
+    void unindex_name(const device_key& key, const std::string& name);
+
+    bool mac_candidates(uint64_t term, unsigned int term_len, std::unordered_set<device_key>& ret);
+    bool name_candidates(const std::string& query, std::unordered_set<device_key>& ret);
+
+    static uint32_t trigram(const std::string& s, size_t pos) {
+        return ((uint32_t) (uint8_t) s[pos] << 16) |
+            ((uint32_t) (uint8_t) s[pos + 1] << 8) |
+            (uint32_t) (uint8_t) s[pos + 2];
+    }
+
+    int macaddr_id;
+    int commonname_id;
+
+    std::unordered_map<device_key, index_entry> devices;
+    // Ordered by suffix, then key, so a device's entries are found directly on removal
+    std::set<std::pair<uint64_t, device_key>> mac_suffixes;
+    std::unordered_map<uint32_t, std::unordered_set<device_key>> name_trigrams;
+};
+
+// Incrementally maintained sort order of a view on a single field (such as last_time,
+// packets, signal, or name), used to return windows of a sorted view without sorting the
+// entire view for every page.
+//
+// The order is kept from a snapshot of the field value taken whenever the view is told
+// a device changed; it is as current as the view updates.  The device is only moved 
+// when the value differs from the snapshot.  Missing fields sort below 
+// every value, matching the behavior of the full sort:  first when ascending, last when
+// descending.  Numeric fields and strings are supported.
+//
+// Like the search index, this is protected by the owning view.
+class device_tracker_view_sort_index {
+public:
+    device_tracker_view_sort_index(const std::string& in_path);
+
+    const std::vector<int>& get_path() const {
+        return path;
+    }
+
+    bool is_numeric() const {
+        return numeric;
+    }
+
+    size_t size() const {
+        return ordered.size();
+    }
+
+    // Add a device, or reposition it if the value changed
+    void update_device(std::shared_ptr<kis_tracked_device_base> device);
+    // Re-read the value of a device already in the index
+    void update_device(const device_key& key);
+    void remove_device(const device_key& key);
+    void clear();
+
+    // Collect a window of [start, start + len) devices in sorted order, len 0 meaning 
+    // through the end.  When a minimum is given, only devices with a (numeric) value of 
+    // at least min are included.  Returns the number of devices which passed the filter.
+    size_t window(bool descending, size_t start, size_t len,
+            std::vector<std::shared_ptr<kis_tracked_device_base>>& ret,
+            bool use_min = false, double min = 0);
+
+    struct sort_value {
+        bool missing;
+        double num;
+        std::string str;
+        uint64_t seq;
+
+        bool operator<(const sort_value& v) const {
+            if (missing != v.missing)
+                return missing;
+
+            if (!missing) {
+                if (num != v.num)
+                    return num < v.num;
+
+                if (str != v.str)
+                    return str < v.str;
+            }
+
+            return seq < v.seq;
+        }
+    };
+
+    // Walk a window of an ordered map; window() on the index, split out so the order can
+    // be checked against the full sort without building devices
+    template<typename T>
+    static size_t walk_window(const std::map<sort_value, T>& ordered, bool descending,
+            size_t start, size_t len, std::vector<T>& ret, bool use_min, double min) {
+        size_t pos = 0;
+
+        auto accept = [&](const T& e) {
+            if (pos >= start && (len == 0 || pos < start + len))
+                ret.push_back(e);
+            pos++;
+        };
+
+        if (!use_min) {
+            if (descending) {
+                for (auto i = ordered.rbegin(); i != ordered.rend() && (len == 0 || pos < start + len); ++i)
+                    accept(i->second);
+            } else {
+                for (auto i = ordered.begin(); i != ordered.end() && (len == 0 || pos < start + len); ++i)
+                    accept(i->second);
+            }
+
+            return ordered.size();
+        }
+
+        // Devices missing the field never pass a minimum; they sort below every value
+        if (descending) {
+            for (auto i = ordered.rbegin(); i != ordered.rend(); ++i) {
+                if (i->first.missing || i->first.num < min)
+                    break;
+
+                accept(i->second);
+            }
+        } else {
+            for (auto i = ordered.lower_bound(sort_value{false, min, "", 0}); i != ordered.end(); ++i)
+                accept(i->second);
+        }
+
+        return pos;
+    }
+
+protected:
+
+    // Numeric value of a field; false if the field is missing, not a number, or NaN
+    static bool read_num(const std::shared_ptr<tracker_element>& f, double& num);
+    sort_value read_value(const std::shared_ptr<tracker_element>& f, uint64_t seq);
+    // Compare the current field against a snapshot without copying it
+    bool value_changed(const std::shared_ptr<tracker_element>& f, const sort_value& v);
+
+    std::vector<int> path;
+    bool numeric;
+
+    uint64_t next_seq;
+
+    std::map<sort_value, std::shared_ptr<kis_tracked_device_base>> ordered;
+    std::unordered_map<device_key, sort_value> positions;
+};
+
+#endif
+
@@ -47,6 +47,13 @@ public:
 
     virtual void finalize() { }
 
+    // String search workers expose their query and field paths so that views can narrow
+    // the devices to check using their indexes; the worker still matches every candidate.
+    // Returns false if the worker is not a string search.
+    virtual bool get_search_terms(std::string& ret_query, std::vector<std::vector<int>>& ret_paths) const {
+        return false;
+    }
+
 protected:
     friend class device_tracker_view;
 
@@ -133,6 +140,12 @@ public:
 
     virtual bool match_device(std::shared_ptr<kis_tracked_device_base> device) override;
 
+    virtual bool get_search_terms(std::string& ret_query, std::vector<std::vector<int>>& ret_paths) const override {
+        ret_query = query;
+        ret_paths = fieldpaths;
+        return true;
+    }
+
 protected:
     std::string query;
     std::vector<std::vector<int>> fieldpaths;
@@ -160,6 +173,12 @@ public:
 
     virtual bool match_device(std::shared_ptr<kis_tracked_device_base> device) override;
 
+    virtual bool get_search_terms(std::string& ret_query, std::vector<std::vector<int>>& ret_paths) const override {
+        ret_query = query;
+        ret_paths = fieldpaths;
+        return true;
+    }
+
 protected:
     std::string query;
     std::vector<std::vector<int>> fieldpaths;
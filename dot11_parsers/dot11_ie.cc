@@ -18,20 +18,29 @@
 
 #include "dot11_ie.h"
 
-void dot11_ie::parse(std::shared_ptr<kaitai::kstream> p_io) {
-    m_tags.reset(new shared_ie_tag_vector());
+void dot11_ie::parse(const char *data, size_t len) {
+    m_tags.clear();
+
+    size_t pos = 0;
+
+    while (pos < len) {
+        if (len - pos < 2)
+            throw std::runtime_error("IE tag truncated");
+
+        uint8_t tag_num = data[pos];
+        uint8_t tag_len = data[pos + 1];
 
-    while (!p_io->is_eof()) {
-        std::shared_ptr<dot11_ie_tag> t(new dot11_ie_tag());
-        t->parse(p_io);
-        m_tags->push_back(t);
+        if (len - pos - 2 < tag_len)
+            throw std::runtime_error("IE tag truncated");
+
+        m_tags.emplace_back(tag_num, tag_len, data + pos + 2);
+
+        pos += 2 + tag_len;
     }
 }
 
-void dot11_ie::dot11_ie_tag::parse(std::shared_ptr<kaitai::kstream> p_io) {
-    m_tag_num = p_io->read_u1();
-    m_tag_len = p_io->read_u1();
-    m_tag_data = p_io->read_bytes(tag_len());
-    m_tag_data_stream.reset(new kaitai::kstream(m_tag_data));
+void dot11_ie::parse(std::shared_ptr<kaitai::kstream> p_io) {
+    m_stream_data = p_io->read_bytes_full();
+    parse(m_stream_data.data(), m_stream_data.length());
 }
 
@@ -19,50 +19,71 @@
 #ifndef __DOT11_IE_H__
 #define __DOT11_IE_H__
 
-/* Parse a dot11 ie stream into individual objects.
+/* Parse a dot11 ie stream into individual tags.
  *
- * This uses the kaitai stream buffer from the kaitai runtime as it is a 
- * solid implementation of buffer-bounded operations and data extraction.
+ * Tags are views into the original buffer; walking the tag list only records the
+ * number, length, and location of each tag, and nothing is copied or allocated per
+ * tag.  Consumers read fields directly from the tag data, or request a kaitai stream
+ * of a tag only when a full parser is needed.
  *
- * Much of this is modeled on how kaitai generates parsers.
+ * When parsed from a buffer, the buffer must outlive the parsed tags; for IE tags 
+ * parsed from a packet this is the packet chunk.  When parsed from a kaitai stream,
+ * the remaining stream is copied once into the ie object.
  *
  */
 
+#include <stdexcept>
 #include <string>
 #include <memory>
 #include <vector>
 #include <kaitai/kaitaistream.h>
 #include "multi_constexpr.h"
+#include "string_view.hpp"
 
 class dot11_ie {
 public:
     class dot11_ie_tag;
-    typedef std::vector<std::shared_ptr<dot11_ie_tag> > shared_ie_tag_vector;
+    typedef std::vector<dot11_ie_tag> ie_tag_vector;
 
-    dot11_ie() {
+    dot11_ie() { }
+    ~dot11_ie() { }
 
-    }
-
-    ~dot11_ie() {
+    // Tags reference our own storage when parsed from a stream
+    dot11_ie(const dot11_ie&) = delete;
+    dot11_ie& operator=(const dot11_ie&) = delete;
 
-    }
+    // Walk the tags in a buffer in place.  Throws std::runtime_error if a tag runs
+    // past the end of the buffer.
+    void parse(const char *data, size_t len);
 
+    // Walk the tags in the remainder of a kaitai stream
     void parse(std::shared_ptr<kaitai::kstream> p_io);
 
-    std::shared_ptr<shared_ie_tag_vector> tags() const {
+    const ie_tag_vector& tags() const {
         return m_tags;
     }
 
+    // First instance of a tag, or nullptr
+    const dot11_ie_tag *find_tag(uint8_t num) const {
+        for (const auto& t : m_tags) {
+            if (t.tag_num() == num)
+                return &t;
+        }
+
+        return nullptr;
+    }
+
 protected:
-    std::shared_ptr<shared_ie_tag_vector> m_tags;
+    std::string m_stream_data;
+    ie_tag_vector m_tags;
 
 public:
     class dot11_ie_tag {
     public:
-        dot11_ie_tag() { } 
-        ~dot11_ie_tag() { }
-
-        void parse(std::shared_ptr<kaitai::kstream> p_io);
+        dot11_ie_tag(uint8_t num, uint8_t len, const char *data) :
+            m_tag_num{num},
+            m_tag_len{len},
+            m_tag_data{data} { }
 
         constexpr17 uint8_t tag_num() const {
             return m_tag_num;
@@ -72,19 +93,45 @@ public:
             return m_tag_len;
         }
 
+        // Tag contents, without copying
+        nonstd::string_view tag_data_view() const {
+            return nonstd::string_view(m_tag_data, m_tag_len);
+        }
+
         std::string tag_data() const {
-            return m_tag_data;
+            return std::string(m_tag_data, m_tag_len);
         }
 
+        // A new stream positioned at the start of the tag contents, for the kaitai
+        // style tag parsers
         std::shared_ptr<kaitai::kstream> tag_data_stream() const {
-            return m_tag_data_stream;
+            auto data = tag_data();
+            return std::make_shared<kaitai::kstream>(data);
+        }
+
+        // OUI and subtype of vendor tags (150, 221), read in place.  Throws 
+        // std::runtime_error if the tag is too short to hold them.
+        uint32_t vendor_oui_int() const {
+            if (m_tag_len < 3)
+                throw std::runtime_error("vendor IE tag too short for OUI");
+
+            return (uint32_t) (
+                    (((uint8_t) m_tag_data[0]) << 16) + 
+                    (((uint8_t) m_tag_data[1]) << 8) +
+                    ((uint8_t) m_tag_data[2]));
+        }
+
+        uint8_t vendor_oui_type() const {
+            if (m_tag_len < 4)
+                return 0;
+
+            return (uint8_t) m_tag_data[3];
         }
 
     protected:
         uint8_t m_tag_num;
         uint8_t m_tag_len;
-        std::string m_tag_data;
-        std::shared_ptr<kaitai::kstream> m_tag_data_stream;
+        const char *m_tag_data;
     };
 
 };
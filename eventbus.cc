@@ -16,9 +16,29 @@
     Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
 */
 
+#include "configfile.h"
 #include "eventbus.h"
 #include "kis_net_beast_httpd.h"
 
+std::shared_ptr<std::string> eventbus_event::get_serialized_content(const std::string& summary_sig,
+        const Json::Value& summary) {
+    local_locker l(&serialize_mutex, "eventbus_event::get_serialized_content");
+
+    auto ci = serialized_cache.find(summary_sig);
+    if (ci != serialized_cache.end())
+        return ci->second;
+
+    std::stringstream ss;
+
+    Globalreg::globalreg->entrytracker->serialize_with_json_summary("json", ss, 
+            get_event_content(), summary);
+
+    auto content = std::make_shared<std::string>(ss.str());
+    serialized_cache[summary_sig] = content;
+
+    return content;
+}
+
 event_bus::event_bus() :
     lifetime_global(),
     deferred_startup() {
@@ -35,6 +55,51 @@ event_bus::event_bus() :
                 tracker_element_factory<eventbus_event>(),
                 "Eventbus event");
 
+    listener_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener",
+                tracker_element_factory<tracker_element_map>(),
+                "Eventbus listener");
+    listener_id_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener.id",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Listener ID");
+    listener_name_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener.name",
+                tracker_element_factory<tracker_element_string>(),
+                "Listener name (async listeners only)");
+    listener_channels_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener.channels",
+                tracker_element_factory<tracker_element_vector>(),
+                "Subscribed channels");
+    listener_async_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener.async",
+                tracker_element_factory<tracker_element_uint8>(),
+                "Listener is delivered from its own queue");
+    listener_queued_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener.queued",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Events waiting for delivery");
+    listener_queue_max_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener.queue_max",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Maximum events waiting for delivery");
+    listener_delivered_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener.delivered",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Events delivered");
+    listener_dropped_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener.dropped",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Events dropped because the listener fell behind");
+    listener_coalesced_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener.coalesced",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Events replaced by a newer event of the same type before delivery");
+    listener_lag_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.eventbus.listener.lag_ms",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Age of the oldest undelivered event, in milliseconds");
+
     event_cl.lock();
 
     event_dispatch_t =
@@ -50,20 +115,57 @@ event_bus::~event_bus() {
 
     event_cl.unlock(0);
     event_dispatch_t.join();
+
+    // Stop any async listener threads
+    for (const auto& i : callback_id_table) {
+        if (!i.second->async)
+            continue;
+
+        {
+            std::lock_guard<std::mutex> ql(i.second->queue_mutex);
+            i.second->stopping = true;
+        }
+
+        i.second->queue_cv.notify_all();
+    }
 }
 
 void event_bus::trigger_deferred_startup() {
     auto httpd = Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>();
 
+    auto ws_queue_max =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("eventbus_ws_queue", 256);
+
+    httpd->register_route("/eventbus/listeners", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                    return listener_stats_endp();
+                }));
+
     httpd->register_websocket_route("/eventbus/events", httpd->RO_ROLE, {"ws"},
             std::make_shared<kis_net_web_function_endpoint>(
-                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
+                [this, ws_queue_max](std::shared_ptr<kis_net_beast_httpd_connection> con) {
 
-                std::unordered_map<std::string, unsigned long> reg_map;
+                // Subscriptions of this connection by channel; shared with the listener,
+                // which may still be delivering an event after the connection closes
+                struct ws_subscription {
+                    Json::Value json;
+                    // Only the fields change the serialized event; subscribers with 
+                    // the same fields share one copy of it
+                    std::string summary_sig;
+                };
+
+                struct ws_subscriptions {
+                    std::mutex mutex;
+                    std::unordered_map<std::string, std::shared_ptr<ws_subscription>> channels;
+                };
+
+                auto subs = std::make_shared<ws_subscriptions>();
+                unsigned long listener_id = 0;
 
                 auto ws = 
                     std::make_shared<kis_net_web_websocket_endpoint>(con, 
-                        [this, &reg_map](std::shared_ptr<kis_net_web_websocket_endpoint> ws,
+                        [this, subs, &listener_id](std::shared_ptr<kis_net_web_websocket_endpoint> ws,
                             boost::beast::flat_buffer& buf, bool text) {
 
                             if (!text) {
@@ -82,48 +184,69 @@ void event_bus::trigger_deferred_startup() {
                             }
 
                             if (!json["SUBSCRIBE"].isNull()) {
-                                auto e_k = reg_map.find(json["SUBSCRIBE"].asString());
-                                if (e_k != reg_map.end()) {
-                                    remove_listener(e_k->second);
-                                    reg_map.erase(e_k);
-                                }
-
-                                auto id = 
-                                    register_listener(json["SUBSCRIBE"].asString(), 
-                                            [ws, json](std::shared_ptr<eventbus_event> evt) {
-                                            
-                                            boost::asio::streambuf stream;
-                                            std::ostream os(&stream);
+                                auto channel = json["SUBSCRIBE"].asString();
+                                auto sub = std::make_shared<ws_subscription>();
 
-                                            Globalreg::globalreg->entrytracker->serialize_with_json_summary("json", os, 
-                                                    evt->get_event_content(), json);
+                                sub->json = json;
+                                sub->summary_sig = 
+                                    json.get("fields", Json::Value(Json::arrayValue)).toStyledString();
 
-                                            ws->write(stream.data(), true);
+                                {
+                                    std::lock_guard<std::mutex> l(subs->mutex);
+                                    subs->channels[channel] = sub;
+                                }
 
-                                            });
-                                
-                                reg_map[json["SUBSCRIBE"].asString()] = id;
+                                subscribe_listener(listener_id, channel, 
+                                        json.get("COALESCE", false).asBool());
                             } 
 
                             if (!json["UNSUBSCRIBE"].isNull()) {
-                                auto e_k = reg_map.find(json["UNSUBSCRIBE"].asString());
-                                if (e_k != reg_map.end()) {
-                                    remove_listener(e_k->second);
-                                    reg_map.erase(e_k);
-                                }
+                                auto channel = json["UNSUBSCRIBE"].asString();
 
+                                unsubscribe_listener(listener_id, channel);
+
+                                std::lock_guard<std::mutex> l(subs->mutex);
+                                subs->channels.erase(channel);
                             }
                         });
 
-                // Blind-catch all errors b/c we must release our listeners at the end
+                // Websocket writes block until the client reads them, so every 
+                // subscription of the connection is delivered from one queue, by the 
+                // one thread which writes to the websocket; clients which only want 
+                // the current state can ask for coalesced events
+                listener_id = 
+                    register_async_listener("websocket", std::list<std::string>{},
+                            [ws, subs](std::shared_ptr<eventbus_event> evt) {
+                                std::shared_ptr<ws_subscription> sub;
+
+                                {
+                                    std::lock_guard<std::mutex> l(subs->mutex);
+
+                                    auto si = subs->channels.find(evt->get_event_id());
+
+                                    if (si == subs->channels.end())
+                                        si = subs->channels.find("*");
+
+                                    // Unsubscribed while the event was queued
+                                    if (si == subs->channels.end())
+                                        return;
+
+                                    sub = si->second;
+                                }
+
+                                auto content = evt->get_serialized_content(sub->summary_sig, sub->json);
+
+                                ws->write(boost::asio::buffer(*content), true);
+                            }, ws_queue_max, false);
+
+                // Blind-catch all errors b/c we must release our listener at the end
                 try {
                     ws->handle_request(con);
                 } catch (const std::exception& e) {
                     ;
                 }
 
-                for (auto s : reg_map)
-                    remove_listener(s.second);
+                remove_listener(listener_id);
 
                 }));
 
@@ -172,11 +295,20 @@ void event_bus::event_queue_dispatcher() {
                     for (const auto& cbl : ch_listeners->second) 
                         workvec.push_back(cbl);
 
+                // A listener subscribed to both only gets one copy
                 if (ch_all_listeners != callback_table.end()) 
                     for (const auto& cbl : ch_all_listeners->second) 
-                        workvec.push_back(cbl);
+                        if (ch_listeners == callback_table.end() ||
+                                std::find(ch_listeners->second.begin(), 
+                                    ch_listeners->second.end(), cbl) == ch_listeners->second.end())
+                            workvec.push_back(cbl);
 
                 for (const auto& cbl : workvec) {
+                    if (cbl->async) {
+                        queue_async(cbl, e);
+                        continue;
+                    }
+
                     try {
                         cbl->cb(e);
                     } catch (const std::exception& e) {
@@ -200,29 +332,161 @@ void event_bus::event_queue_dispatcher() {
     }
 }
 
-unsigned long event_bus::register_listener(const std::string& channel, cb_func cb) {
-    local_locker l(&handler_mutex, "register listener");
+void event_bus::queue_async(std::shared_ptr<callback_listener> cbl, 
+        std::shared_ptr<eventbus_event> evt) {
+    {
+        std::lock_guard<std::mutex> l(cbl->queue_mutex);
+
+        if (cbl->stopping)
+            return;
+
+        if (cbl->coalesce || 
+                cbl->coalesce_channels.find(evt->get_event_id()) != cbl->coalesce_channels.end() ||
+                cbl->coalesce_channels.find("*") != cbl->coalesce_channels.end()) {
+            for (auto& q : cbl->queue) {
+                if (q.first->get_event_id() == evt->get_event_id()) {
+                    // Keep the original time so the lag reflects how long the listener
+                    // has been behind
+                    q.first = evt;
+                    cbl->coalesced++;
+                    return;
+                }
+            }
+        }
+
+        if (cbl->max_queued > 0 && cbl->queue.size() >= cbl->max_queued) {
+            cbl->queue.pop_front();
+            cbl->dropped++;
+        }
+
+        cbl->queue.emplace_back(evt, std::chrono::steady_clock::now());
+    }
+
+    cbl->queue_cv.notify_one();
+}
+
+void event_bus::async_listener_thread(std::shared_ptr<callback_listener> cbl) {
+    thread_set_process_name("eventbus async");
+
+    std::unique_lock<std::mutex> l(cbl->queue_mutex);
+
+    while (true) {
+        cbl->queue_cv.wait(l, [&cbl]() { return cbl->stopping || cbl->queue.size() > 0; });
+
+        if (cbl->stopping)
+            break;
+
+        auto e = cbl->queue.front().first;
+        cbl->queue.pop_front();
 
-    auto cbl = std::make_shared<callback_listener>(std::list<std::string>{channel}, cb, next_cbl_id++);
+        l.unlock();
+
+        try {
+            cbl->cb(e);
+        } catch (const std::exception& e) {
+            _MSG_ERROR("Error in eventbus handler {}: {}", cbl->name, e.what());
+        }
+
+        cbl->delivered++;
+
+        l.lock();
+    }
+
+    // Release anything the callback holds (such as a websocket) with the thread
+    cbl->queue.clear();
+    cbl->cb = nullptr;
+}
+
+unsigned long event_bus::add_listener(std::shared_ptr<callback_listener> cbl) {
+    local_locker l(&handler_mutex, "add listener");
+
+    cbl->id = next_cbl_id++;
+
+    for (const auto& c : cbl->channels)
+        callback_table[c].push_back(cbl);
 
-    callback_table[channel].push_back(cbl);
     callback_id_table[cbl->id] = cbl;
 
+    // The thread holds its own reference; removing the listener stops it
+    if (cbl->async) {
+        auto t = std::thread(&event_bus::async_listener_thread, cbl);
+        t.detach();
+    }
+
     return cbl->id;
 }
 
+unsigned long event_bus::register_listener(const std::string& channel, cb_func cb) {
+    return register_listener(std::list<std::string>{channel}, cb);
+}
+
 unsigned long event_bus::register_listener(const std::list<std::string>& channels, cb_func cb) {
-    local_locker l(&handler_mutex, "register listener (vector)");
+    return add_listener(std::make_shared<callback_listener>(channels, cb, 0));
+}
+
+unsigned long event_bus::register_async_listener(const std::string& name, 
+        const std::string& channel, cb_func cb, size_t max_queued, bool coalesce) {
+    return register_async_listener(name, std::list<std::string>{channel}, cb, max_queued, coalesce);
+}
+
+unsigned long event_bus::register_async_listener(const std::string& name, 
+        const std::list<std::string>& channels, cb_func cb, size_t max_queued, bool coalesce) {
+    auto cbl = std::make_shared<callback_listener>(channels, cb, 0);
+
+    cbl->async = true;
+    cbl->name = name;
+    cbl->max_queued = max_queued;
+    cbl->coalesce = coalesce;
 
-    auto cbl = std::make_shared<callback_listener>(channels, cb, next_cbl_id++);
+    return add_listener(cbl);
+}
+
+void event_bus::subscribe_listener(unsigned long id, const std::string& channel, bool coalesce) {
+    local_locker l(&handler_mutex, "subscribe listener");
+
+    auto cbl = callback_id_table.find(id);
+    if (cbl == callback_id_table.end())
+        return;
 
-    for (auto i : channels) {
-        callback_table[i].push_back(cbl);
+    auto& channels = cbl->second->channels;
+
+    if (std::find(channels.begin(), channels.end(), channel) == channels.end()) {
+        channels.push_back(channel);
+        callback_table[channel].push_back(cbl->second);
     }
 
-    callback_id_table[cbl->id] = cbl;
+    if (cbl->second->async) {
+        std::lock_guard<std::mutex> ql(cbl->second->queue_mutex);
 
-    return cbl->id;
+        if (coalesce)
+            cbl->second->coalesce_channels.insert(channel);
+        else
+            cbl->second->coalesce_channels.erase(channel);
+    }
+}
+
+void event_bus::unsubscribe_listener(unsigned long id, const std::string& channel) {
+    local_locker l(&handler_mutex, "unsubscribe listener");
+
+    auto cbl = callback_id_table.find(id);
+    if (cbl == callback_id_table.end())
+        return;
+
+    cbl->second->channels.remove(channel);
+
+    auto& cb_list = callback_table[channel];
+
+    for (auto cbi = cb_list.begin(); cbi != cb_list.end(); ++cbi) {
+        if ((*cbi)->id == id) {
+            cb_list.erase(cbi);
+            break;
+        }
+    }
+
+    if (cbl->second->async) {
+        std::lock_guard<std::mutex> ql(cbl->second->queue_mutex);
+        cbl->second->coalesce_channels.erase(channel);
+    }
 }
 
 void event_bus::remove_listener(unsigned long id) {
@@ -234,8 +498,8 @@ void event_bus::remove_listener(unsigned long id) {
         return;
 
     // Match all channels this cbl is subscribed to
-    for (auto c : cbl->second->channels) {
-        auto cb_list = callback_table[c];
+    for (const auto& c : cbl->second->channels) {
+        auto& cb_list = callback_table[c];
 
         // remove from each channel
         for (auto cbi = cb_list.begin(); cbi != cb_list.end(); ++cbi) {
@@ -246,7 +510,66 @@ void event_bus::remove_listener(unsigned long id) {
         }
     }
 
+    if (cbl->second->async) {
+        {
+            std::lock_guard<std::mutex> ql(cbl->second->queue_mutex);
+            cbl->second->stopping = true;
+        }
+
+        cbl->second->queue_cv.notify_all();
+    }
+
     // Remove from CBL ID table
     callback_id_table.erase(cbl);
 }
 
+std::shared_ptr<tracker_element> event_bus::listener_stats_endp() {
+    local_locker l(&handler_mutex, "listener stats");
+
+    auto ret = std::make_shared<tracker_element_vector>();
+    auto now = std::chrono::steady_clock::now();
+
+    for (const auto& i : callback_id_table) {
+        auto cbl = i.second;
+        auto lmap = std::make_shared<tracker_element_map>(listener_id);
+
+        lmap->insert(std::make_shared<tracker_element_uint64>(listener_id_id, cbl->id));
+
+        auto chvec = std::make_shared<tracker_element_vector>(listener_channels_id);
+        for (const auto& c : cbl->channels)
+            chvec->push_back(std::make_shared<tracker_element_string>(c));
+        lmap->insert(chvec);
+
+        lmap->insert(std::make_shared<tracker_element_uint8>(listener_async_id, cbl->async));
+
+        if (cbl->async) {
+            uint64_t queued, lag = 0;
+
+            {
+                std::lock_guard<std::mutex> ql(cbl->queue_mutex);
+                queued = cbl->queue.size();
+
+                if (queued > 0)
+                    lag = std::chrono::duration_cast<std::chrono::milliseconds>(now - 
+                            cbl->queue.front().second).count();
+            }
+
+            lmap->insert(std::make_shared<tracker_element_string>(listener_name_id, cbl->name));
+            lmap->insert(std::make_shared<tracker_element_uint64>(listener_queued_id, queued));
+            lmap->insert(std::make_shared<tracker_element_uint64>(listener_queue_max_id, 
+                        cbl->max_queued));
+            lmap->insert(std::make_shared<tracker_element_uint64>(listener_delivered_id, 
+                        (uint64_t) cbl->delivered));
+            lmap->insert(std::make_shared<tracker_element_uint64>(listener_dropped_id, 
+                        (uint64_t) cbl->dropped));
+            lmap->insert(std::make_shared<tracker_element_uint64>(listener_coalesced_id, 
+                        (uint64_t) cbl->coalesced));
+            lmap->insert(std::make_shared<tracker_element_uint64>(listener_lag_id, lag));
+        }
+
+        ret->push_back(lmap);
+    }
+
+    return ret;
+}
+
@@ -34,6 +34,14 @@
  *   DEVICETRACKER_NEW_DEVICE
  *   PHYTRACKER_NEW_PHY
  *   ALERTRACKER_NEW_ALERT
+ *
+ * Listeners are normally called directly by the dispatch thread, and must be
+ * quick.  Listeners which may block (such as remote clients) should be registered
+ * as async listeners; events for them are placed in a bounded queue and delivered
+ * by a thread of their own, so that they can fall behind without delaying any 
+ * other listener.  When the queue is full the oldest event is dropped.  Channels can
+ * be added to and removed from a listener as it runs, so a client with many 
+ * subscriptions still has a single queue and a single thread delivering them.
  */
 
 #ifndef __EVENTBUS_H__
@@ -41,13 +49,19 @@
 
 #include "config.h"
 
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
 #include <functional>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <queue>
 #include <string>
 #include <thread>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "globalregistry.h"
@@ -83,10 +97,19 @@ public:
     __Proxy(event_id, std::string, std::string, std::string, event_id);
     __ProxyTrackable(event_content, tracker_element_string_map, event_content);
 
+    // JSON of the event content, summarized by the 'fields' of a subscription; the 
+    // result is cached by summary_sig so that subscribers with the same fields share
+    // a single serialization of each event.  Content must not change once published.
+    std::shared_ptr<std::string> get_serialized_content(const std::string& summary_sig,
+            const Json::Value& summary);
+
 protected:
     std::shared_ptr<tracker_element_string> event_id;
     std::shared_ptr<tracker_element_string_map> event_content;
 
+    kis_recursive_timed_mutex serialize_mutex;
+    std::unordered_map<std::string, std::shared_ptr<std::string>> serialized_cache;
+
     virtual void register_fields() override {
         tracker_component::register_fields();
         register_field("kismet.eventbus.type", "Event type", &event_id);
@@ -118,6 +141,23 @@ public:
 
     unsigned long register_listener(const std::string& channel, cb_func cb);
     unsigned long register_listener(const std::list<std::string>& channels, cb_func cb);
+
+    // Register a listener which is called from its own thread, with up to max_queued
+    // events waiting for it.  Coalescing listeners only care about the latest event of
+    // each type, and a new event replaces any undelivered event of the same type.
+    unsigned long register_async_listener(const std::string& name, const std::string& channel, 
+            cb_func cb, size_t max_queued, bool coalesce);
+    unsigned long register_async_listener(const std::string& name, 
+            const std::list<std::string>& channels, cb_func cb, size_t max_queued, bool coalesce);
+
+    // Add a channel to, or remove one from, an existing listener.  Undelivered events
+    // of a coalesced channel are replaced by newer events of the same type, as if the
+    // listener had been registered with coalescing.
+    void subscribe_listener(unsigned long id, const std::string& channel, bool coalesce);
+    void unsubscribe_listener(unsigned long id, const std::string& channel);
+
+    // Remove a listener; an async listener may still be completing a callback for an 
+    // event dispatched before it was removed
     void remove_listener(unsigned long id);
 
     std::shared_ptr<eventbus_event> get_eventbus_event(const std::string& type);
@@ -147,13 +187,50 @@ protected:
         callback_listener(const std::list<std::string>& channels, cb_func cb, unsigned long id) :
             cb{cb},
             channels{channels},
-            id{id} { }
+            id{id},
+            async{false},
+            max_queued{0},
+            coalesce{false},
+            stopping{false},
+            delivered{0},
+            dropped{0},
+            coalesced{0} { }
 
         cb_func cb;
         std::list<std::string> channels;
         unsigned long id;
+
+        // Async listeners, delivered by their own thread
+        bool async;
+        std::string name;
+        size_t max_queued;
+        bool coalesce;
+        // Channels added with coalescing; protected by queue_mutex
+        std::unordered_set<std::string> coalesce_channels;
+
+        using queued_event = 
+            std::pair<std::shared_ptr<eventbus_event>, std::chrono::steady_clock::time_point>;
+
+        std::mutex queue_mutex;
+        std::condition_variable queue_cv;
+        std::deque<queued_event> queue;
+        bool stopping;
+
+        std::atomic<uint64_t> delivered, dropped, coalesced;
     };
 
+    unsigned long add_listener(std::shared_ptr<callback_listener> cbl);
+
+    // Queue an event for an async listener without blocking
+    void queue_async(std::shared_ptr<callback_listener> cbl, std::shared_ptr<eventbus_event> evt);
+    static void async_listener_thread(std::shared_ptr<callback_listener> cbl);
+
+    int listener_id, listener_id_id, listener_name_id, listener_channels_id, 
+        listener_async_id, listener_queued_id, listener_queue_max_id, 
+        listener_delivered_id, listener_dropped_id, listener_coalesced_id, 
+        listener_lag_id;
+    std::shared_ptr<tracker_element> listener_stats_endp();
+
     // Map of event IDs to listener objects
     std::unordered_map<std::string, std::vector<std::shared_ptr<callback_listener>>> callback_table;
     std::unordered_map<unsigned long, std::shared_ptr<callback_listener>> callback_id_table;
@@ -45,7 +45,7 @@ typedef std::shared_ptr<kis_gps> shared_gps;
 #define GPS_PACKINFO_MERGE_HEADING  (1 << 4)
 #define GPS_PACKINFO_MERGE_REST     (1 << 128)
 
-class kis_gps_packinfo : public packet_component {
+class kis_gps_packinfo : public packet_component, public kis_pooled_alloc<kis_gps_packinfo> {
 public:
     kis_gps_packinfo() {
         self_destruct = 1;
@@ -162,10 +162,117 @@ std::string json_adapter::sanitize_string(const std::string& s) noexcept {
     return result;
 }
 
+json_adapter::pack_buf::int_type json_adapter::pack_buf::overflow(int_type ch) {
+    auto used = pptr() - pbase();
+
+    if (buffer.size() < max_sz) {
+        // Grow the block until we reach the flush size, so that small objects
+        // don't pay for a full block
+        buffer.resize(std::min(buffer.size() * 2, max_sz));
+        setp(buffer.data(), buffer.data() + buffer.size());
+        pbump(used);
+    } else if (flush_buffer() < 0) {
+        return traits_type::eof();
+    }
+
+    if (!traits_type::eq_int_type(ch, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+
+    return traits_type::not_eof(ch);
+}
+
+int json_adapter::pack_buf::flush_buffer() {
+    auto used = pptr() - pbase();
+
+    if (used > 0) {
+        dest.write(pbase(), used);
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+
+    return dest.good() ? 0 : -1;
+}
+
+json_adapter::packer::packer(std::ostream& stream, 
+        std::shared_ptr<tracker_element_serializer::rename_map> name_map,
+        bool prettyprint, std::function<std::string (const std::string&)> name_permuter) :
+    buf{stream},
+    out{&buf},
+    name_map{name_map},
+    prettyprint{prettyprint},
+    name_permuter{name_permuter} {
+
+    // Inherit any formatting state the caller set on the destination
+    out.copyfmt(stream);
+}
+
+json_adapter::packer::~packer() {
+    flush();
+}
+
+void json_adapter::packer::flush() {
+    out.flush();
+}
+
+std::string json_adapter::packer::field_name(int id, const shared_tracker_element& e) {
+    std::string tname;
+
+    if (name_map != nullptr) {
+        auto nmi = name_map->find(e);
+        if (nmi != name_map->end() && nmi->second->rename.length() != 0)
+            tname = nmi->second->rename;
+    }
+
+    if (tname.length() == 0 && e != nullptr)
+        tname = e->get_local_name();
+
+    if (tname.length() == 0)
+        tname = Globalreg::globalreg->entrytracker->get_field_name(id);
+
+    if (name_permuter != nullptr)
+        tname = name_permuter(tname);
+
+    return sanitize_string(tname);
+}
+
+const std::string& json_adapter::packer::field_key(int id, const shared_tracker_element& e) {
+    // Renamed fields are cached by the rename; summaries are copied per record, but
+    // the rename strings repeat for every record in the set
+    if (name_map != nullptr) {
+        auto nmi = name_map->find(e);
+        if (nmi != name_map->end() && nmi->second->rename.length() != 0) {
+            auto rki = rename_key_cache.find(nmi->second->rename);
+            if (rki != rename_key_cache.end())
+                return rki->second;
+
+            return rename_key_cache.emplace(nmi->second->rename, 
+                    fmt::format("\"{}\": ", field_name(id, e))).first->second;
+        }
+    }
+
+    // Dynamic entities carry their own name and share ids with nothing, don't cache them
+    if (e != nullptr && e->has_local_name()) {
+        uncached_key = fmt::format("\"{}\": ", field_name(id, e));
+        return uncached_key;
+    }
+
+    auto ki = key_cache.find(id);
+    if (ki != key_cache.end())
+        return ki->second;
+
+    return key_cache.emplace(id, fmt::format("\"{}\": ", field_name(id, e))).first->second;
+}
+
 void json_adapter::pack(std::ostream &stream, shared_tracker_element e, 
         std::shared_ptr<tracker_element_serializer::rename_map> name_map,
         bool prettyprint, unsigned int depth,
         std::function<std::string (const std::string&)> name_permuter) {
+    packer p(stream, name_map, prettyprint, name_permuter);
+    p.pack(e, depth);
+}
+
+void json_adapter::packer::pack(shared_tracker_element e, unsigned int depth) {
 
     std::string indent;
     std::string ppendl;
@@ -199,13 +306,13 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
 
     if (e->is_stringable()) {
         if (e->needs_quotes())
-            stream << "\"" << sanitize_string(e->as_string()) << "\"";
+            out << "\"" << sanitize_string(e->as_string()) << "\"";
         else
-            stream << sanitize_string(e->as_string());
+            out << sanitize_string(e->as_string());
     } else {
         switch (e->get_type()) {
             case tracker_type::tracker_vector:
-                stream << ppendl << indent << "[" << ppendl;
+                out << ppendl << indent << "[" << ppendl;
 
                 prepend_comma = false;
 
@@ -214,64 +321,64 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                         continue;
 
                     if (prepend_comma)
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
                     prepend_comma = true;
 
                     if (prettyprint)
-                        stream << indent;
+                        out << indent;
 
-                    json_adapter::pack(stream, i, name_map, prettyprint, depth + 1, name_permuter);
+                    pack(i, depth + 1);
                 }
-                stream << ppendl << indent << "]";
+                out << ppendl << indent << "]";
                 break;
             case tracker_type::tracker_vector_double:
-                stream << ppendl << indent << "[" << ppendl;
+                out << ppendl << indent << "[" << ppendl;
 
                 prepend_comma = false;
 
                 for (auto i : *(std::static_pointer_cast<tracker_element_vector_double>(e))) {
                     if (prepend_comma)
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
                     prepend_comma = true;
 
                     if (prettyprint)
-                        stream << indent;
+                        out << indent;
 
                     if (std::isnan(i) || std::isinf(i))
-                        stream << "0";
+                        out << "0";
 
                     if (floor(i) == i)
-                        stream << fmt::format("{}", (long long) i);
+                        out << fmt::format("{}", (long long) i);
                     else
-                        stream << fmt::format("{:f}", i);
+                        out << fmt::format("{:f}", i);
                 }
-                stream << ppendl << indent << "]";
+                out << ppendl << indent << "]";
                 break;
             case tracker_type::tracker_vector_string:
-                stream << ppendl << indent << "[" << ppendl;
+                out << ppendl << indent << "[" << ppendl;
 
                 prepend_comma = false;
 
                 for (auto i : *(std::static_pointer_cast<tracker_element_vector_string>(e))) {
                     if (prepend_comma)
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
                     prepend_comma = true;
 
                     if (prettyprint)
-                        stream << indent;
+                        out << indent;
 
-                    stream << i;
+                    out << i;
                 }
-                stream << ppendl << indent << "]";
+                out << ppendl << indent << "]";
                 break;
             case tracker_type::tracker_map:
                 as_vector = std::static_pointer_cast<tracker_element_map>(e)->as_vector();
                 as_key_vector = std::static_pointer_cast<tracker_element_map>(e)->as_key_vector();
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
+                    out << ppendl << indent << "[" << ppendl;
                 else
-                    stream << ppendl << indent << "{" << ppendl;
+                    out << ppendl << indent << "{" << ppendl;
 
                 prepend_comma = false;
                 for (auto i : *(std::static_pointer_cast<tracker_element_map>(e))) {
@@ -279,58 +386,39 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                         continue;
 
                     if (prepend_comma) {
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
 
                         if (prettyprint)
-                            stream << ppendl;
+                            out << ppendl;
                     }
 
                     prepend_comma = true;
 
                     if (!as_vector) {
-                        bool named = false;
-
-                        if (name_map != NULL) {
-                            tracker_element_serializer::rename_map::iterator nmi = name_map->find(i.second);
-                            if (nmi != name_map->end() && nmi->second->rename.length() != 0) {
-                                tname = nmi->second->rename;
-                                named = true;
-                            }
-                        }
-
-                        if (!named) {
-                            if (i.second == NULL) {
-                                tname = Globalreg::globalreg->entrytracker->get_field_name(i.first);
-                            } else {
-                                if ((tname = i.second->get_local_name()) == "")
-                                    tname = Globalreg::globalreg->entrytracker->get_field_name(i.first);
-                            }
-                        }
+                        if (prettyprint) {
+                            tname = field_name(i.first, i.second);
 
-                        tname = json_adapter::sanitize_string(name_permuter(tname));
+                            out << indent << "\"description." << tname << "\": ";
+                            out << "\"";
+                            out << sanitize_string(i.second->get_type_as_string());
+                            out << ", ";
+                            out << sanitize_string(Globalreg::globalreg->entrytracker->get_field_description(i.first));
+                            out << "\"," << ppendl;
 
-                        if (prettyprint) {
-                            stream << indent << "\"description." << tname << "\": ";
-                            stream << "\"";
-                            if (i.second != nullptr) {
-                                stream << sanitize_string(i.second->get_type_as_string());
-                                stream << ", ";
-                            }
-                            stream << sanitize_string(Globalreg::globalreg->entrytracker->get_field_description(i.first));
-                            stream << "\"," << ppendl;
+                            out << indent << "\"" << tname << "\": ";
+                        } else {
+                            out << field_key(i.first, i.second);
                         }
-
-                        stream << indent << "\"" << tname << "\": ";
                     }
 
-                    json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
+                    pack(i.second, depth + 1);
 
                 }
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
+                    out << ppendl << indent << "]";
                 else
-                    stream << ppendl << indent << "}";
+                    out << ppendl << indent << "}";
 
                 break;
             case tracker_type::tracker_int_map:
@@ -338,9 +426,9 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                 as_key_vector = std::static_pointer_cast<tracker_element_int_map>(e)->as_key_vector();
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
+                    out << ppendl << indent << "[" << ppendl;
                 else
-                    stream << ppendl << indent << "{" << ppendl;
+                    out << ppendl << indent << "{" << ppendl;
 
                 prepend_comma = false;
                 for (auto i : *(std::static_pointer_cast<tracker_element_int_map>(e))) {
@@ -348,26 +436,26 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                         continue;
 
                     if (prepend_comma)
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
                     prepend_comma = true;
 
                     if (!as_vector) {
                         // Integer dictionary keys in json are still quoted as strings
-                        stream << indent << "\"" << i.first << "\"";
+                        out << indent << "\"" << i.first << "\"";
 
                         if (!as_key_vector)
-                            stream << ": ";
+                            out << ": ";
                     }
 
                     if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
+                        pack(i.second, depth + 1);
                     }
                 }
 
                 if (as_vector || as_key_vector)
-                    stream << indent << "]" << ppendl;
+                    out << indent << "]" << ppendl;
                 else
-                    stream << indent << "}" << ppendl;
+                    out << indent << "}" << ppendl;
 
                 break;
             case tracker_type::tracker_mac_map:
@@ -375,9 +463,9 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                 as_key_vector = std::static_pointer_cast<tracker_element_mac_map>(e)->as_key_vector();
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
+                    out << ppendl << indent << "[" << ppendl;
                 else
-                    stream << ppendl << indent << "{" << ppendl;
+                    out << ppendl << indent << "{" << ppendl;
 
                 prepend_comma = false;
                 for (auto i : *(std::static_pointer_cast<tracker_element_mac_map>(e))) {
@@ -385,26 +473,26 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                         continue;
 
                     if (prepend_comma)
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
                     prepend_comma = true;
 
                     if (!as_vector) {
                         // Mac keys are strings and we push only the mac not the mask */
-                        stream << indent << "\"" << i.first << "\"";
+                        out << indent << "\"" << i.first << "\"";
 
                         if (!as_key_vector)
-                            stream << ": ";
+                            out << ": ";
                     }
 
                     if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
+                        pack(i.second, depth + 1);
                     }
                 }
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
+                    out << ppendl << indent << "]";
                 else
-                    stream << ppendl << indent << "}";
+                    out << ppendl << indent << "}";
 
                 break;
             case tracker_type::tracker_string_map:
@@ -412,9 +500,9 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                 as_key_vector = std::static_pointer_cast<tracker_element_string_map>(e)->as_key_vector();
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
+                    out << ppendl << indent << "[" << ppendl;
                 else
-                    stream << ppendl << indent << "{" << ppendl;
+                    out << ppendl << indent << "{" << ppendl;
 
                 prepend_comma = false;
                 for (auto i : *(std::static_pointer_cast<tracker_element_string_map>(e))) {
@@ -422,25 +510,25 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                         continue;
 
                     if (prepend_comma)
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
                     prepend_comma = true;
 
                     if (!as_vector) {
-                        stream << indent << "\"" << json_adapter::sanitize_string(i.first) << "\"";
+                        out << indent << "\"" << json_adapter::sanitize_string(i.first) << "\"";
 
                         if (!as_key_vector)
-                            stream << ": ";
+                            out << ": ";
                     }
 
                     if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
+                        pack(i.second, depth + 1);
                     }
                 }
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
+                    out << ppendl << indent << "]";
                 else
-                    stream << ppendl << indent << "}";
+                    out << ppendl << indent << "}";
 
                 break;
             case tracker_type::tracker_double_map:
@@ -448,9 +536,9 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                 as_key_vector = std::static_pointer_cast<tracker_element_double_map>(e)->as_key_vector();
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
+                    out << ppendl << indent << "[" << ppendl;
                 else
-                    stream << ppendl << indent << "{" << ppendl;
+                    out << ppendl << indent << "{" << ppendl;
 
                 prepend_comma = false;
                 for (auto i : *(std::static_pointer_cast<tracker_element_double_map>(e))) {
@@ -458,34 +546,34 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                         continue;
 
                     if (prepend_comma)
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
                     prepend_comma = true;
 
                     if (!as_vector) {
                         // Double keys are handled as strings in json
                         if (std::isnan(i.first) || std::isinf(i.first)) {
-                            stream << indent << "\"0\"";
+                            out << indent << "\"0\"";
                         } else if (floor(i.first) == i.first)  {
-                            auto prec = stream.precision(0);
-                            stream << indent << "\"" << std::fixed << i.first << "\"";
-                            stream.precision(prec);
+                            auto prec = out.precision(0);
+                            out << indent << "\"" << std::fixed << i.first << "\"";
+                            out.precision(prec);
                         } else {
-                            stream << indent << "\"" << std::fixed << i.first << "\"";
+                            out << indent << "\"" << std::fixed << i.first << "\"";
                         }
 
                         if (!as_key_vector)
-                            stream << ": ";
+                            out << ": ";
                     }
 
                     if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
+                        pack(i.second, depth + 1);
                     }
                 }
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
+                    out << ppendl << indent << "]";
                 else
-                    stream << indent << "}";
+                    out << indent << "}";
 
                 break;
             case tracker_type::tracker_hashkey_map:
@@ -493,9 +581,9 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                 as_key_vector = std::static_pointer_cast<tracker_element_hashkey_map>(e)->as_key_vector();
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
+                    out << ppendl << indent << "[" << ppendl;
                 else
-                    stream << ppendl << indent << "{" << ppendl;
+                    out << ppendl << indent << "{" << ppendl;
 
                 prepend_comma = false;
                 for (auto i : *(std::static_pointer_cast<tracker_element_hashkey_map>(e))) {
@@ -503,32 +591,32 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                         continue;
 
                     if (prepend_comma)
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
                     prepend_comma = true;
 
                     if (!as_vector) {
                         // Double keys are handled as strings in json
                         if (std::isnan(i.first) || std::isinf(i.first)) {
-                            stream << indent << "\"0\"";
+                            out << indent << "\"0\"";
                         } else if (floor(i.first) == i.first)  {
-                            stream << indent << "\"" << (long) i.first << "\"";
+                            out << indent << "\"" << (long) i.first << "\"";
                         } else {
-                            stream << indent << "\"" << std::fixed << i.first << "\"";
+                            out << indent << "\"" << std::fixed << i.first << "\"";
                         }
 
                         if (!as_key_vector)
-                            stream << ": ";
+                            out << ": ";
                     }
 
                     if (!as_key_vector) {
-                        json_adapter::pack(stream, i.second, name_map, prettyprint, depth + 1, name_permuter);
+                        pack(i.second, depth + 1);
                     }
                 }
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
+                    out << ppendl << indent << "]";
                 else
-                    stream << ppendl << indent << "}";
+                    out << ppendl << indent << "}";
 
                 break;
             case tracker_type::tracker_double_map_double:
@@ -536,46 +624,46 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                 as_key_vector = std::static_pointer_cast<tracker_element_double_map_double>(e)->as_key_vector();
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
+                    out << ppendl << indent << "[" << ppendl;
                 else
-                    stream << ppendl << indent << "{" << ppendl;
+                    out << ppendl << indent << "{" << ppendl;
 
                 prepend_comma = false;
                 for (auto i : *(std::static_pointer_cast<tracker_element_double_map_double>(e))) {
                     if (prepend_comma)
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
 
                     prepend_comma = true;
 
                     if (!as_vector) {
                         // Double keys are handled as strings in json
                         if (std::isnan(i.first) || std::isinf(i.first)) {
-                            stream << indent << "\"0\"";
+                            out << indent << "\"0\"";
                         } else if (floor(i.first) == i.first)  {
-                            stream << indent << "\"" << (long) i.first << "\"";
+                            out << indent << "\"" << (long) i.first << "\"";
                         } else {
-                            stream << indent << "\"" << std::fixed << i.first << "\"";
+                            out << indent << "\"" << std::fixed << i.first << "\"";
                         }
 
                         if (!as_key_vector)
-                            stream << ": ";
+                            out << ": ";
                     }
 
                     if (!as_key_vector) {
                         if (std::isnan(i.second) || std::isinf(i.second))
-                            stream << "0";
+                            out << "0";
 
                         if (floor(i.second) == i.second)
-                            stream << fmt::format("{}", (long long) i.second);
+                            out << fmt::format("{}", (long long) i.second);
                         else
-                            stream << fmt::format("{:f}", i.second);
+                            out << fmt::format("{:f}", i.second);
                     }
                 }
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
+                    out << ppendl << indent << "]";
                 else
-                    stream << ppendl << indent << "}";
+                    out << ppendl << indent << "}";
 
                 break;
             case tracker_type::tracker_key_map:
@@ -583,9 +671,9 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                 as_key_vector = std::static_pointer_cast<tracker_element_device_key_map>(e)->as_key_vector();
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "[" << ppendl;
+                    out << ppendl << indent << "[" << ppendl;
                 else
-                    stream << ppendl << indent << "{" << ppendl;
+                    out << ppendl << indent << "{" << ppendl;
 
                 prepend_comma = false;
                 for (auto i : *(std::static_pointer_cast<tracker_element_device_key_map>(e))) {
@@ -593,26 +681,26 @@ void json_adapter::pack(std::ostream &stream, shared_tracker_element e,
                         continue;
 
                     if (prepend_comma)
-                        stream << "," << ppendl;
+                        out << "," << ppendl;
                     prepend_comma = true;
 
                     if (!as_vector) {
                         // Keymap keys are handled as strings
-                        stream << indent << "\"" << i.first << "\"";
+                        out << indent << "\"" << i.first << "\"";
 
                         if (!as_key_vector)
-                            stream << ": ";
+                            out << ": ";
                     }
 
                     if (!as_key_vector) {
-                        json_adapter::pack(stream,i.second, name_map, prettyprint, depth + 1, name_permuter);
+                        pack(i.second, depth + 1);
                     }
                 }
 
                 if (as_vector || as_key_vector)
-                    stream << ppendl << indent << "]";
+                    out << ppendl << indent << "]";
                 else
-                    stream << ppendl << indent << "}";
+                    out << ppendl << indent << "}";
 
                 break;
             default:
@@ -24,19 +24,91 @@
 #include "globalregistry.h"
 #include "trackedelement.h"
 #include "devicetracker_component.h"
+#include "robin_hood.h"
 
 // Standard JSON serialization adapter; will form complete JSON objects out
 // of the input objects.  Best connected to a chainbuf output stream via a
 // buffer_handler_ostream_buf or similar
 namespace json_adapter {
 
+// Output buffer for a serialization run; output is collected in a contiguous block
+// and handed to the destination stream in large writes instead of each token going
+// to the destination individually (which, for a http response, is a lock and a
+// possible wakeup of the writer per token).  The block starts small and grows to 
+// max_sz before it is flushed.
+class pack_buf : public std::streambuf {
+public:
+    pack_buf(std::ostream& dest, size_t initial_sz = 4096, size_t max_sz = 65536) :
+        dest{dest},
+        max_sz{max_sz},
+        buffer(initial_sz) {
+        setp(buffer.data(), buffer.data() + buffer.size());
+    }
+
+    virtual ~pack_buf() {
+        flush_buffer();
+    }
+
+protected:
+    virtual int_type overflow(int_type ch) override;
+
+    virtual int sync() override {
+        return flush_buffer();
+    }
+
+    int flush_buffer();
+
+    std::ostream& dest;
+    size_t max_sz;
+    std::vector<char> buffer;
+};
+
+// Serialization context for one or more objects written to the same stream.  The
+// quoted JSON keys are cached per field id (and per rename) for the life of the 
+// packer, so a large set of records of the same type only resolves and escapes each
+// field name once.
+class packer {
+public:
+    packer(std::ostream& stream, 
+            std::shared_ptr<tracker_element_serializer::rename_map> name_map = nullptr,
+            bool prettyprint = false,
+            std::function<std::string (const std::string&)> name_permuter = nullptr);
+    ~packer();
+
+    void pack(shared_tracker_element e, unsigned int depth = 0);
+
+    // Buffered output, for writing separators between top-level objects
+    std::ostream& stream() {
+        return out;
+    }
+
+    void flush();
+
+protected:
+    // Escaped (but unquoted) name of a field, for pretty output
+    std::string field_name(int id, const shared_tracker_element& e);
+
+    // Complete '"name": ' key of a field
+    const std::string& field_key(int id, const shared_tracker_element& e);
+
+    pack_buf buf;
+    std::ostream out;
+
+    std::shared_ptr<tracker_element_serializer::rename_map> name_map;
+    bool prettyprint;
+    std::function<std::string (const std::string&)> name_permuter;
+
+    robin_hood::unordered_node_map<int, std::string> key_cache;
+    robin_hood::unordered_node_map<std::string, std::string> rename_key_cache;
+    std::string uncached_key;
+};
+
 // Basic packer with some defaulted options - prettyprint and depth used for
 // recursive indenting and prettifying the output
 void pack(std::ostream &stream, shared_tracker_element e,
         std::shared_ptr<tracker_element_serializer::rename_map> name_map = nullptr,
         bool prettyprint = false, unsigned int depth = 0,
-        std::function<std::string (const std::string&)> name_permuter = 
-            [](const std::string& s) -> std::string { return s; });
+        std::function<std::string (const std::string&)> name_permuter = nullptr);
 
 std::string sanitize_string(const std::string& in) noexcept;
 std::size_t sanitize_extra_space(const std::string& in) noexcept;
@@ -75,15 +147,17 @@ public:
         local_locker lock(&mutex);
 
         if (in_elem->get_type() == tracker_type::tracker_vector) {
+            json_adapter::packer packer(stream, name_map, false,
+                    [](const std::string& s) { 
+                        return multi_replace_all(s, ".", "_");
+                    });
+
             for (auto i : *(std::static_pointer_cast<tracker_element_vector>(in_elem))) {
                 if (i == nullptr)
                     continue;
 
-                json_adapter::pack(stream, i, name_map, false, 0,
-                        [](const std::string& s) { 
-                            return multi_replace_all(s, ".", "_");
-                        });
-                stream << "\n";
+                packer.pack(i);
+                packer.stream() << "\n";
             }
         } else {
             // No longer accept invalid data for ekjson, it MUST be a vector as the top-level object
@@ -111,9 +185,11 @@ public:
         local_locker lock(&mutex);
 
         if (in_elem->get_type() == tracker_type::tracker_vector) {
+            json_adapter::packer packer(stream, name_map);
+
             for (auto i : *(std::static_pointer_cast<tracker_element_vector>(in_elem))) {
-                json_adapter::pack(stream, i, name_map);
-                stream << "\n";
+                packer.pack(i);
+                packer.stream() << "\n";
             }
         } else {
             stream << "<h1>Invalid format for itjson</h1>itjson endpoints can only be used with array or list results\n";
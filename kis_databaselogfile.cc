@@ -73,12 +73,56 @@ kis_database_logfile::kis_database_logfile():
     snapshot_stmt = NULL;
     snapshot_pz = NULL;
 
+    dict_stmt = NULL;
+    dict_pz = NULL;
+
+    device_delta_stmt = NULL;
+    device_delta_pz = NULL;
+
+    delta_clear_stmt = NULL;
+    delta_clear_pz = NULL;
+
+    delta_field_stmt = NULL;
+    delta_field_pz = NULL;
+
+    device_deltas = false;
+    device_checkpoint_interval = 600;
+    last_delta_prune = 0;
+
+    compress_enabled = false;
+    compress_level = Z_DEFAULT_COMPRESSION;
+    next_dict_id = 1;
+
     devicetracker =
         Globalreg::fetch_mandatory_global_as<device_tracker>();
 
     db_enabled = false;
 
     message_evt_id = 0;
+
+    writer_running = false;
+    writer_queued = 0;
+    writer_rows_written = 0;
+    writer_rows_dropped = 0;
+    writer_commits = 0;
+    last_drop_user_warning = 0;
+
+    writer_queued_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.kismetdb.writer.queued",
+                tracker_element_factory<tracker_element_uint64>(),
+                "rows waiting to be written");
+    writer_written_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.kismetdb.writer.written",
+                tracker_element_factory<tracker_element_uint64>(),
+                "rows written");
+    writer_dropped_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.kismetdb.writer.dropped",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packet and data rows dropped because the writer fell behind");
+    writer_commits_id =
+        Globalreg::globalreg->entrytracker->register_field("kismet.kismetdb.writer.commits",
+                tracker_element_factory<tracker_element_uint64>(),
+                "transactions committed");
 }
 
 kis_database_logfile::~kis_database_logfile() {
@@ -246,6 +290,23 @@ bool kis_database_logfile::open_log(std::string in_path) {
 
     auto httpd = Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>();
 
+    httpd->register_route("/logging/kismetdb/writer", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) -> std::shared_ptr<tracker_element> {
+                    auto ret = std::make_shared<tracker_element_map>();
+
+                    ret->insert(std::make_shared<tracker_element_uint64>(writer_queued_id, 
+                                (uint64_t) writer_queued));
+                    ret->insert(std::make_shared<tracker_element_uint64>(writer_written_id, 
+                                (uint64_t) writer_rows_written));
+                    ret->insert(std::make_shared<tracker_element_uint64>(writer_dropped_id, 
+                                (uint64_t) writer_rows_dropped));
+                    ret->insert(std::make_shared<tracker_element_uint64>(writer_commits_id, 
+                                (uint64_t) writer_commits));
+
+                    return ret;
+                }));
+
     httpd->register_route("/logging/kismetdb/pcap/drop", {"POST"}, httpd->LOGON_ROLE, {"cmd"},
             std::make_shared<kis_net_web_function_endpoint>(
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
@@ -383,26 +444,57 @@ bool kis_database_logfile::open_log(std::string in_path) {
 
     db_enabled = true;
 
-    sqlite3_exec(db, "PRAGMA journal_mode=PERSIST", NULL, NULL, NULL);
+    if (Globalreg::globalreg->kismet_config->fetch_opt_bool("kis_log_wal", false)) {
+        // WAL lets the periodic commits append instead of rewriting the journal, and
+        // with synchronous=NORMAL only checkpoints sync; a power loss can lose the
+        // most recent commits but not corrupt the log
+        sqlite3_exec(db, "PRAGMA journal_mode=WAL", NULL, NULL, NULL);
+        sqlite3_exec(db, "PRAGMA synchronous=NORMAL", NULL, NULL, NULL);
+        sqlite3_exec(db, "PRAGMA wal_autocheckpoint=4096", NULL, NULL, NULL);
+        sqlite3_exec(db, "PRAGMA journal_size_limit=67108864", NULL, NULL, NULL);
+    } else {
+        sqlite3_exec(db, "PRAGMA journal_mode=PERSIST", NULL, NULL, NULL);
+    }
     
-    // Go into transactional mode where we only commit every 10 seconds
+    // Go into transactional mode; the writer commits groups of rows
     sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
 
-    transaction_timer = 
-        timetracker->register_timer(SERVER_TIMESLICES_SEC * 10, NULL, 1,
-            [this](int) -> int {
-
-            local_locker dblock(&ds_mutex);
-
-            in_transaction_sync = true;
+    writer_queue_limit =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("kis_log_queue_limit", 65536);
+    commit_rows =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("kis_log_commit_rows", 20000);
+    commit_interval_ms =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("kis_log_commit_interval", 10000);
+
+    if (Globalreg::globalreg->kismet_config->fetch_opt_bool("kis_log_compress", false)) {
+        compress_level = 
+            Globalreg::globalreg->kismet_config->fetch_opt_int("kis_log_compress_level", 
+                    Z_DEFAULT_COMPRESSION);
+
+        if (kismetdb_deflate_init(&compress_zs, compress_level) < 0) {
+            _MSG_ERROR("Unable to initialize compression for the kismetdb log; packets and "
+                    "devices will be logged uncompressed.");
+        } else {
+            _MSG_INFO("Compressing packets and devices in the kismetdb log.");
+            compress_enabled = true;
+            next_dict_id = 1;
+        }
+    }
 
-            sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
-            sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+    device_deltas =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("kis_log_device_deltas", false);
+    device_checkpoint_interval =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("kis_log_device_checkpoint", 600);
 
-            in_transaction_sync = false;
+    if (device_deltas)
+        _MSG_INFO("Logging changed device fields to the kismetdb log, with a full device "
+                "checkpoint every {} seconds.", device_checkpoint_interval);
 
-            return 1;
-        });
+    writer_running = true;
+    writer_thread = std::thread([this]() {
+            thread_set_process_name("kismetdb");
+            writer_thread_fn();
+            });
 
     // Post that we've got the logfile ready
     auto evt = eventbus->get_eventbus_event(event_log_open());
@@ -412,6 +504,9 @@ bool kis_database_logfile::open_log(std::string in_path) {
 }
 
 void kis_database_logfile::close_log() {
+    // Flush everything queued before closing; the writer needs the database lock
+    stop_writer();
+
     local_demand_locker dblock(&ds_mutex);
 
     db_lock_with_sync_check(dblock, return);
@@ -422,7 +517,6 @@ void kis_database_logfile::close_log() {
     auto timetracker = 
         Globalreg::fetch_global_as<time_tracker>();
     if (timetracker != NULL) {
-        timetracker->remove_timer(transaction_timer);
         timetracker->remove_timer(packet_timeout_timer);
         timetracker->remove_timer(alert_timeout_timer);
         timetracker->remove_timer(device_timeout_timer);
@@ -484,6 +578,43 @@ void kis_database_logfile::close_log() {
         snapshot_stmt = NULL;
     }
 
+    {
+        if (dict_stmt != NULL)
+            sqlite3_finalize(dict_stmt);
+        dict_stmt = NULL;
+    }
+
+    {
+        if (device_delta_stmt != NULL)
+            sqlite3_finalize(device_delta_stmt);
+        device_delta_stmt = NULL;
+    }
+
+    {
+        if (delta_clear_stmt != NULL)
+            sqlite3_finalize(delta_clear_stmt);
+        delta_clear_stmt = NULL;
+    }
+
+    {
+        if (delta_field_stmt != NULL)
+            sqlite3_finalize(delta_field_stmt);
+        delta_field_stmt = NULL;
+    }
+
+    {
+        local_locker dl(&device_delta_mutex);
+        device_delta_map.clear();
+        delta_fields_logged.clear();
+    }
+
+    if (compress_enabled) {
+        deflateEnd(&compress_zs);
+        compress_enabled = false;
+    }
+
+    compress_dicts.clear();
+
     sqlite3_exec(db, "PRAGMA journal_mode=DELETE", NULL, NULL, NULL);
     sqlite3_exec(db, "BEGIN_EXCLUSIVE", NULL, NULL, NULL);
     sqlite3_exec(db, "COMMIT", NULL, NULL, NULL);
@@ -528,6 +659,8 @@ int kis_database_logfile::database_upgrade_db() {
 
         "device BLOB, " // Actual device
 
+        "compression INT, " // Device blob compression
+
         "UNIQUE(phyname, devmac) ON CONFLICT REPLACE)";
 
     r = sqlite3_exec(db, sql.c_str(),
@@ -573,7 +706,9 @@ int kis_database_logfile::database_upgrade_db() {
 
         "error INT, " // Packet was flagged as invalid
 
-        "tags TEXT" // Arbitrary packet tags
+        "tags TEXT, " // Arbitrary packet tags
+
+        "compression INT" // Packet blob compression
         ")";
 
     r = sqlite3_exec(db, sql.c_str(),
@@ -718,7 +853,82 @@ int kis_database_logfile::database_upgrade_db() {
         return -1;
     }
 
-    database_set_db_version(6);
+    sql =
+        "CREATE TABLE compression_dicts ("
+
+        "id INT, " // Dictionary ID referenced by compressed blobs
+
+        "name TEXT, " // Record type the dictionary was built from
+
+        "dict BLOB, " // zlib preset dictionary
+
+        "UNIQUE(id) ON CONFLICT REPLACE)";
+
+    r = sqlite3_exec(db, sql.c_str(),
+            [] (void *, int, char **, char **) -> int { return 0; }, NULL, &sErrMsg);
+
+    if (r != SQLITE_OK) {
+        _MSG("Kismet log was unable to create compression dictionary table in " + ds_dbfile + ": " +
+                std::string(sErrMsg), MSGFLAG_ERROR);
+        close_log();
+        return -1;
+    }
+
+    sql =
+        "CREATE TABLE device_deltas ("
+
+        "ts_sec INT, " // Time logged
+
+        "devkey TEXT, " // Device key
+
+        "phyname TEXT, " // Phy records
+        "devmac TEXT, "
+
+        "delta BLOB " // Changed fields since the last record of the device
+        ")";
+
+    r = sqlite3_exec(db, sql.c_str(),
+            [] (void *, int, char **, char **) -> int { return 0; }, NULL, &sErrMsg);
+
+    if (r != SQLITE_OK) {
+        _MSG("Kismet log was unable to create device delta table in " + ds_dbfile + ": " +
+                std::string(sErrMsg), MSGFLAG_ERROR);
+        close_log();
+        return -1;
+    }
+
+    sql = "CREATE INDEX device_deltas_devkey ON device_deltas (devkey)";
+
+    r = sqlite3_exec(db, sql.c_str(),
+            [] (void *, int, char **, char **) -> int { return 0; }, NULL, &sErrMsg);
+
+    if (r != SQLITE_OK) {
+        _MSG("Kismet log was unable to create device delta index in " + ds_dbfile + ": " +
+                std::string(sErrMsg), MSGFLAG_ERROR);
+        close_log();
+        return -1;
+    }
+
+    sql =
+        "CREATE TABLE delta_fields ("
+
+        "id INT, " // Field ID used in device deltas
+
+        "name TEXT, " // Field name
+
+        "UNIQUE(id) ON CONFLICT REPLACE)";
+
+    r = sqlite3_exec(db, sql.c_str(),
+            [] (void *, int, char **, char **) -> int { return 0; }, NULL, &sErrMsg);
+
+    if (r != SQLITE_OK) {
+        _MSG("Kismet log was unable to create delta field table in " + ds_dbfile + ": " +
+                std::string(sErrMsg), MSGFLAG_ERROR);
+        close_log();
+        return -1;
+    }
+
+    database_set_db_version(8);
 
     // Prepare the statements we'll need later
     //
@@ -727,8 +937,8 @@ int kis_database_logfile::database_upgrade_db() {
         "(first_time, last_time, devkey, phyname, devmac, strongest_signal, "
         "min_lat, min_lon, max_lat, max_lon, "
         "avg_lat, avg_lon, "
-        "bytes_data, type, device) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+        "bytes_data, type, device, compression) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
 
     r = sqlite3_prepare(db, sql.c_str(), sql.length(), &device_stmt, &device_pz);
 
@@ -747,8 +957,8 @@ int kis_database_logfile::database_upgrade_db() {
         "packet_len, signal, "
         "datasource, "
         "dlt, packet, "
-        "error, tags) "
-        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+        "error, tags, compression) "
+        "VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
 
     r = sqlite3_prepare(db, sql.c_str(), sql.length(), &packet_stmt, &packet_pz);
 
@@ -843,35 +1053,320 @@ int kis_database_logfile::database_upgrade_db() {
         return -1;
     }
 
+    sql =
+        "INSERT INTO compression_dicts "
+        "(id, name, dict) "
+        "VALUES (?, ?, ?)";
+
+    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &dict_stmt, &dict_pz);
+
+    if (r != SQLITE_OK) {
+        _MSG("kis_database_logfile unable to prepare database insert for compression dictionaries in " +
+                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
+        close_log();
+        return -1;
+    }
+
+    sql =
+        "INSERT INTO device_deltas "
+        "(ts_sec, devkey, phyname, devmac, delta) "
+        "VALUES (?, ?, ?, ?, ?)";
+
+    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &device_delta_stmt, &device_delta_pz);
+
+    if (r != SQLITE_OK) {
+        _MSG("kis_database_logfile unable to prepare database insert for device deltas in " +
+                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
+        close_log();
+        return -1;
+    }
+
+    sql = "DELETE FROM device_deltas WHERE devkey = ?";
+
+    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &delta_clear_stmt, &delta_clear_pz);
+
+    if (r != SQLITE_OK) {
+        _MSG("kis_database_logfile unable to prepare database delete for device deltas in " +
+                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
+        close_log();
+        return -1;
+    }
+
+    sql =
+        "INSERT INTO delta_fields "
+        "(id, name) "
+        "VALUES (?, ?)";
+
+    r = sqlite3_prepare(db, sql.c_str(), sql.length(), &delta_field_stmt, &delta_field_pz);
+
+    if (r != SQLITE_OK) {
+        _MSG("kis_database_logfile unable to prepare database insert for delta fields in " +
+                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
+        close_log();
+        return -1;
+    }
+
     return 1;
 }
 
-void kis_database_logfile::handle_message(std::shared_ptr<tracked_message> msg) {
-    if (!db_enabled)
+void kis_database_logfile::queue_row(db_row *row) {
+    if (!writer_running) {
+        delete row;
+        return;
+    }
+
+    if (writer_queue_limit != 0 && writer_queued >= writer_queue_limit && row->droppable) {
+        writer_rows_dropped++;
+        delete row;
+
+        time_t offt = time(0) - last_drop_user_warning;
+
+        if (offt > 30) {
+            last_drop_user_warning = time(0);
+            _MSG_ERROR("The kismetdb log can not keep up with the incoming data and "
+                    "is dropping packets ({} total so far).  This usually means the "
+                    "disk being logged to is too slow; consider kis_log_wal=true, "
+                    "logging to a faster device, or a larger kis_log_queue_limit.",
+                    (uint64_t) writer_rows_dropped);
+        }
+
         return;
+    }
 
-    local_demand_locker dblock(&ds_mutex);
-    db_lock_with_sync_check(dblock, return);
+    std::unique_lock<std::mutex> lk(writer_space_mutex);
+
+    // Everything else waits for the writer to catch up
+    if (writer_queue_limit != 0)
+        writer_space_cv.wait(lk, [this]() {
+                return writer_queued < writer_queue_limit || !writer_running;
+                });
+
+    // stop_writer queues the shutdown marker under the same lock, so a row is either
+    // ahead of it and written, or refused here; never queued behind it and lost
+    if (!writer_running) {
+        delete row;
+        return;
+    }
+
+    writer_queued++;
+    write_queue.enqueue(row);
+}
+
+int kis_database_logfile::write_row(db_row *row) {
+    auto stmt = *(row->stmt);
+
+    if (stmt == nullptr)
+        return 0;
+
+    sqlite3_reset(stmt);
+
+    int pos = 1;
+
+    for (const auto& v : row->values) {
+        switch (v.type) {
+            case db_row::value_type::i64:
+                sqlite3_bind_int64(stmt, pos++, v.i);
+                break;
+            case db_row::value_type::dbl:
+                sqlite3_bind_double(stmt, pos++, v.d);
+                break;
+            case db_row::value_type::text:
+                sqlite3_bind_text(stmt, pos++, v.s.data(), v.s.length(), SQLITE_STATIC);
+                break;
+            case db_row::value_type::blob:
+                sqlite3_bind_blob(stmt, pos++, v.s.data(), v.s.length(), SQLITE_STATIC);
+                break;
+        }
+    }
+
+    auto r = sqlite3_step(stmt);
+
+    // Release the row data before it's freed
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+
+    if (r != SQLITE_DONE) {
+        _MSG_ERROR("kis_database_logfile unable to insert {} in {}: {}; kismetdb logging "
+                "disabled.", row->what, ds_dbfile, sqlite3_errmsg(db));
+        db_enabled = false;
+        return -1;
+    }
+
+    return 1;
+}
+
+void kis_database_logfile::compress_row(db_row *row) {
+    if (row->comp_blob < 0 || row->comp_flag < 0)
+        return;
+
+    auto& blob = row->values[row->comp_blob].s;
+
+    // Tiny records only grow
+    if (blob.length() < 32)
+        return;
+
+    // Build the dictionary for this kind of record from the first records seen; zlib
+    // finds matches in a preset dictionary the same as in prior data, so common frames
+    // and common json keys are matched instead of stored again
+    auto& dict = compress_dicts[row->dict_key];
+
+    if (dict.id == 0) {
+        dict.data.append(blob, 0, std::min(blob.length(), (size_t) 2048));
+
+        if (dict.data.length() >= KISMETDB_DICT_MAX) {
+            dict.data.resize(KISMETDB_DICT_MAX);
+            dict.id = next_dict_id++;
+
+            sqlite3_reset(dict_stmt);
+            sqlite3_bind_int64(dict_stmt, 1, dict.id);
+            sqlite3_bind_text(dict_stmt, 2, row->dict_key.data(), row->dict_key.length(), SQLITE_STATIC);
+            sqlite3_bind_blob(dict_stmt, 3, dict.data.data(), dict.data.length(), SQLITE_STATIC);
+
+            auto r = sqlite3_step(dict_stmt);
+
+            sqlite3_reset(dict_stmt);
+            sqlite3_clear_bindings(dict_stmt);
+
+            if (r != SQLITE_DONE) {
+                _MSG_ERROR("kis_database_logfile unable to insert compression dictionary in {}: {}; "
+                        "logging uncompressed.", ds_dbfile, sqlite3_errmsg(db));
+                deflateEnd(&compress_zs);
+                compress_enabled = false;
+                return;
+            }
+        }
+    }
+
+    compress_buf.resize(kismetdb_comp_bound(blob.length()));
+
+    long clen;
+
+    if (dict.id != 0)
+        clen = kismetdb_compress(&compress_zs, (const uint8_t *) blob.data(), blob.length(),
+                dict.id, (const uint8_t *) dict.data.data(), dict.data.length(),
+                compress_buf.data(), compress_buf.size());
+    else
+        clen = kismetdb_compress(&compress_zs, (const uint8_t *) blob.data(), blob.length(),
+                0, nullptr, 0, compress_buf.data(), compress_buf.size());
+
+    if (clen < 0 || (size_t) clen >= blob.length())
+        return;
+
+    blob.assign((const char *) compress_buf.data(), clen);
+    row->values[row->comp_flag].i = KISMETDB_COMP_ZLIB;
+}
+
+void kis_database_logfile::writer_thread_fn() {
+    std::vector<db_row *> batch(1024);
+    bool shutdown = false;
+
+    size_t txn_rows = 0;
+    auto txn_start = std::chrono::steady_clock::now();
+
+    while (!shutdown) {
+        // Take everything queued, up to a batch, waking periodically to commit
+        auto n_rows = write_queue.wait_dequeue_bulk_timed(batch.begin(), batch.size(), 
+                std::chrono::milliseconds(250));
+
+        // Rows taken off the queue, not counting the shutdown marker
+        size_t n_dequeued = 0;
+
+        {
+            local_locker dblock(&ds_mutex);
 
-    sqlite3_reset(msg_stmt);
+            for (size_t r = 0; r < n_rows; r++) {
+                // A null row marks shutdown; write anything ahead of it and stop
+                if (batch[r] == nullptr) {
+                    shutdown = true;
+                    continue;
+                }
 
-    unsigned int spos = 1;
+                n_dequeued++;
 
-    sqlite3_bind_int64(msg_stmt, spos++, time(0));
+                if (compress_enabled && db_enabled)
+                    compress_row(batch[r]);
+
+                if (db_enabled && write_row(batch[r]) > 0) {
+                    writer_rows_written++;
+                    txn_rows++;
+                }
+
+                delete batch[r];
+            }
+
+            // Commit groups as large as the backlog allows, bounded by row count and
+            // by time so a quiet log still reaches the disk
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::steady_clock::now() - txn_start).count();
+
+            if (txn_rows > 0 && (shutdown || (commit_rows != 0 && txn_rows >= commit_rows) ||
+                        elapsed >= commit_interval_ms)) {
+                in_transaction_sync = true;
+
+                sqlite3_exec(db, "END TRANSACTION", NULL, NULL, NULL);
+                sqlite3_exec(db, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+                in_transaction_sync = false;
+
+                writer_commits++;
+                txn_rows = 0;
+                txn_start = std::chrono::steady_clock::now();
+            } else if (txn_rows == 0) {
+                txn_start = std::chrono::steady_clock::now();
+            }
+        }
+
+        if (n_dequeued > 0) {
+            writer_queued -= n_dequeued;
+
+            {
+                std::lock_guard<std::mutex> lk(writer_space_mutex);
+            }
+            writer_space_cv.notify_all();
+        }
+    }
+}
+
+void kis_database_logfile::stop_writer() {
+    {
+        std::lock_guard<std::mutex> lk(writer_space_mutex);
+
+        if (!writer_running)
+            return;
+
+        // Nothing can be queued after the shutdown marker; see queue_row
+        writer_running = false;
+        write_queue.enqueue(nullptr);
+    }
+
+    // Wake anyone waiting for queue space so they see we're stopping
+    writer_space_cv.notify_all();
+
+    if (writer_thread.joinable())
+        writer_thread.join();
+}
+
+void kis_database_logfile::handle_message(std::shared_ptr<tracked_message> msg) {
+    if (!db_enabled)
+        return;
+
+    auto row = new db_row(&msg_stmt, "message", false);
+
+    row->add_int(time(0));
 
     if (gpstracker != nullptr) {
         auto loc = std::shared_ptr<kis_gps_packinfo>(gpstracker->get_best_location());
 
         if (loc != nullptr && loc->fix >= 2) {
-            sqlite3_bind_double(msg_stmt, spos++, loc->lat);
-            sqlite3_bind_double(msg_stmt, spos++, loc->lon);
+            row->add_double(loc->lat);
+            row->add_double(loc->lon);
         } else {
-            sqlite3_bind_double(msg_stmt, spos++, 0);
-            sqlite3_bind_double(msg_stmt, spos++, 0);
+            row->add_double(0);
+            row->add_double(0);
         }
     } else {
-        sqlite3_bind_double(msg_stmt, spos++, 0);
-        sqlite3_bind_double(msg_stmt, spos++, 0);
+        row->add_double(0);
+        row->add_double(0);
     }
 
     std::string msgtype;
@@ -885,19 +1380,15 @@ void kis_database_logfile::handle_message(std::shared_ptr<tracked_message> msg)
     else if (msg->get_flags() & MSGFLAG_FATAL)
         msgtype = "FATAL";
 
-    sqlite3_bind_text(msg_stmt, spos++, msgtype.c_str(), msgtype.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(msg_stmt, spos++, msg->get_message().c_str(), msg->get_message().length(), SQLITE_TRANSIENT);
+    row->add_text(msgtype);
+    row->add_text(msg->get_message());
 
-    if (sqlite3_step(msg_stmt) != SQLITE_DONE) {
-        close_log();
-        _MSG_ERROR("Unable to insert message into {}: {}", ds_dbfile, sqlite3_errmsg(db));
-    }
+    queue_row(row);
 }
 
 int kis_database_logfile::log_device(std::shared_ptr<kis_tracked_device_base> d) {
-    // We avoid using external mutexes here and try to let sqlite3 handle its own
-    // internal locking state; we don't want a huge device list write to block packet
-    // writes for instance
+    // Devices are serialized on the calling thread and handed to the writer, so a
+    // huge device list write never blocks packet writes on disk I/O
     
     if (!db_enabled)
         return 0;
@@ -920,7 +1411,8 @@ int kis_database_logfile::log_device(std::shared_ptr<kis_tracked_device_base> d)
     typestring = d->get_type_string();
     keystring = d->get_key().as_string();
 
-    int spos = 1;
+    if (device_deltas && !log_device_delta(d, keystring, phystring, macstring))
+        return 1;
 
     std::stringstream sstr;
 
@@ -932,64 +1424,136 @@ int kis_database_logfile::log_device(std::shared_ptr<kis_tracked_device_base> d)
         return 0;
     }
 
+    auto row = new db_row(&device_stmt, "device", false);
+
+    row->add_int(d->get_first_time());
+    row->add_int(d->get_last_time());
+    row->add_text(keystring);
+    row->add_text(phystring);
+    row->add_text(macstring);
+    row->add_int(d->get_signal_data()->get_max_signal());
+
+    if (d->get_tracker_location() != NULL) {
+        row->add_double(d->get_location()->get_min_loc()->get_lat());
+        row->add_double(d->get_location()->get_min_loc()->get_lon());
+        row->add_double(d->get_location()->get_max_loc()->get_lat());
+        row->add_double(d->get_location()->get_max_loc()->get_lon());
+        row->add_double(d->get_location()->get_avg_loc()->get_lat());
+        row->add_double(d->get_location()->get_avg_loc()->get_lon());
+    } else {
+        // Empty location
+        for (unsigned int i = 0; i < 6; i++)
+            row->add_double(0);
+    }
 
-    std::string streamstring = sstr.str();
+    row->add_int(d->get_datasize());
+    row->add_text(typestring);
 
-    {
-        local_demand_locker dblock(&ds_mutex);
-        db_lock_with_sync_check(dblock, return -1);
-
-        sqlite3_reset(device_stmt);
-
-        sqlite3_bind_int64(device_stmt, spos++, d->get_first_time());
-        sqlite3_bind_int64(device_stmt, spos++, d->get_last_time());
-        sqlite3_bind_text(device_stmt, spos++, keystring.c_str(), 
-                keystring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(device_stmt, spos++, phystring.c_str(), 
-                phystring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(device_stmt, spos++, macstring.c_str(), 
-                macstring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_int(device_stmt, spos++, d->get_signal_data()->get_max_signal());
-
-        if (d->get_tracker_location() != NULL) {
-            sqlite3_bind_double(device_stmt, spos++, 
-                    d->get_location()->get_min_loc()->get_lat());
-            sqlite3_bind_double(device_stmt, spos++,
-                    d->get_location()->get_min_loc()->get_lon());
-            sqlite3_bind_double(device_stmt, spos++,
-                    d->get_location()->get_max_loc()->get_lat());
-            sqlite3_bind_double(device_stmt, spos++,
-                    d->get_location()->get_max_loc()->get_lon());
-            sqlite3_bind_double(device_stmt, spos++,
-                    d->get_location()->get_avg_loc()->get_lat());
-            sqlite3_bind_double(device_stmt, spos++,
-                    d->get_location()->get_avg_loc()->get_lon());
-        } else {
-            // Empty location
-            sqlite3_bind_double(device_stmt, spos++, 0);
-            sqlite3_bind_double(device_stmt, spos++, 0);
-            sqlite3_bind_double(device_stmt, spos++, 0);
-            sqlite3_bind_double(device_stmt, spos++, 0);
-            sqlite3_bind_double(device_stmt, spos++, 0);
-            sqlite3_bind_double(device_stmt, spos++, 0);
+    auto streamstring = sstr.str();
+    row->add_compressible_blob(streamstring.data(), streamstring.length(), 
+            fmt::format("device/{}", phystring));
+    row->add_compression();
+
+    queue_row(row);
+
+    return 1;
+}
+
+bool kis_database_logfile::log_device_delta(std::shared_ptr<kis_tracked_device_base> d,
+        const std::string& keystring, const std::string& phystring, 
+        const std::string& macstring) {
+
+    local_locker dl(&device_delta_mutex);
+
+    auto now = time(0);
+
+    // Forget devices which haven't changed in a while; if they change again they start
+    // over with a checkpoint
+    if (now - last_delta_prune > (time_t) device_checkpoint_interval) {
+        last_delta_prune = now;
+
+        for (auto di = device_delta_map.begin(); di != device_delta_map.end(); ) {
+            if (now - di->second->last_logged > 2 * (time_t) device_checkpoint_interval)
+                di = device_delta_map.erase(di);
+            else
+                ++di;
         }
+    }
 
-        sqlite3_bind_int64(device_stmt, spos++, d->get_datasize());
-        sqlite3_bind_text(device_stmt, spos++, typestring.c_str(), 
-                typestring.length(), SQLITE_TRANSIENT);
+    auto& rec = device_delta_map[d->get_key()];
 
-        sqlite3_bind_blob(device_stmt, spos++, streamstring.c_str(), 
-                streamstring.length(), SQLITE_TRANSIENT);
+    if (rec == nullptr) {
+        rec = std::make_shared<device_delta_rec>();
+        rec->last_checkpoint = 0;
+    }
 
-        if (sqlite3_step(device_stmt) != SQLITE_DONE) {
-            _MSG("kis_database_logfile unable to insert device in " +
-                    ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            close_log();
-            return -1;
+    rec->last_logged = now;
+
+    std::vector<tracker_component_delta::change> changes;
+
+    d->pre_serialize();
+    d->collect_changes(rec->state, 
+            [](const shared_tracker_element& e, std::string& out) {
+                std::stringstream ss;
+                json_adapter::pack(ss, e);
+                out = ss.str();
+            }, changes);
+    d->post_serialize();
+
+    if (rec->last_checkpoint == 0 || 
+            now - rec->last_checkpoint >= (time_t) device_checkpoint_interval) {
+        rec->last_checkpoint = now;
+
+        // The full record replaces all the deltas before it
+        auto row = new db_row(&delta_clear_stmt, "device delta", false);
+        row->add_text(keystring);
+        queue_row(row);
+
+        return true;
+    }
+
+    if (changes.size() == 0)
+        return false;
+
+    std::string delta;
+
+    kismetdb_delta::put_varint(delta, changes.size());
+
+    for (const auto& c : changes) {
+        kismetdb_delta::put_varint(delta, c.path.size());
+
+        for (const auto& f : c.path) {
+            kismetdb_delta::put_varint(delta, f);
+
+            if (delta_fields_logged.find(f) == delta_fields_logged.end()) {
+                delta_fields_logged.insert(f);
+
+                auto frow = new db_row(&delta_field_stmt, "delta field", false);
+                frow->add_int(f);
+                frow->add_text(Globalreg::globalreg->entrytracker->get_field_name(f));
+                queue_row(frow);
+            }
+        }
+
+        if (c.removed) {
+            kismetdb_delta::put_varint(delta, 0);
+        } else {
+            kismetdb_delta::put_varint(delta, c.value.length() + 1);
+            delta.append(c.value);
         }
     }
 
-    return 1;
+    auto row = new db_row(&device_delta_stmt, "device delta", false);
+
+    row->add_int(now);
+    row->add_text(keystring);
+    row->add_text(phystring);
+    row->add_text(macstring);
+    row->add_blob(delta);
+
+    queue_row(row);
+
+    return false;
 }
 
 int kis_database_logfile::log_packet(kis_packet *in_pack) {
@@ -1059,52 +1623,49 @@ int kis_database_logfile::log_packet(kis_packet *in_pack) {
 
     // Log into the PACKET table if we're a loggable packet (ie, have a link frame)
     if (chunk != nullptr) {
-        local_demand_locker dblock(&ds_mutex);
-        db_lock_with_sync_check(dblock, return -1);
-
-        sqlite3_reset(packet_stmt);
+        // Packets are the bulk of the log and are dropped rather than stalling the
+        // packet chain if the writer falls behind
+        auto row = new db_row(&packet_stmt, "packet", true);
 
-        int sql_pos = 1;
+        row->add_int(in_pack->ts.tv_sec);
+        row->add_int(in_pack->ts.tv_usec);
 
-        sqlite3_bind_int64(packet_stmt, sql_pos++, in_pack->ts.tv_sec);
-        sqlite3_bind_int64(packet_stmt, sql_pos++, in_pack->ts.tv_usec);
-
-        sqlite3_bind_text(packet_stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, deststring.c_str(), deststring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, transstring.c_str(), transstring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(packet_stmt, sql_pos++, keystring.c_str(), keystring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_double(packet_stmt, sql_pos++, frequency);
+        row->add_text(phystring);
+        row->add_text(macstring);
+        row->add_text(deststring);
+        row->add_text(transstring);
+        row->add_text(keystring);
+        row->add_double(frequency);
 
         if (gpsdata != NULL) {
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->lat);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->lon);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->alt);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->speed);
-            sqlite3_bind_double(packet_stmt, sql_pos++, gpsdata->heading);
+            row->add_double(gpsdata->lat);
+            row->add_double(gpsdata->lon);
+            row->add_double(gpsdata->alt);
+            row->add_double(gpsdata->speed);
+            row->add_double(gpsdata->heading);
         } else {
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
-            sqlite3_bind_double(packet_stmt, sql_pos++, 0);
+            for (unsigned int i = 0; i < 5; i++)
+                row->add_double(0);
         }
 
-        sqlite3_bind_int64(packet_stmt, sql_pos++, chunk->length);
+        row->add_int(chunk->length);
 
         if (radioinfo != nullptr) {
-            sqlite3_bind_int(packet_stmt, sql_pos++, radioinfo->signal_dbm);
+            row->add_int(radioinfo->signal_dbm);
         } else {
-            sqlite3_bind_int(packet_stmt, sql_pos++, 0);
+            row->add_int(0);
         }
 
-        sqlite3_bind_text(packet_stmt, sql_pos++, sourceuuidstring.c_str(), 
-                sourceuuidstring.length(), SQLITE_TRANSIENT);
+        row->add_text(sourceuuidstring);
+
+        row->add_int(chunk->dlt);
 
-        sqlite3_bind_int(packet_stmt, sql_pos++, chunk->dlt);
-        sqlite3_bind_blob(packet_stmt, sql_pos++, (const char *) chunk->data, chunk->length, 0);
+        // The packet data is only valid for the life of the packet, so the row keeps
+        // its own copy
+        row->add_compressible_blob((const char *) chunk->data, chunk->length,
+                fmt::format("packet/{}", chunk->dlt));
 
-        sqlite3_bind_int(packet_stmt, sql_pos++, in_pack->error);
+        row->add_int(in_pack->error);
 
         std::stringstream tagstream;
         bool space_needed = false;
@@ -1116,15 +1677,11 @@ int kis_database_logfile::log_packet(kis_packet *in_pack) {
             tagstream << tag;
         }
 
-        auto str = tagstream.str();
-        sqlite3_bind_text(packet_stmt, sql_pos++, str.c_str(), tagstream.str().length(), SQLITE_TRANSIENT);
+        row->add_text(tagstream.str());
 
-        if (sqlite3_step(packet_stmt) != SQLITE_DONE) {
-            _MSG("kis_database_logfile unable to insert packet in " +
-                    ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            close_log();
-            return -1;
-        }
+        row->add_compression();
+
+        queue_row(row);
     }
 
     // If the packet has a metablob record, log that; if the packet ONLY has meta data we should only get a 'data'
@@ -1153,49 +1710,31 @@ int kis_database_logfile::log_data(kis_gps_packinfo *gps, struct timeval tv,
     if (!db_enabled)
         return 0;
 
-    std::string macstring = devmac.mac_to_string();
-    std::string uuidstring = datasource_uuid.uuid_to_string();
+    auto row = new db_row(&data_stmt, "data", true);
 
-    {
-        local_demand_locker dblock(&ds_mutex);
-        db_lock_with_sync_check(dblock, return -1);
+    row->add_int(tv.tv_sec);
+    row->add_int(tv.tv_usec);
 
-        sqlite3_reset(data_stmt);
+    row->add_text(phystring);
+    row->add_text(devmac.mac_to_string());
 
-        int sql_pos = 1;
-
-        sqlite3_bind_int64(data_stmt, sql_pos++, tv.tv_sec);
-        sqlite3_bind_int64(data_stmt, sql_pos++, tv.tv_usec);
-
-        sqlite3_bind_text(data_stmt, sql_pos++, phystring.c_str(), phystring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(data_stmt, sql_pos++, macstring.c_str(), macstring.length(), SQLITE_TRANSIENT);
+    if (gps != NULL) {
+        row->add_double(gps->lat);
+        row->add_double(gps->lon);
+        row->add_double(gps->alt);
+        row->add_double(gps->speed);
+        row->add_double(gps->heading);
+    } else {
+        for (unsigned int i = 0; i < 5; i++)
+            row->add_double(0);
+    }
 
-        if (gps != NULL) {
-            sqlite3_bind_double(data_stmt, sql_pos++, gps->lat);
-            sqlite3_bind_double(data_stmt, sql_pos++, gps->lon);
-            sqlite3_bind_double(data_stmt, sql_pos++, gps->alt);
-            sqlite3_bind_double(data_stmt, sql_pos++, gps->speed);
-            sqlite3_bind_double(data_stmt, sql_pos++, gps->heading);
-        } else {
-            sqlite3_bind_double(data_stmt, sql_pos++, 0);
-            sqlite3_bind_double(data_stmt, sql_pos++, 0);
-            sqlite3_bind_double(data_stmt, sql_pos++, 0);
-            sqlite3_bind_double(data_stmt, sql_pos++, 0);
-            sqlite3_bind_double(data_stmt, sql_pos++, 0);
-        }
+    row->add_text(datasource_uuid.uuid_to_string());
 
-        sqlite3_bind_text(data_stmt, sql_pos++, uuidstring.c_str(), uuidstring.length(), SQLITE_TRANSIENT);
+    row->add_text(type);
+    row->add_text(json);
 
-        sqlite3_bind_text(data_stmt, sql_pos++, type.data(), type.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(data_stmt, sql_pos++, json.data(), json.length(), SQLITE_TRANSIENT);
-
-        if (sqlite3_step(data_stmt) != SQLITE_DONE) {
-            _MSG("kis_database_logfile unable to insert data in " +
-                    ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            close_log();
-            return -1;
-        }
-    }
+    queue_row(row);
 
     return 1;
 }
@@ -1224,39 +1763,21 @@ int kis_database_logfile::log_datasource(shared_tracker_element in_datasource) {
     std::shared_ptr<kis_datasource> ds =
         std::static_pointer_cast<kis_datasource>(in_datasource);
 
-    std::string uuidstring = ds->get_source_uuid().uuid_to_string();
-    std::string typestring = ds->get_source_builder()->get_source_type();
-    std::string defstring = ds->get_source_definition();
-    std::string namestring = ds->get_source_name();
-    std::string intfstring = ds->get_source_interface();
-
     std::stringstream ss;
-    std::string jsonstring;
 
     json_adapter::pack(ss, in_datasource, NULL);
-    jsonstring = ss.str();
 
-    {
-        local_demand_locker dblock(&ds_mutex);
-        db_lock_with_sync_check(dblock, return -1);
+    auto row = new db_row(&datasource_stmt, "datasource", false);
 
-        sqlite3_reset(datasource_stmt);
+    row->add_text(ds->get_source_uuid().uuid_to_string());
+    row->add_text(ds->get_source_builder()->get_source_type());
+    row->add_text(ds->get_source_definition());
+    row->add_text(ds->get_source_name());
+    row->add_text(ds->get_source_interface());
 
-        sqlite3_bind_text(datasource_stmt, 1, uuidstring.data(), uuidstring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(datasource_stmt, 2, typestring.data(), typestring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(datasource_stmt, 3, defstring.data(), defstring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(datasource_stmt, 4, namestring.data(), namestring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(datasource_stmt, 5, intfstring.data(), intfstring.length(), SQLITE_TRANSIENT);
+    row->add_blob(ss.str());
 
-        sqlite3_bind_blob(datasource_stmt, 6, jsonstring.data(), jsonstring.length(), SQLITE_TRANSIENT);
-
-        if (sqlite3_step(datasource_stmt) != SQLITE_DONE) {
-            _MSG("kis_database_logfile unable to insert datasource in " +
-                    ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            close_log();
-            return -1;
-        }
-    }
+    queue_row(row);
 
     return 1;
 }
@@ -1265,50 +1786,34 @@ int kis_database_logfile::log_alert(std::shared_ptr<tracked_alert> in_alert) {
     if (!db_enabled)
         return 0;
 
-    std::string macstring = in_alert->get_transmitter_mac().mac_to_string();
-    std::string phystring = devicetracker->fetch_phy_name(in_alert->get_phy());
-    std::string headerstring = in_alert->get_header();
-
     std::stringstream ss;
-    std::string jsonstring;
 
     json_adapter::pack(ss, in_alert, NULL);
-    jsonstring = ss.str();
 
     // Break the double timestamp into two integers
     double intpart, fractpart;
     fractpart = modf(in_alert->get_timestamp(), &intpart);
 
-    {
-        local_demand_locker dblock(&ds_mutex);
-        db_lock_with_sync_check(dblock, return -1);
-
-        sqlite3_reset(alert_stmt);
+    auto row = new db_row(&alert_stmt, "alert", false);
 
-        sqlite3_bind_int64(alert_stmt, 1, intpart);
-        sqlite3_bind_int64(alert_stmt, 2, fractpart * 1000000);
+    row->add_int(intpart);
+    row->add_int(fractpart * 1000000);
 
-        sqlite3_bind_text(alert_stmt, 3, phystring.c_str(), phystring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_text(alert_stmt, 4, macstring.c_str(), macstring.length(), SQLITE_TRANSIENT);
+    row->add_text(devicetracker->fetch_phy_name(in_alert->get_phy()));
+    row->add_text(in_alert->get_transmitter_mac().mac_to_string());
 
-        if (in_alert->get_location()->get_valid()) {
-            sqlite3_bind_double(alert_stmt, 5, in_alert->get_location()->get_lat());
-            sqlite3_bind_double(alert_stmt, 6, in_alert->get_location()->get_lon());
-        } else {
-            sqlite3_bind_int(alert_stmt, 5, 0);
-            sqlite3_bind_int(alert_stmt, 6, 0);
-        }
+    if (in_alert->get_location()->get_valid()) {
+        row->add_double(in_alert->get_location()->get_lat());
+        row->add_double(in_alert->get_location()->get_lon());
+    } else {
+        row->add_int(0);
+        row->add_int(0);
+    }
 
-        sqlite3_bind_text(alert_stmt, 7, headerstring.c_str(), headerstring.length(), SQLITE_TRANSIENT);
-        sqlite3_bind_blob(alert_stmt, 8, jsonstring.data(), jsonstring.length(), SQLITE_TRANSIENT);
+    row->add_text(in_alert->get_header());
+    row->add_blob(ss.str());
 
-        if (sqlite3_step(alert_stmt) != SQLITE_DONE) {
-            _MSG("kis_database_logfile unable to insert alert in " +
-                    ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-            close_log();
-            return -1;
-        }
-    }
+    queue_row(row);
 
     return 1;
 }
@@ -1319,43 +1824,35 @@ int kis_database_logfile::log_snapshot(kis_gps_packinfo *gps, struct timeval tv,
     if (!db_enabled)
         return 0;
 
-    local_demand_locker dblock(&ds_mutex);
-    db_lock_with_sync_check(dblock, return -1);
-
-    sqlite3_reset(snapshot_stmt);
+    auto row = new db_row(&snapshot_stmt, "snapshot", false);
 
-    sqlite3_bind_int64(snapshot_stmt, 1, tv.tv_sec);
-    sqlite3_bind_int64(snapshot_stmt, 2, tv.tv_usec);
+    row->add_int(tv.tv_sec);
+    row->add_int(tv.tv_usec);
 
     if (gps != NULL) {
-        sqlite3_bind_double(snapshot_stmt, 3, gps->lat);
-        sqlite3_bind_double(snapshot_stmt, 4, gps->lon);
+        row->add_double(gps->lat);
+        row->add_double(gps->lon);
     } else {
         if (gpstracker != nullptr) {
             auto loc = std::shared_ptr<kis_gps_packinfo>(gpstracker->get_best_location());
 
             if (loc != nullptr && loc->fix >= 2) {
-                sqlite3_bind_double(snapshot_stmt, 3, loc->lat);
-                sqlite3_bind_double(snapshot_stmt, 4, loc->lon);
+                row->add_double(loc->lat);
+                row->add_double(loc->lon);
             } else {
-                sqlite3_bind_int(snapshot_stmt, 3, 0);
-                sqlite3_bind_int(snapshot_stmt, 4, 0);
+                row->add_int(0);
+                row->add_int(0);
             }
         } else {
-            sqlite3_bind_int(snapshot_stmt, 3, 0);
-            sqlite3_bind_int(snapshot_stmt, 4, 0);
+            row->add_int(0);
+            row->add_int(0);
         }
     }
 
-    sqlite3_bind_text(snapshot_stmt, 5, snaptype.c_str(), snaptype.length(), SQLITE_TRANSIENT);
-    sqlite3_bind_text(snapshot_stmt, 6, json.data(), json.length(), SQLITE_TRANSIENT);
+    row->add_text(snaptype);
+    row->add_text(json);
 
-    if (sqlite3_step(snapshot_stmt) != SQLITE_DONE) {
-        _MSG("kis_database_logfile unable to insert snapshot in " +
-                ds_dbfile + ":" + std::string(sqlite3_errmsg(db)), MSGFLAG_ERROR);
-        close_log();
-        return -1;
-    }
+    queue_row(row);
 
     return 1;
 }
@@ -1375,7 +1872,7 @@ void kis_database_logfile::usage(const char *argv0) {
 void kis_database_logfile::pcapng_endp_handler(std::shared_ptr<kis_net_beast_httpd_connection> con) {
     using namespace kissqlite3;
 
-    auto query = _SELECT(db, "packets", {"ts_sec", "ts_usec", "datasource", "dlt", "packet"});
+    auto query = _SELECT(db, "packets", {"ts_sec", "ts_usec", "datasource", "dlt", "packet", "compression"});
 
     auto ts_start_k = con->http_variables().find("timestamp_start");
     if (ts_start_k != con->http_variables().end()) 
@@ -1481,15 +1978,27 @@ void kis_database_logfile::pcapng_endp_handler(std::shared_ptr<kis_net_beast_htt
                 sqlite3_column_as<std::string>(ds, 2));
     }
 
+    kismetdb_decompressor decompressor(db);
+
     // Database handler registers itself as timing out so this should be OK to just blitz through
     // now, we'll block as necessary
     for (auto p : query) {
+        std::string packet;
+
+        try {
+            packet = decompressor.expand(sqlite3_column_as<std::string>(p, 4),
+                    sqlite3_column_as<int>(p, 5));
+        } catch (const std::runtime_error& e) {
+            _MSG_ERROR("Skipping packet from kismetdb log {}: {}", ds_dbfile, e.what());
+            continue;
+        }
+
         if (pcapng->pcapng_write_database_packet(
                     sqlite3_column_as<std::uint64_t>(p, 0),
                     sqlite3_column_as<std::uint64_t>(p, 1),
                     sqlite3_column_as<std::string>(p, 2),
                     sqlite3_column_as<unsigned int>(p, 3),
-                    sqlite3_column_as<std::string>(p, 4)) < 0) {
+                    packet) < 0) {
             return;
         }
     }
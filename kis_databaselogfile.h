@@ -38,8 +38,15 @@
 #include "config.h"
 
 #include <atomic>
+#include <condition_variable>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
 
 #include "globalregistry.h"
 #include "kis_mutex.h"
@@ -54,6 +61,10 @@
 #include "packet_filter.h"
 #include "messagebus.h"
 
+#include "kismetdb_compress.h"
+#include "kismetdb_delta.h"
+#include "moodycamel/blockingconcurrentqueue.h"
+
 // This is a bit of a unique case - because so many things plug into this, it has
 // to exist as a global record; we build it like we do any other global record;
 // then the builder hooks it, sets the internal builder record, and passed it to
@@ -187,12 +198,145 @@ protected:
     sqlite3_stmt *snapshot_stmt;
     const char *snapshot_pz;
 
+    sqlite3_stmt *dict_stmt;
+    const char *dict_pz;
+
+    sqlite3_stmt *device_delta_stmt;
+    const char *device_delta_pz;
+
+    sqlite3_stmt *delta_clear_stmt;
+    const char *delta_clear_pz;
+
+    sqlite3_stmt *delta_field_stmt;
+    const char *delta_field_pz;
+
     static int packet_handler(CHAINCALL_PARMS);
 
-    // Keep track of our commit cycles; to avoid thrashing the filesystem with
-    // commit state we run a 10 second tranasction commit loop
+    // Rows are extracted into a db_row on the calling thread and queued to a single
+    // writer thread, which binds and steps them in groups inside a long-running
+    // transaction.  Callers never wait on sqlite I/O; if the disk falls behind and
+    // the queue fills, packet and data rows are dropped (and counted) while other
+    // rows wait for room.
+    class db_row {
+    public:
+        enum class value_type { i64, dbl, text, blob };
+
+        struct value {
+            value_type type;
+            int64_t i;
+            double d;
+            std::string s;
+        };
+
+        db_row(sqlite3_stmt **stmt, const char *what, bool droppable) :
+            stmt{stmt},
+            what{what},
+            droppable{droppable},
+            comp_blob{-1},
+            comp_flag{-1} { }
+
+        void add_int(int64_t v) { values.push_back(value{value_type::i64, v, 0, ""}); }
+        void add_double(double v) { values.push_back(value{value_type::dbl, 0, v, ""}); }
+        void add_text(const std::string& v) { values.push_back(value{value_type::text, 0, 0, v}); }
+        void add_blob(const std::string& v) { values.push_back(value{value_type::blob, 0, 0, v}); }
+        void add_blob(const char *v, size_t len) { 
+            values.push_back(value{value_type::blob, 0, 0, std::string(v, len)}); 
+        }
+
+        // A blob the writer may compress, using dictionaries built per key
+        void add_compressible_blob(const char *v, size_t len, const std::string& key) {
+            comp_blob = values.size();
+            dict_key = key;
+            add_blob(v, len);
+        }
+
+        // The compression column for the compressible blob
+        void add_compression() {
+            comp_flag = values.size();
+            add_int(KISMETDB_COMP_NONE);
+        }
+
+        // Statement slot; read by the writer so a finalized statement is never used
+        sqlite3_stmt **stmt;
+        const char *what;
+        bool droppable;
+        std::vector<value> values;
+
+        int comp_blob, comp_flag;
+        std::string dict_key;
+    };
+
+    // Compress the compressible blob of a row in place, if it helps; writer only,
+    // must hold ds_mutex
+    void compress_row(db_row *row);
+
+    // Preset dictionaries, built from the first records of each key
+    struct comp_dict {
+        uint32_t id;
+        std::string data;
+    };
+
+    bool compress_enabled;
+    int compress_level;
+    z_stream compress_zs;
+    std::vector<uint8_t> compress_buf;
+    std::map<std::string, comp_dict> compress_dicts;
+    uint32_t next_dict_id;
+
+    // Queue a row for the writer; takes ownership
+    void queue_row(db_row *row);
+
+    void writer_thread_fn();
+    void stop_writer();
+
+    // Bind and step a row; must hold ds_mutex
+    int write_row(db_row *row);
+
+    std::thread writer_thread;
+    moodycamel::BlockingConcurrentQueue<db_row *> write_queue;
+    std::atomic<bool> writer_running;
+
+    // Rows queued but not yet written, for backpressure.  writer_space_mutex also orders
+    // queueing rows against stopping the writer
+    std::atomic<uint64_t> writer_queued;
+    std::mutex writer_space_mutex;
+    std::condition_variable writer_space_cv;
+
+    // Queue limit in rows, and the row and time limits of each commit group
+    unsigned int writer_queue_limit;
+    unsigned int commit_rows;
+    unsigned int commit_interval_ms;
+
+    std::atomic<uint64_t> writer_rows_written, writer_rows_dropped, writer_commits;
+    std::atomic<time_t> last_drop_user_warning;
+
+    int writer_queued_id, writer_written_id, writer_dropped_id, writer_commits_id;
+
+    // Devices are logged in full at each checkpoint, and only the fields which changed
+    // in between (see kismetdb_delta.h)
+    struct device_delta_rec {
+        tracker_component_delta state;
+        time_t last_checkpoint;
+        time_t last_logged;
+    };
+
+    // Log the changed fields of a device; returns true if the full device is due
+    // instead, after clearing the deltas it replaces
+    bool log_device_delta(std::shared_ptr<kis_tracked_device_base> d, 
+            const std::string& keystring, const std::string& phystring,
+            const std::string& macstring);
+
+    bool device_deltas;
+    unsigned int device_checkpoint_interval;
+    time_t last_delta_prune;
+
+    kis_recursive_timed_mutex device_delta_mutex;
+    std::unordered_map<device_key, std::shared_ptr<device_delta_rec>> device_delta_map;
+    // Fields already named in the delta_fields table
+    std::unordered_set<int> delta_fields_logged;
+
+    // Transactions are committed by the writer thread
     kis_recursive_timed_mutex transaction_mutex;
-    int transaction_timer;
 
     // Packet time limit
     unsigned int packet_timeout;
@@ -61,6 +61,7 @@ kis_datasource::kis_datasource(shared_datasource_builder in_builder) :
     pack_comp_protobuf = packetchain->register_packet_component("PROTOBUF");
 
     suppress_gps = false;
+    use_shm_ring = false;
 
     error_timer_id = -1;
     ping_timer_id = -1;
@@ -89,6 +90,8 @@ kis_datasource::~kis_datasource() {
 
     command_ack_map.clear();
 
+    close_shm_ring();
+
     // We don't call a normal close here because we can't risk double-free
     // or going through commands again - if the source is being deleted, it should
     // be completed!
@@ -100,6 +103,7 @@ void kis_datasource::list_interfaces(unsigned int in_transaction,
     lock.lock();
 
     mode_listing = true;
+    use_shm_ring = false;
 
     // If we can't list interfaces according to our prototype, die 
     // and call the cb instantly
@@ -145,6 +149,7 @@ void kis_datasource::probe_interface(std::string in_definition, unsigned int in_
     lock.lock();
 
     mode_probing = true;
+    use_shm_ring = false;
 
     set_int_source_definition(in_definition);
 
@@ -263,6 +268,11 @@ void kis_datasource::open_interface(std::string in_definition, unsigned int in_t
     if (error_timer_id > 0)
         timetracker->remove_timer(error_timer_id);
 
+    // Local helpers which support it can hand us packets through shared memory
+    use_shm_ring = get_source_builder()->get_shm_capable() &&
+        get_definition_opt_bool("shm_ring",
+                Globalreg::globalreg->kismet_config->fetch_opt_bool("datasource_shm_ring", false));
+
     // Launch the IPC
     launch_ipc();
 
@@ -421,6 +431,8 @@ void kis_datasource::close_source() {
 
     set_int_source_running(false);
 
+    close_shm_ring();
+
     close_external();
 }
 
@@ -681,6 +693,11 @@ bool kis_datasource::dispatch_rx_packet(std::shared_ptr<KismetExternal::Command>
         return true;
     } else if (c->command() == "KDSDATAREPORT") {
         handle_packet_data_report(c->seqno(), c->content());
+        ack_shm_ipc_report();
+        return true;
+    } else if (c->command() == "KDSDATAREPORTBATCH") {
+        handle_packet_data_report_batch(c->seqno(), c->content());
+        ack_shm_ipc_report();
         return true;
     } else if (c->command() == "KDSERRORREPORT") {
         handle_packet_error_report(c->seqno(), c->content());
@@ -1267,6 +1284,151 @@ void kis_datasource::handle_packet_data_report(uint32_t in_seqno, const std::str
     handle_rx_packet(packet);
 }
 
+void kis_datasource::handle_packet_data_report_batch(uint32_t in_seqno, 
+        const std::string& in_content) {
+    // If we're paused, throw away these packets
+    {
+        local_locker lock(&ext_mutex, "datasource::handle_packet_data_report_batch");
+
+        if (get_source_paused())
+            return;
+    }
+
+    KismetDatasource::DataReportBatch report;
+
+    if (!report.ParseFromString(in_content)) {
+        _MSG(std::string("Kismet datasource driver ") + get_source_builder()->get_source_type() + 
+                std::string(" could not parse the data report batch, something is wrong with "
+                    "the remote capture tool"), MSGFLAG_ERROR);
+        trigger_error("Invalid KDSDATAREPORTBATCH");
+        return;
+    }
+
+    auto now = time(0);
+    struct timeval clobber_ts;
+
+    if (clobber_timestamp && get_source_remote())
+        gettimeofday(&clobber_ts, NULL);
+
+    for (const auto& p : report.packets()) {
+        kis_packet *packet = packetchain->generate_packet();
+
+        kis_datachunk *datachunk = new kis_datachunk();
+
+        if (clobber_timestamp && get_source_remote()) {
+            packet->ts = clobber_ts;
+        } else {
+            packet->ts.tv_sec = p.time_sec();
+            packet->ts.tv_usec = p.time_usec();
+        }
+
+        if (get_source_override_linktype()) {
+            datachunk->dlt = get_source_override_linktype();
+        } else {
+            datachunk->dlt = p.dlt();
+        }
+
+        datachunk->copy_data((const uint8_t *) p.data().data(), p.data().length());
+
+        get_source_packet_size_rrd()->add_sample(p.data().length(), now);
+
+        packet->insert(pack_comp_linkframe, datachunk);
+
+        // Every packet gets its own copy of the shared context
+        if (report.has_signal())
+            packet->insert(pack_comp_l1info, handle_sub_signal(report.signal()));
+
+        if (report.has_gps()) {
+            packet->insert(pack_comp_gps, handle_sub_gps(report.gps()));
+        } else if (suppress_gps) {
+            auto nogpsinfo = new kis_no_gps_packinfo();
+            packet->insert(pack_comp_no_gps, nogpsinfo);
+        }
+
+        packetchain_comp_datasource *datasrcinfo = new packetchain_comp_datasource();
+        datasrcinfo->ref_source = this;
+
+        packet->insert(pack_comp_datasrc, datasrcinfo);
+
+        handle_rx_packet(packet);
+    }
+
+    inc_source_num_packets(report.packets_size());
+    get_source_packet_rrd()->add_sample(report.packets_size(), now);
+}
+
+void kis_datasource::close_shm_ring() {
+    local_locker lock(&ext_mutex, "datasource::close_shm_ring");
+
+    if (shm_ring != nullptr) {
+        shm_ring->stop();
+        shm_ring.reset();
+    }
+}
+
+void kis_datasource::ack_shm_ipc_report() {
+    std::shared_ptr<kis_shm_ring> ring;
+
+    {
+        local_locker lock(&ext_mutex, "datasource::ack_shm_ipc_report");
+        ring = shm_ring;
+    }
+
+    if (ring != nullptr)
+        ring->ipc_consumed();
+}
+
+void kis_datasource::handle_shm_frame(std::shared_ptr<kis_shm_ring> ring, kis_shm_ring_slot_t *slot) {
+    // If we're paused, throw away this packet
+    {
+        local_locker lock(&ext_mutex, "datasource::handle_shm_frame");
+
+        if (get_source_paused())
+            return;
+    }
+
+    // The helper can rewrite the slot under us; read the length once, and drop any
+    // frame which claims to run past the end of the slot
+    uint32_t caplen = __atomic_load_n(&slot->caplen, __ATOMIC_RELAXED);
+
+    if (caplen > ring->get_slot_capacity())
+        return;
+
+    kis_packet *packet = packetchain->generate_packet();
+
+    packet->ts.tv_sec = slot->ts_sec;
+    packet->ts.tv_usec = slot->ts_usec;
+
+    // The slot goes back to the helper as soon as we return, so copy the frame out
+    kis_datachunk *datachunk = new kis_datachunk();
+
+    if (get_source_override_linktype())
+        datachunk->dlt = get_source_override_linktype();
+    else
+        datachunk->dlt = slot->dlt;
+
+    datachunk->copy_data(slot->data, caplen);
+
+    get_source_packet_size_rrd()->add_sample(caplen, time(0));
+
+    packet->insert(pack_comp_linkframe, datachunk);
+
+    if (suppress_gps) {
+        auto nogpsinfo = new kis_no_gps_packinfo();
+        packet->insert(pack_comp_no_gps, nogpsinfo);
+    }
+
+    packetchain_comp_datasource *datasrcinfo = new packetchain_comp_datasource();
+    datasrcinfo->ref_source = this;
+
+    packet->insert(pack_comp_datasrc, datasrcinfo);
+
+    inc_source_num_packets(1);
+    get_source_packet_rrd()->add_sample(1, time(0));
+
+    handle_rx_packet(packet);
+}
+
 void kis_datasource::handle_rx_packet(kis_packet *packet) {
     // Inject the packet into the packetchain if we have one
     packetchain->process_packet(packet);
@@ -1392,6 +1554,7 @@ unsigned int kis_datasource::send_open_source(std::string in_definition,
 
     KismetDatasource::OpenSource o;
     o.set_definition(in_definition);
+    o.set_batch_data(true);
 
     c->set_content(o.SerializeAsString());
 
@@ -1777,11 +1940,43 @@ bool kis_datasource::launch_ipc() {
 
     external_binary = get_source_ipc_binary();
 
+    close_shm_ring();
+    external_binary_args.clear();
+    external_binary_fds.clear();
+
+    if (use_shm_ring) {
+        shm_ring = kis_shm_ring::create(KIS_SHM_RING_SLOTS, KIS_SHM_RING_SLOT_SZ);
+
+        if (shm_ring != nullptr) {
+            external_binary_args.push_back(fmt::format("--shm-fd={}", shm_ring->get_shm_fd()));
+            external_binary_args.push_back(fmt::format("--shm-event-fd={}", shm_ring->get_event_fd()));
+            external_binary_fds.push_back(shm_ring->get_shm_fd());
+            external_binary_fds.push_back(shm_ring->get_event_fd());
+        } else {
+            _MSG_INFO("Data source '{} / {}' could not set up a shared memory packet ring, "
+                    "using the IPC pipe.", get_source_name(), get_source_definition());
+        }
+    }
+
     if (run_ipc()) {
         set_int_source_ipc_pid(ipc.pid);
+
+        if (shm_ring != nullptr) {
+            auto weak_src = std::weak_ptr<kis_external_interface>(shared_from_this());
+
+            shm_ring->start([weak_src](std::shared_ptr<kis_shm_ring> ring, kis_shm_ring_slot_t *slot) {
+                    auto src = std::static_pointer_cast<kis_datasource>(weak_src.lock());
+
+                    if (src != nullptr)
+                        src->handle_shm_frame(ring, slot);
+                });
+        }
+
         return true;
     }
 
+    close_shm_ring();
+
     _MSG_ERROR("Data source '{} / {}' could not launch IPC helper", get_source_name(), 
             get_source_definition());
 
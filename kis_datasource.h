@@ -32,6 +32,7 @@
 #include "packetchain.h"
 #include "entrytracker.h"
 #include "kis_external.h"
+#include "kis_shm_ring.h"
 #include "timetracker.h"
 
 #include "protobuf_cpp/kismet.pb.h"
@@ -116,6 +117,8 @@ public:
 
     __Proxy(hop_capable, uint8_t, bool, bool, hop_capable);
 
+    __Proxy(shm_capable, uint8_t, bool, bool, shm_capable);
+
 protected:
     virtual void register_fields() override {
         tracker_component::register_fields();
@@ -152,6 +155,9 @@ protected:
 
         register_field("kismet.datasource_driver.hop_capable",
                 "Datasource can channel hop", &hop_capable);
+
+        register_field("kismet.datasource_driver.shm_capable",
+                "Datasource IPC helper can deliver packets via a shared memory ring", &shm_capable);
     }
 
     virtual void reserve_fields(std::shared_ptr<tracker_element_map> e) override {
@@ -174,6 +180,7 @@ protected:
     std::shared_ptr<tracker_element_uint8> passive_capable;
     std::shared_ptr<tracker_element_uint8> tune_capable;
     std::shared_ptr<tracker_element_uint8> hop_capable;
+    std::shared_ptr<tracker_element_uint8> shm_capable;
 };
 
 
@@ -505,6 +512,7 @@ protected:
 
     virtual void handle_packet_configure_report(uint32_t in_seqno, const std::string& in_packet);
     virtual void handle_packet_data_report(uint32_t in_seqno, const std::string& in_packet);
+    virtual void handle_packet_data_report_batch(uint32_t in_seqno, const std::string& in_packet);
     virtual void handle_packet_error_report(uint32_t in_seqno, const std::string& in_packet);
     virtual void handle_packet_interfaces_report(uint32_t in_seqno, const std::string& in_packet);
     virtual void handle_packet_opensource_report(uint32_t in_seqno, const std::string& in_packet);
@@ -720,6 +728,15 @@ protected:
     // We suppress automatically adding GPS to packets from this source
     bool suppress_gps;
 
+    // Shared memory packet ring to a local IPC helper, if enabled for this source
+    bool use_shm_ring;
+    std::shared_ptr<kis_shm_ring> shm_ring;
+
+    void close_shm_ring();
+    void handle_shm_frame(std::shared_ptr<kis_shm_ring> ring, kis_shm_ring_slot_t *slot);
+    // Tell the helper a data report from the IPC pipe has been handled
+    void ack_shm_ipc_report();
+
     // packet_chain
     std::shared_ptr<packet_chain> packetchain;
 
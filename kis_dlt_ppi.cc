@@ -300,27 +300,21 @@ int kis_dlt_ppi::handle_packet(kis_packet *in_pack) {
         in_pack->insert(pack_comp_checksum, fcschunk);
     }
 
-    // We've put the FCS in the fcschunk, so we just call the datasource FCS function
+    // PPI can carry any DLT; when it carries 802.11 we can check the FCS locally, 
+    // like radiotap.  This only marks the checksum status; PPI packets with a bad 
+    // FCS are still passed on as they always have been.
     if (datasrc != NULL && datasrc->ref_source != NULL && fcschunk != NULL &&
-            fcschunk->checksum_valid) {
-        datasrc->ref_source->checksum_packet(in_pack);
-    }
-
-#if 0
-    if (capsrc != NULL && capsrc->ref_source->FetchValidateCRC() && fcschunk != NULL) {
-        // Compare it and flag the packet
-        uint32_t calc_crc =
-            crc32_le_80211(globalreg->crc32_table, decapchunk->data, 
-                    decapchunk->length);
+            fcschunk->checksum_valid && ppi_dlt == KDLT_IEEE802_11) {
+        uint32_t calc_crc = crc32_80211(decapchunk->data, decapchunk->length);
+        uint32_t flipped_crc = kis_swap32(calc_crc);
 
-        if (memcmp(fcschunk->checksum_ptr, &calc_crc, 4)) {
-            in_pack->error = 1;
+        if (memcmp(fcschunk->checksum_ptr, &calc_crc, 4) &&
+                memcmp(fcschunk->checksum_ptr, &flipped_crc, 4)) {
             fcschunk->checksum_valid = 0;
         } else {
             fcschunk->checksum_valid = 1;
         }
     }
-#endif
 
 
     return 1;
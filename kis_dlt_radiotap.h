@@ -50,14 +50,6 @@ public:
 	virtual ~kis_dlt_radiotap() { };
 
 	virtual int handle_packet(kis_packet *in_pack);
-
-protected:
-    unsigned int update_crc32_80211(unsigned int crc, const unsigned char *data,
-            int len, unsigned int poly);
-    void crc32_init_table_80211(unsigned int *crc32_table);
-    unsigned int crc32_le_80211(unsigned int *crc32_table, const unsigned char *buf, int len);
-
-    unsigned int crc32_table[256];
 };
 
 #endif
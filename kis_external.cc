@@ -18,6 +18,7 @@
 
 #include <memory>
 #include <sys/stat.h>
+#include <fcntl.h>
 
 #include "configfile.h"
 
@@ -413,6 +414,9 @@ bool kis_external_interface::run_ipc() {
         ::close(inpipepair[1]);
         ::close(outpipepair[0]);
 
+        for (auto fd : external_binary_fds)
+            fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) & ~FD_CLOEXEC);
+
         execvp(cmdarg[0], cmdarg);
 
         exit(255);
@@ -165,6 +165,8 @@ protected:
     // Pipe IPC
     std::string external_binary;
     std::vector<std::string> external_binary_args;
+    // Descriptors inherited by the launched binary, in addition to the IPC pipes
+    std::vector<int> external_binary_fds;
 
     kis_ipc_record ipc;
     boost::asio::posix::stream_descriptor ipc_in, ipc_out;
@@ -0,0 +1,172 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_FLAT_MAP_H__
+#define __KIS_FLAT_MAP_H__
+
+#include "config.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+// A sorted-vector map with the subset of the std::map API used by the tracked
+// element system.
+//
+// Tracked components hold a small, mostly fixed set of fields which are inserted
+// once and then looked up by id; a contiguous sorted vector costs one allocation
+// per component instead of one node per field plus a bucket array, and lookups
+// are a binary search over a few cache lines.
+//
+// Inserting or erasing invalidates iterators and references, unlike a node-based
+// map; callers must not hold them across modifications.
+template<typename K, typename V>
+class kis_flat_map {
+public:
+    using key_type = K;
+    using mapped_type = V;
+    using value_type = std::pair<K, V>;
+    using storage_t = std::vector<value_type>;
+    using iterator = typename storage_t::iterator;
+    using const_iterator = typename storage_t::const_iterator;
+    using size_type = typename storage_t::size_type;
+
+    kis_flat_map() { }
+
+    iterator begin() noexcept { return storage.begin(); }
+    const_iterator begin() const noexcept { return storage.begin(); }
+    const_iterator cbegin() const noexcept { return storage.cbegin(); }
+
+    iterator end() noexcept { return storage.end(); }
+    const_iterator end() const noexcept { return storage.end(); }
+    const_iterator cend() const noexcept { return storage.cend(); }
+
+    bool empty() const noexcept { return storage.empty(); }
+    size_type size() const noexcept { return storage.size(); }
+
+    void clear() noexcept {
+        storage.clear();
+    }
+
+    void reserve(size_type n) {
+        storage.reserve(n);
+    }
+
+    iterator find(const K& k) {
+        auto i = lower_bound(k);
+
+        if (i != storage.end() && i->first == k)
+            return i;
+
+        return storage.end();
+    }
+
+    const_iterator find(const K& k) const {
+        auto i = lower_bound(k);
+
+        if (i != storage.end() && i->first == k)
+            return i;
+
+        return storage.end();
+    }
+
+    size_type count(const K& k) const {
+        return find(k) != storage.end() ? 1 : 0;
+    }
+
+    V& at(const K& k) {
+        auto i = find(k);
+
+        if (i == storage.end())
+            throw std::out_of_range("kis_flat_map::at");
+
+        return i->second;
+    }
+
+    V& operator[](const K& k) {
+        auto i = lower_bound(k);
+
+        if (i == storage.end() || i->first != k)
+            i = storage.insert(i, value_type(k, V()));
+
+        return i->second;
+    }
+
+    // std::map semantics; does not replace existing values
+    std::pair<iterator, bool> insert(const value_type& v) {
+        auto i = lower_bound(v.first);
+
+        if (i != storage.end() && i->first == v.first)
+            return std::make_pair(i, false);
+
+        return std::make_pair(storage.insert(i, v), true);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& v) {
+        auto i = lower_bound(v.first);
+
+        if (i != storage.end() && i->first == v.first)
+            return std::make_pair(i, false);
+
+        return std::make_pair(storage.insert(i, std::move(v)), true);
+    }
+
+    template<typename... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        return insert(value_type(std::forward<Args>(args)...));
+    }
+
+    iterator erase(const_iterator i) {
+        return storage.erase(i);
+    }
+
+    iterator erase(iterator i) {
+        return storage.erase(i);
+    }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        return storage.erase(first, last);
+    }
+
+    size_type erase(const K& k) {
+        auto i = find(k);
+
+        if (i == storage.end())
+            return 0;
+
+        storage.erase(i);
+        return 1;
+    }
+
+protected:
+    iterator lower_bound(const K& k) {
+        return std::lower_bound(storage.begin(), storage.end(), k,
+                [](const value_type& v, const K& k) { return v.first < k; });
+    }
+
+    const_iterator lower_bound(const K& k) const {
+        return std::lower_bound(storage.begin(), storage.end(), k,
+                [](const value_type& v, const K& k) { return v.first < k; });
+    }
+
+    storage_t storage;
+};
+
+#endif
+
@@ -0,0 +1,197 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "endian_magic.h"
+#include "kis_lookup_db.h"
+#include "messagebus.h"
+#include "util.h"
+
+kis_lookup_db::kis_lookup_db() :
+    map{nullptr},
+    map_sz{0},
+    records{nullptr},
+    num_records{0},
+    num_fields{0},
+    strings{nullptr},
+    strings_len{0} { }
+
+kis_lookup_db::~kis_lookup_db() {
+    close();
+}
+
+void kis_lookup_db::close() {
+    if (map != nullptr)
+        munmap(map, map_sz);
+
+    map = nullptr;
+    map_sz = 0;
+    records = nullptr;
+    num_records = 0;
+    strings = nullptr;
+    strings_len = 0;
+}
+
+bool kis_lookup_db::is_lookup_db(const std::string& path) {
+    char magic[4];
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+        return false;
+
+    auto r = read(fd, magic, sizeof(magic));
+    ::close(fd);
+
+    return r == sizeof(magic) && memcmp(magic, KIS_LOOKUP_DB_MAGIC, sizeof(magic)) == 0;
+}
+
+bool kis_lookup_db::open(const std::string& path, const char *tag, unsigned int in_fields) {
+    struct stat sb;
+
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0) {
+        _MSG_ERROR("Could not open lookup table {}: {}", path, kis_strerror_r(errno));
+        return false;
+    }
+
+    if (fstat(fd, &sb) < 0) {
+        _MSG_ERROR("Could not open lookup table {}: {}", path, kis_strerror_r(errno));
+        ::close(fd);
+        return false;
+    }
+
+    if (sb.st_size < KIS_LOOKUP_DB_HDR_SZ) {
+        _MSG_ERROR("Could not open lookup table {}: file is truncated", path);
+        ::close(fd);
+        return false;
+    }
+
+    auto m = mmap(nullptr, sb.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+
+    if (m == MAP_FAILED) {
+        _MSG_ERROR("Could not map lookup table {}: {}", path, kis_strerror_r(errno));
+        return false;
+    }
+
+    map = m;
+    map_sz = sb.st_size;
+
+    auto hdr = (const uint32_t *) map;
+
+    if (memcmp(&hdr[0], KIS_LOOKUP_DB_MAGIC, 4) != 0 ||
+            kis_letoh32(hdr[1]) != KIS_LOOKUP_DB_VERSION) {
+        _MSG_ERROR("Could not open lookup table {}: unknown file type or version", path);
+        close();
+        return false;
+    }
+
+    if (strncmp((const char *) &hdr[2], tag, 4) != 0) {
+        _MSG_ERROR("Could not open lookup table {}: expected a '{}' table", path, tag);
+        close();
+        return false;
+    }
+
+    uint64_t n_records = kis_letoh32(hdr[3]);
+    uint64_t n_fields = kis_letoh32(hdr[4]);
+    uint64_t s_len = kis_letoh32(hdr[5]);
+
+    if (n_fields != in_fields) {
+        _MSG_ERROR("Could not open lookup table {}: expected {} fields per record, "
+                "found {}", path, in_fields, n_fields);
+        close();
+        return false;
+    }
+
+    if (KIS_LOOKUP_DB_HDR_SZ + (n_records * (n_fields + 1) * 4) + s_len != map_sz ||
+            s_len == 0) {
+        _MSG_ERROR("Could not open lookup table {}: file is truncated or corrupt", path);
+        close();
+        return false;
+    }
+
+    records = hdr + (KIS_LOOKUP_DB_HDR_SZ / 4);
+    num_records = n_records;
+    num_fields = n_fields;
+    strings = (const char *) (records + (n_records * (n_fields + 1)));
+    strings_len = s_len;
+
+    // Every string offset is bounded by the terminating NUL, and lookups depend on
+    // the records being in order
+    if (strings[strings_len - 1] != 0) {
+        _MSG_ERROR("Could not open lookup table {}: file is corrupt", path);
+        close();
+        return false;
+    }
+
+    for (size_t r = 1; r < num_records; r++) {
+        if (kis_letoh32(records[r * (num_fields + 1)]) <
+                kis_letoh32(records[(r - 1) * (num_fields + 1)])) {
+            _MSG_ERROR("Could not open lookup table {}: records are out of order", path);
+            close();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+const uint32_t *kis_lookup_db::find(uint32_t key) const {
+    size_t lo = 0, hi = num_records;
+
+    while (lo < hi) {
+        auto mid = lo + ((hi - lo) / 2);
+        auto rec = records + (mid * (num_fields + 1));
+        auto rkey = kis_letoh32(rec[0]);
+
+        if (rkey == key)
+            return rec;
+
+        if (rkey < key)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return nullptr;
+}
+
+const char *kis_lookup_db::field(const uint32_t *record, unsigned int f) const {
+    if (f >= num_fields)
+        return "";
+
+    auto offt = kis_letoh32(record[f + 1]);
+
+    if (offt >= strings_len)
+        return "";
+
+    return strings + offt;
+}
+
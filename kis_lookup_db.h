@@ -0,0 +1,92 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_LOOKUP_DB_H__
+#define __KIS_LOOKUP_DB_H__
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <string>
+
+// Prebuilt lookup tables, such as the OUI and ICAO databases, generated by
+// tools/kismet_lookup_db.py.  Tables are mapped read-only and searched in place,
+// so they need no indexing at startup and no locking to read.
+//
+// All values are little endian:
+//
+//   char magic[4]           "KLDB"
+//   uint32_t version        KIS_LOOKUP_DB_VERSION
+//   char tag[4]             table type, such as "OUI\0" or "ICAO"
+//   uint32_t num_records
+//   uint32_t num_fields     fields in each record, after the key
+//   uint32_t strings_len
+//   records[num_records]    uint32_t key, uint32_t fields[num_fields], sorted by key
+//   strings[strings_len]    NUL-terminated strings; fields are offsets into them
+
+#define KIS_LOOKUP_DB_MAGIC     "KLDB"
+#define KIS_LOOKUP_DB_VERSION   1
+#define KIS_LOOKUP_DB_HDR_SZ    24
+
+class kis_lookup_db {
+public:
+    kis_lookup_db();
+    ~kis_lookup_db();
+
+    kis_lookup_db(const kis_lookup_db&) = delete;
+    kis_lookup_db& operator=(const kis_lookup_db&) = delete;
+
+    // Does the file look like a lookup table, instead of a text database?
+    static bool is_lookup_db(const std::string& path);
+
+    // Map a table, checking that it is the expected type and is intact; errors are
+    // reported to the messagebus
+    bool open(const std::string& path, const char *tag, unsigned int num_fields);
+
+    bool is_open() const {
+        return map != nullptr;
+    }
+
+    size_t size() const {
+        return num_records;
+    }
+
+    // Find the record for a key, or nullptr
+    const uint32_t *find(uint32_t key) const;
+
+    // String value of a field of a record
+    const char *field(const uint32_t *record, unsigned int f) const;
+
+protected:
+    void close();
+
+    void *map;
+    size_t map_sz;
+
+    const uint32_t *records;
+    size_t num_records;
+    unsigned int num_fields;
+
+    const char *strings;
+    size_t strings_len;
+};
+
+#endif
+
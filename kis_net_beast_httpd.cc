@@ -24,11 +24,14 @@
 
 #include <stdio.h>
 
+#include <zlib.h>
+
 #include "alertracker.h"
 #include "base64.h"
 #include "configfile.h"
 #include "messagebus.h"
 #include "util.h"
+#include "xxhash.h"
 
 const std::string kis_net_beast_httpd::LOGON_ROLE{"logon"};
 const std::string kis_net_beast_httpd::ANY_ROLE{"any"};
@@ -77,6 +80,9 @@ kis_net_beast_httpd::kis_net_beast_httpd(boost::asio::ip::tcp::endpoint& endpoin
     lifetime_global{},
     deferred_startup{},
     running{false},
+    connections_accepted{0},
+    connections_open{0},
+    requests_served{0},
     endpoint{endpoint},
     acceptor{Globalreg::globalreg->io} {
 
@@ -84,6 +90,18 @@ kis_net_beast_httpd::kis_net_beast_httpd(boost::asio::ip::tcp::endpoint& endpoin
     route_mutex.set_name("kis_net_beast_httpd route vector");
     auth_mutex.set_name("kis_net_beast_httpd auth");
     static_mutex.set_name("kis_net_beast_httpd static");
+
+    size_t n_threads = 
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_threads", 0);
+
+    if (n_threads == 0)
+        n_threads = std::max(16U, std::thread::hardware_concurrency() * 4);
+
+    // Each request being served runs one generator, so the generator pool is bounded the
+    // same way; streams release their generator thread along with their request thread
+    // (see clear_timeout), and generators never wait on other generators
+    connection_pool_ = std::unique_ptr<kis_thread_pool>(new kis_thread_pool("httpd request", n_threads, n_threads / 4));
+    generator_pool_ = std::unique_ptr<kis_thread_pool>(new kis_thread_pool("httpd generator", n_threads, n_threads / 4));
 }
 
 void kis_net_beast_httpd::trigger_deferred_startup() {
@@ -97,6 +115,7 @@ void kis_net_beast_httpd::trigger_deferred_startup() {
     register_mime_type("prettyjson", "application/json");
     register_mime_type("ekjson", "application/json");
     register_mime_type("itjson", "application/json");
+    register_mime_type("kcol", "application/octet-stream");
     register_mime_type("cmd", "application/json");
     register_mime_type("jcmd", "application/json");
     register_mime_type("xml", "application/xml");
@@ -182,6 +201,16 @@ void kis_net_beast_httpd::trigger_deferred_startup() {
     allowed_cors_referrer_ =
         Globalreg::globalreg->kismet_config->fetch_opt_dfl("httpd_allowed_origin", "");
 
+    allow_compression_ =
+        Globalreg::globalreg->kismet_config->fetch_opt_bool("httpd_compression", true);
+    compression_level_ =
+        Globalreg::globalreg->kismet_config->fetch_opt_int("httpd_compression_level", 
+                Z_DEFAULT_COMPRESSION);
+    if (compression_level_ < Z_DEFAULT_COMPRESSION || compression_level_ > 9)
+        compression_level_ = Z_DEFAULT_COMPRESSION;
+    etag_max_sz_ =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("httpd_etag_max", 4 * 1024 * 1024);
+
     auto http_data_dir =
         Globalreg::globalreg->kismet_config->fetch_opt_path("httpd_home", "");
     if (http_data_dir == "") {
@@ -198,6 +227,68 @@ void kis_net_beast_httpd::trigger_deferred_startup() {
     allowed_prefix = 
         Globalreg::globalreg->kismet_config->fetch_opt("httpd_uri_prefix");
 
+    status_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.status",
+                tracker_element_factory<tracker_element_map>(),
+                "HTTP server status");
+    status_connections_open_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.connections_open",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Open connections");
+    status_connections_accepted_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.connections_accepted",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Connections accepted");
+    status_requests_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.requests",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Requests served");
+    status_connection_pool_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.request_pool",
+                tracker_element_factory<tracker_element_map>(),
+                "Request thread pool");
+    status_generator_pool_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.generator_pool",
+                tracker_element_factory<tracker_element_map>(),
+                "Response generator thread pool");
+    pool_threads_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.threads",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Threads in pool");
+    pool_busy_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.busy",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Threads running a task");
+    pool_queued_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.queued",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Tasks waiting for a thread");
+    pool_completed_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.completed",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Tasks completed");
+    pool_released_id = 
+        Globalreg::globalreg->entrytracker->register_field("kismet.httpd.pool.released",
+                tracker_element_factory<tracker_element_uint64>(),
+                "Long-running tasks moved out of the pool");
+
+    register_route("/system/httpd/status", {"GET"}, RO_ROLE, {"json"},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) -> std::shared_ptr<tracker_element> {
+                    auto ret = std::make_shared<tracker_element_map>(status_id);
+
+                    ret->insert(std::make_shared<tracker_element_uint64>(status_connections_open_id,
+                                (uint64_t) connections_open));
+                    ret->insert(std::make_shared<tracker_element_uint64>(status_connections_accepted_id,
+                                (uint64_t) connections_accepted));
+                    ret->insert(std::make_shared<tracker_element_uint64>(status_requests_id,
+                                (uint64_t) requests_served));
+                    ret->insert(pool_status(status_connection_pool_id, *connection_pool_));
+                    ret->insert(pool_status(status_generator_pool_id, *generator_pool_));
+
+                    return ret;
+                }));
+
     // Basic session management endpoints
     register_unauth_route("/session/check_setup_ok", {"GET"}, 
             std::make_shared<kis_net_web_function_endpoint>(
@@ -370,36 +461,131 @@ void kis_net_beast_httpd::handle_connection(const boost::system::error_code& ec,
     if (!running)
         return;
 
-    auto socket_moved = std::promise<bool>();
-    auto socket_moved_ft = socket_moved.get_future();
-
     if (!ec) {
-        std::thread conthread([this, &socket, &socket_moved]() {
-                thread_set_process_name("beast connection");
+        connections_accepted++;
+        connections_open++;
 
-                auto mv_socket = boost::beast::tcp_stream{std::move(socket)};
-                socket_moved.set_value(true);
+        wait_request(std::make_shared<boost::beast::tcp_stream>(std::move(socket)));
+    }
 
-                while (mv_socket.socket().is_open()) {
-                    auto retain =
-                        std::make_shared<kis_net_beast_httpd_connection>(mv_socket, shared_from_this())->start();
+    return start_accept();
+}
 
-                    if (retain == false)
-                        break;
-                }
+void kis_net_beast_httpd::wait_request(std::shared_ptr<boost::beast::tcp_stream> stream) {
+    if (!running)
+        return close_connection(stream);
+
+    // Idle connections are closed after the same timeout as an incomplete request
+    auto timer = std::make_shared<boost::asio::steady_timer>(Globalreg::globalreg->io);
+    timer->expires_after(std::chrono::seconds(30));
+    timer->async_wait([stream](const boost::system::error_code& ec) {
+            if (!ec) {
+                boost::system::error_code cancel_ec;
+                stream->socket().cancel(cancel_ec);
+            }
+        });
 
-                try {
-                    mv_socket.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send);
-                } catch (std::exception& e) {
-                    ;
-                }
+    auto self = shared_from_this();
+
+    stream->socket().async_wait(boost::asio::ip::tcp::socket::wait_read,
+            [this, self, stream, timer](const boost::system::error_code& ec) {
+                timer->cancel();
+
+                if (ec || !running)
+                    return close_connection(stream);
+
+                connection_pool_->post([this, self, stream]() {
+                    auto retain = 
+                        std::make_shared<kis_net_beast_httpd_connection>(*stream, self)->start();
+
+                    requests_served++;
+
+                    if (retain && stream->socket().is_open())
+                        return wait_request(stream);
+
+                    close_connection(stream);
+                });
             });
-        conthread.detach();
+}
+
+void kis_net_beast_httpd::close_connection(std::shared_ptr<boost::beast::tcp_stream> stream) {
+    connections_open--;
+
+    try {
+        stream->socket().shutdown(boost::asio::ip::tcp::socket::shutdown_send);
+    } catch (std::exception& e) {
+        ;
     }
+}
 
-    socket_moved_ft.wait();
+std::shared_ptr<tracker_element> kis_net_beast_httpd::pool_status(int id, kis_thread_pool& pool) {
+    auto stats = pool.get_stats();
+    auto ret = std::make_shared<tracker_element_map>(id);
 
-    return start_accept();
+    ret->insert(std::make_shared<tracker_element_uint64>(pool_threads_id, stats.threads));
+    ret->insert(std::make_shared<tracker_element_uint64>(pool_busy_id, stats.busy));
+    ret->insert(std::make_shared<tracker_element_uint64>(pool_queued_id, stats.queued));
+    ret->insert(std::make_shared<tracker_element_uint64>(pool_completed_id, stats.completed));
+    ret->insert(std::make_shared<tracker_element_uint64>(pool_released_id, stats.released));
+
+    return ret;
+}
+
+std::string kis_net_beast_httpd::negotiate_encoding(const boost::beast::http::request<boost::beast::http::string_body>& req) {
+    if (!allow_compression_)
+        return "";
+
+    auto ae_h = req.find(boost::beast::http::field::accept_encoding);
+    if (ae_h == req.end())
+        return "";
+
+    bool gzip = false, deflate = false;
+
+    for (const auto& t : str_tokenize(static_cast<std::string>(ae_h->value()), ",")) {
+        auto params = str_tokenize(t, ";");
+
+        if (params.size() == 0)
+            continue;
+
+        auto coding = str_lower(munge_to_printable(params[0]));
+        coding.erase(std::remove(coding.begin(), coding.end(), ' '), coding.end());
+
+        // Codings the client refuses are given a quality of 0
+        bool refused = false;
+        for (size_t p = 1; p < params.size(); p++) {
+            auto q = params[p];
+            q.erase(std::remove(q.begin(), q.end(), ' '), q.end());
+
+            if (q.find("q=") == 0 && string_to_n_dfl<double>(q.substr(2), 1) <= 0)
+                refused = true;
+        }
+
+        if (refused)
+            continue;
+
+        if (coding == "gzip")
+            gzip = true;
+        else if (coding == "deflate")
+            deflate = true;
+    }
+
+    if (gzip)
+        return "gzip";
+
+    if (deflate)
+        return "deflate";
+
+    return "";
+}
+
+bool kis_net_beast_httpd::compressible_mime_type(const boost::beast::string_view& type) {
+    auto t = str_lower(static_cast<std::string>(type));
+
+    return t.find("text/") == 0 ||
+        t.find("application/json") == 0 ||
+        t.find("application/javascript") == 0 ||
+        t.find("application/xml") == 0 ||
+        t.find("image/svg+xml") == 0;
 }
 
 std::string kis_net_beast_httpd::decode_uri(boost::beast::string_view in) {
@@ -924,7 +1110,8 @@ kis_net_beast_httpd_connection::kis_net_beast_httpd_connection(boost::beast::tcp
     httpd{httpd},
     stream_{socket},
     login_valid_{false},
-    first_response_write{false} {
+    first_response_write{false},
+    long_running{false} {
         Globalreg::n_tracked_http_connections++;
     }
 
@@ -965,6 +1152,10 @@ void kis_net_beast_httpd_connection::set_target_file(const std::string& fname) {
 
 void kis_net_beast_httpd_connection::clear_timeout() {
     boost::beast::get_lowest_layer(stream_).expires_never();
+    long_running = true;
+
+    // Called from the generator, which now runs until the client goes away
+    kis_thread_pool::release_current();
 }
 
 void kis_net_beast_httpd_connection::append_header(const std::string& header, const std::string& value) {
@@ -1109,6 +1300,9 @@ bool kis_net_beast_httpd_connection::start() {
 
         boost::beast::get_lowest_layer(stream_).expires_never();
 
+        // Websockets live for as long as the client wants; don't hold a request thread
+        kis_thread_pool::release_current();
+
         route->invoke(shared_from_this());
 
         return do_close();
@@ -1259,17 +1453,72 @@ bool kis_net_beast_httpd_connection::start() {
         boost::beast::http::fields> sr{response};
 
 
-    // Spawn the generator thread
-    auto generator_launched = std::promise<void>();
-    auto generator_ft = generator_launched.get_future();
+    // Compression is offered if the client accepts it; it's used if the content type 
+    // chosen by the endpoint is compressible, decided when the headers are written
+    auto encoding = httpd->negotiate_encoding(request_);
+
+    struct body_deflater {
+        z_stream zs;
+        bool active = false;
+        bool pending = false;
+
+        ~body_deflater() {
+            if (active)
+                deflateEnd(&zs);
+        }
+    } deflater;
+
+    char zbuf[16384];
+
+    boost::system::error_code error;
+
+    auto write_chunk = [&](const char *data, size_t len) -> bool {
+        response.body().data = (void *) data;
+        response.body().size = len;
+        response.body().more = true;
+
+        boost::beast::http::write(stream_, sr, error);
+
+        if (error == boost::beast::http::error::need_buffer) {
+            // Beast returns 'need_buffer' when it's completed writing a buffer, configure
+            // as a non-error
+            error = {};
+        } 
+        
+        return !error;
+    };
+
+    auto deflate_chunk = [&](const char *data, size_t len, int flush) -> bool {
+        deflater.zs.next_in = (Bytef *) data;
+        deflater.zs.avail_in = len;
+
+        do {
+            deflater.zs.next_out = (Bytef *) zbuf;
+            deflater.zs.avail_out = sizeof(zbuf);
+
+            if (deflate(&deflater.zs, flush) == Z_STREAM_ERROR)
+                return false;
 
-    std::thread tr([this, route, &generator_launched]() {
-        generator_launched.set_value();
+            auto have = sizeof(zbuf) - deflater.zs.avail_out;
 
+            if (have > 0 && !write_chunk(zbuf, have))
+                return false;
+        } while (deflater.zs.avail_out == 0);
+
+        deflater.pending = (flush == Z_NO_FLUSH);
+
+        return true;
+    };
+
+    // Run the generator on the shared pool; it holds a reference to the connection in
+    // case we fail and return before it finishes
+    auto self = shared_from_this();
+
+    httpd->generator_pool().post([this, self, route]() {
         // _MSG_INFO("invoking stream");
         try {
             // _MSG_INFO("(DEBUG) {} {} invoking route {}", verb_, uri_, route->route());
-            route->invoke(shared_from_this());
+            route->invoke(self);
         } catch (const std::exception& e) {
             std::ostream os(&response_stream_);
             os << "ERROR: " << e.what();
@@ -1278,17 +1527,36 @@ bool kis_net_beast_httpd_connection::start() {
 
         response_stream_.complete();
     });
-    tr.detach();
 
-    generator_ft.wait();
-
-    boost::system::error_code error;
     while (response_stream_.size() || response_stream_.running()) {
+        // Streams which run until the client goes away don't hold a request thread
+        if (long_running)
+            kis_thread_pool::release_current();
+
         auto sz = response_stream_.size();
 
         if (sz) {
             // Write the headers once we have body content
             if (!first_response_write) {
+                if (encoding.length() && compressible_type()) {
+                    auto vary = response.find(boost::beast::http::field::vary);
+                    if (vary == response.end())
+                        response.set(boost::beast::http::field::vary, "Accept-Encoding");
+                    else
+                        response.set(boost::beast::http::field::vary, 
+                                fmt::format("{}, Accept-Encoding", vary->value()));
+
+                    // Gzip adds a header to the deflate stream, 'deflate' is a zlib stream
+                    int window_bits = encoding == "gzip" ? 15 + 16 : 15;
+
+                    memset(&deflater.zs, 0, sizeof(z_stream));
+                    if (deflateInit2(&deflater.zs, httpd->compression_level(), Z_DEFLATED, 
+                                window_bits, 8, Z_DEFAULT_STRATEGY) == Z_OK) {
+                        deflater.active = true;
+                        response.set(boost::beast::http::field::content_encoding, encoding);
+                    }
+                }
+
                 boost::beast::http::write_header(stream_, sr, error);
 
                 if (error) {
@@ -1303,21 +1571,28 @@ bool kis_net_beast_httpd_connection::start() {
             char *body_data;
             auto chunk_sz = response_stream_.get(&body_data);
 
-            response.body().data = (void *) body_data;
-            response.body().size = chunk_sz;
-            response.body().more = true;
+            bool written;
 
-            boost::beast::http::write(stream_, sr, error);
+            if (deflater.active)
+                written = deflate_chunk(body_data, chunk_sz, Z_NO_FLUSH);
+            else
+                written = write_chunk(body_data, chunk_sz);
 
             response_stream_.consume(chunk_sz);
 
             // _MSG_INFO("(DEBUG) {} {} - Consumed {}/{} running {}", verb_, uri_, sz, response_stream_.size(), response_stream_.running());
 
-            if (error == boost::beast::http::error::need_buffer) {
-                // Beast returns 'need_buffer' when it's completed writing a buffer, configure
-                // as a non-error
-                error = {};
-            } else if (error) {
+            if (!written) {
+                _MSG_INFO("(DEBUG) {} {} - chunk write error {}", verb_, uri_, error.message());
+                response_stream_.cancel();
+                return do_close();
+            }
+        }
+
+        // Push out what the compressor is holding before we wait for the generator, so
+        // that streamed responses aren't delayed
+        if (deflater.pending && response_stream_.size() == 0 && response_stream_.running()) {
+            if (!deflate_chunk(nullptr, 0, Z_SYNC_FLUSH)) {
                 _MSG_INFO("(DEBUG) {} {} - chunk write error {}", verb_, uri_, error.message());
                 response_stream_.cancel();
                 return do_close();
@@ -1332,6 +1607,15 @@ bool kis_net_beast_httpd_connection::start() {
 
     // _MSG_INFO("(DEBUG) {} {} - Out of buffer poll loop, remaining {}, running {}", verb_, uri_, response_stream_.size(), response_stream_.running());
 
+    if (deflater.active && !deflate_chunk(nullptr, 0, Z_FINISH)) {
+        _MSG_INFO("(DEBUG) {} {} - Error writing conclusion of stream: {}", verb_, uri_, error.message());
+        return do_close();
+    }
+
+    // A 304 Not Modified has no body at all, not even an empty chunked one
+    if (!first_response_write && response.result() == boost::beast::http::status::not_modified)
+        response.chunked(false);
+
     // Send the completion record for the chunked response
     response.body().data = nullptr;
     response.body().size = 0;
@@ -1347,6 +1631,21 @@ bool kis_net_beast_httpd_connection::start() {
     return true;
 }
 
+bool kis_net_beast_httpd_connection::compressible_type() {
+    if (verb_ == boost::beast::http::verb::head)
+        return false;
+
+    // Streams are sent as they're generated, and generally aren't text
+    if (long_running)
+        return false;
+
+    auto ct = response.find(boost::beast::http::field::content_type);
+    if (ct == response.end())
+        return false;
+
+    return kis_net_beast_httpd::compressible_mime_type(ct->value());
+}
+
 bool kis_net_beast_httpd_connection::do_close() {
     if (closure_cb) {
         closure_cb();
@@ -1540,6 +1839,64 @@ Json::Value kis_net_beast_auth::as_json() {
 }
 
 
+std::streamsize kis_net_etag_buf::xsputn(const char *s, std::streamsize n) {
+    if (passthrough)
+        return dest->sputn(s, n);
+
+    buffer.append(s, n);
+
+    if (buffer.length() > max_sz) {
+        passthrough = true;
+
+        auto r = dest->sputn(buffer.data(), buffer.length());
+
+        std::string().swap(buffer);
+
+        if (r < 0)
+            return r;
+    }
+
+    return n;
+}
+
+kis_net_etag_buf::int_type kis_net_etag_buf::overflow(int_type ch) {
+    if (traits_type::eq_int_type(ch, traits_type::eof()))
+        return traits_type::not_eof(ch);
+
+    char c = traits_type::to_char_type(ch);
+
+    if (xsputn(&c, 1) != 1)
+        return traits_type::eof();
+
+    return ch;
+}
+
+std::string kis_net_etag_buf::etag() const {
+    // Weak, because the same content may be sent with different encodings
+    return fmt::format("W/\"{:016x}\"", XXH64(buffer.data(), buffer.length(), 0));
+}
+
+bool kis_net_etag_buf::etag_match(const boost::beast::string_view& if_none_match, 
+        const std::string& etag) {
+    // If-None-Match uses the weak comparison, so W/ prefixes are ignored
+    auto opaque = etag.substr(2);
+
+    for (auto t : str_tokenize(static_cast<std::string>(if_none_match), ",")) {
+        t.erase(std::remove(t.begin(), t.end(), ' '), t.end());
+
+        if (t == "*")
+            return true;
+
+        if (t.find("W/") == 0)
+            t = t.substr(2);
+
+        if (t == opaque)
+            return true;
+    }
+
+    return false;
+}
+
 void kis_net_web_tracked_endpoint::handle_request(std::shared_ptr<kis_net_beast_httpd_connection> con) {
     local_demand_locker l(mutex, 
             fmt::format("kis_net_web_tracked_endpoint::handle_request {} {}", con->verb(), con->uri()));
@@ -1569,8 +1926,35 @@ void kis_net_web_tracked_endpoint::handle_request(std::shared_ptr<kis_net_beast_
 
         auto summary = con->summarize_with_json(output_content, rename_map);
 
-        Globalreg::globalreg->entrytracker->serialize(static_cast<std::string>(con->uri()), os, 
-                summary, rename_map);
+        // Responses to GET are collected, up to a limit, so that they can be tagged with 
+        // an ETag; clients which already have the same content get a 304
+        auto etag_max = 
+            Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>()->etag_max_size();
+
+        if (con->verb() == boost::beast::http::verb::get && etag_max > 0) {
+            kis_net_etag_buf ebuf(&con->response_stream(), etag_max);
+            std::ostream eos(&ebuf);
+
+            Globalreg::globalreg->entrytracker->serialize(static_cast<std::string>(con->uri()), eos, 
+                    summary, rename_map);
+
+            eos.flush();
+
+            if (ebuf.buffered()) {
+                auto etag = ebuf.etag();
+                auto inm = con->request().find(boost::beast::http::field::if_none_match);
+
+                con->append_header("ETag", etag);
+
+                if (inm != con->request().end() && kis_net_etag_buf::etag_match(inm->value(), etag))
+                    con->set_status(boost::beast::http::status::not_modified);
+                else
+                    os.write(ebuf.content().data(), ebuf.content().length());
+            }
+        } else {
+            Globalreg::globalreg->entrytracker->serialize(static_cast<std::string>(con->uri()), os, 
+                    summary, rename_map);
+        }
 
         os.flush();
 
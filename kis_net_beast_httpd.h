@@ -38,6 +38,7 @@
 #include "globalregistry.h"
 #include "json/json.h"
 #include "kis_mutex.h"
+#include "kis_thread_pool.h"
 #include "messagebus.h"
 #include "trackedelement.h"
 
@@ -133,14 +134,42 @@ public:
     const bool& allow_cors() { return allow_cors_; }
     const std::string& allowed_cors_referrer() { return allowed_cors_referrer_; }
 
+    // Content-Encoding to use for a request, or an empty string if the response
+    // should not be compressed
+    std::string negotiate_encoding(const boost::beast::http::request<boost::beast::http::string_body>& req);
+    static bool compressible_mime_type(const boost::beast::string_view& type);
+    int compression_level() const { return compression_level_; }
+
+    // Largest tracked response which is collected to generate an ETag
+    size_t etag_max_size() const { return etag_max_sz_; }
+
     bool serve_file(std::shared_ptr<kis_net_beast_httpd_connection> con);
 
     void strip_uri_prefix(boost::beast::string_view& uri_view);
 
+    // Generators for chunked responses run on a shared pool, one per request; work which
+    // a generator waits on must not be posted to it
+    kis_thread_pool& generator_pool() { return *generator_pool_; }
+
 protected:
     std::atomic<bool> running;
     unsigned int port;
 
+    // Requests are served by a bounded pool of threads; idle keep-alive connections 
+    // wait for their next request in the io context, without holding a thread
+    std::unique_ptr<kis_thread_pool> connection_pool_;
+    std::unique_ptr<kis_thread_pool> generator_pool_;
+
+    std::atomic<uint64_t> connections_accepted;
+    std::atomic<uint64_t> connections_open;
+    std::atomic<uint64_t> requests_served;
+
+    int status_id, status_connections_open_id, status_connections_accepted_id,
+        status_requests_id, status_connection_pool_id, status_generator_pool_id,
+        pool_threads_id, pool_busy_id, pool_queued_id, pool_completed_id, pool_released_id;
+
+    std::shared_ptr<tracker_element> pool_status(int id, kis_thread_pool& pool);
+
     kis_recursive_timed_mutex mime_mutex;
     std::unordered_map<std::string, std::string> mime_map;
 
@@ -171,6 +200,10 @@ protected:
     void start_accept();
     void handle_connection(const boost::system::error_code& ec, boost::asio::ip::tcp::socket socket);
 
+    // Wait for the next request on a connection, then serve it on the connection pool
+    void wait_request(std::shared_ptr<boost::beast::tcp_stream> stream);
+    void close_connection(std::shared_ptr<boost::beast::tcp_stream> stream);
+
     bool use_ssl;
     bool serve_files;
 
@@ -179,6 +212,10 @@ protected:
     bool allow_cors_;
     std::string allowed_cors_referrer_;
 
+    bool allow_compression_;
+    int compression_level_;
+    size_t etag_max_sz_;
+
     // Yes, these are stored in ram.  yes, I'm ok with this.
     std::string admin_username, admin_password;
     bool global_login_config;
@@ -225,6 +262,8 @@ public:
     void set_status(boost::beast::http::status status);
     void set_mime_type(const std::string& type);
     void set_target_file(const std::string& type);
+    // Mark the response as a stream which runs until the client closes it; the
+    // generator calling this no longer counts against the generator pool
     void clear_timeout();
     void append_header(const std::string& header, const std::string& value);
 
@@ -279,8 +318,14 @@ protected:
 
     std::atomic<bool> first_response_write;
 
+    // Set when the endpoint clears the timeout for a long-running stream
+    std::atomic<bool> long_running;
+
     bool do_close();
 
+    // Can the response be compressed, based on the request and content type
+    bool compressible_type();
+
     template<class Response>
     void append_common_headers(Response& r, boost::beast::string_view uri) {
         // Append the common headers
@@ -400,6 +445,36 @@ protected:
     function_t function;
 };
 
+// Collects a response so that it can be tagged with an ETag; once the response grows
+// past max_sz it is no longer worth holding, and everything is passed through to the
+// destination as it is written
+class kis_net_etag_buf : public std::streambuf {
+public:
+    kis_net_etag_buf(std::streambuf *dest, size_t max_sz) :
+        dest{dest},
+        max_sz{max_sz},
+        passthrough{false} { }
+
+    // Is the entire response still held?
+    bool buffered() const { return !passthrough; }
+    const std::string& content() const { return buffer; }
+
+    // Weak ETag of the collected content
+    std::string etag() const;
+
+    // Does an If-None-Match header match our ETag?
+    static bool etag_match(const boost::beast::string_view& if_none_match, const std::string& etag);
+
+protected:
+    virtual std::streamsize xsputn(const char *s, std::streamsize n) override;
+    virtual int_type overflow(int_type ch) override;
+
+    std::streambuf *dest;
+    size_t max_sz;
+    bool passthrough;
+    std::string buffer;
+};
+
 class kis_net_web_tracked_endpoint : public kis_net_web_endpoint {
 public:
     using gen_func_t = 
@@ -465,8 +540,11 @@ public:
         return write(buf.data(), text);
     }
 
+    // Writes may come from any thread; beast allows only one write at a time
     template<class ConstBufferSequence>
     int write(const ConstBufferSequence& buffers, bool text) {
+        std::lock_guard<std::mutex> l(write_mutex);
+
         if (!running)
             return -1;
 
@@ -503,6 +581,8 @@ protected:
 
     std::atomic<bool> running;
 
+    std::mutex write_mutex;
+
 };
 
 // Routes map a templated URL path to a callback generator which creates the content.
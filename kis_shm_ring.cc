@@ -0,0 +1,198 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#ifdef SYS_LINUX
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#endif
+
+#include "kis_shm_ring.h"
+#include "messagebus.h"
+#include "util.h"
+
+kis_shm_ring::kis_shm_ring() :
+    shm_fd{-1},
+    event_fd{-1},
+    ring{nullptr},
+    ring_sz{0},
+    num_slots{0},
+    slot_sz{0},
+    stopping{false} { }
+
+kis_shm_ring::~kis_shm_ring() {
+    if (ring != nullptr)
+        munmap(ring, ring_sz);
+
+    if (shm_fd >= 0)
+        close(shm_fd);
+
+    if (event_fd >= 0)
+        close(event_fd);
+}
+
+std::shared_ptr<kis_shm_ring> kis_shm_ring::create(uint32_t num_slots, uint32_t slot_sz) {
+#if defined(SYS_LINUX) && defined(SYS_memfd_create)
+    auto r = std::shared_ptr<kis_shm_ring>(new kis_shm_ring());
+
+    // Slots are kept 8-byte aligned
+    slot_sz = (slot_sz + 7) & ~7;
+
+    if (num_slots == 0 || slot_sz <= sizeof(kis_shm_ring_slot_t))
+        return nullptr;
+
+    r->num_slots = num_slots;
+    r->slot_sz = slot_sz;
+    r->ring_sz = kis_shm_ring_size(num_slots, slot_sz);
+
+    // Created close-on-exec; only the helper we launch is given copies
+    r->shm_fd = syscall(SYS_memfd_create, "kismet-packet-ring", 1U /* MFD_CLOEXEC */);
+
+    if (r->shm_fd < 0) {
+        _MSG_ERROR("Could not create shared memory packet ring: {}", kis_strerror_r(errno));
+        return nullptr;
+    }
+
+    if (ftruncate(r->shm_fd, r->ring_sz) < 0) {
+        _MSG_ERROR("Could not size shared memory packet ring: {}", kis_strerror_r(errno));
+        return nullptr;
+    }
+
+    auto m = mmap(nullptr, r->ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED, r->shm_fd, 0);
+
+    if (m == MAP_FAILED) {
+        _MSG_ERROR("Could not map shared memory packet ring: {}", kis_strerror_r(errno));
+        return nullptr;
+    }
+
+    r->ring = (kis_shm_ring_header_t *) m;
+
+    r->event_fd = eventfd(0, EFD_CLOEXEC);
+
+    if (r->event_fd < 0) {
+        _MSG_ERROR("Could not create shared memory packet ring doorbell: {}", kis_strerror_r(errno));
+        return nullptr;
+    }
+
+    // The file is zero-filled, so every slot starts free
+    r->ring->num_slots = num_slots;
+    r->ring->slot_sz = slot_sz;
+    r->ring->version = KIS_SHM_RING_VERSION;
+    __atomic_store_n(&r->ring->magic, KIS_SHM_RING_MAGIC, __ATOMIC_RELEASE);
+
+    return r;
+#else
+    return nullptr;
+#endif
+}
+
+void kis_shm_ring::start(frame_cb_t cb) {
+    auto t = std::thread(&kis_shm_ring::consumer, this, shared_from_this(), cb);
+    t.detach();
+}
+
+void kis_shm_ring::stop() {
+    stopping = true;
+
+    // Wake the consumer
+    uint64_t v = 1;
+    if (write(event_fd, &v, sizeof(v)) < 0) { }
+}
+
+kis_shm_ring_slot_t *kis_shm_ring::get_slot(uint32_t idx) {
+    return (kis_shm_ring_slot_t *) ((uint8_t *) ring + sizeof(kis_shm_ring_header_t) +
+            (size_t) idx * slot_sz);
+}
+
+uint64_t kis_shm_ring::get_produced() const {
+    return __atomic_load_n(&ring->produced, __ATOMIC_RELAXED);
+}
+
+uint64_t kis_shm_ring::get_fallback() const {
+    return __atomic_load_n(&ring->fallback, __ATOMIC_RELAXED);
+}
+
+void kis_shm_ring::ipc_consumed() {
+    __atomic_add_fetch(&ring->ipc_consumed, 1, __ATOMIC_RELEASE);
+}
+
+bool kis_shm_ring::wait_doorbell() {
+    struct pollfd pfd;
+
+    pfd.fd = event_fd;
+    pfd.events = POLLIN;
+
+    while (!stopping) {
+        // Wake periodically so a missing doorbell can never stall the ring
+        int r = poll(&pfd, 1, 1000);
+
+        if (r < 0 && errno != EINTR)
+            return false;
+
+        if (r > 0) {
+            uint64_t v;
+            if (read(event_fd, &v, sizeof(v)) < 0) { }
+            return !stopping;
+        }
+
+        if (r == 0)
+            return !stopping;
+    }
+
+    return false;
+}
+
+void kis_shm_ring::consumer(std::shared_ptr<kis_shm_ring> ref, frame_cb_t cb) {
+    thread_set_process_name("shm ring");
+
+    uint32_t tail = 0;
+
+    while (!stopping) {
+        auto slot = get_slot(tail);
+
+        if (kis_shm_ring_slot_state(slot) == KIS_SHM_SLOT_READY) {
+            tail = (tail + 1) % num_slots;
+            cb(ref, slot);
+
+            // The frame has been copied out; the helper relies on slots being freed
+            // in order to know when the ring is empty
+            kis_shm_ring_set_slot_state(slot, KIS_SHM_SLOT_FREE);
+            continue;
+        }
+
+        // Announce we're going to sleep, and look once more so a frame published
+        // before the helper saw the flag isn't missed
+        __atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+
+        if (kis_shm_ring_slot_state(slot) != KIS_SHM_SLOT_READY) {
+            if (!wait_doorbell())
+                break;
+        }
+
+        __atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_SEQ_CST);
+    }
+}
+
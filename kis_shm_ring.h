@@ -0,0 +1,95 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_SHM_RING_H__
+#define __KIS_SHM_RING_H__
+
+#include "config.h"
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+
+#include "kis_shm_ring_c.h"
+
+// Server side of the shared-memory packet ring (see kis_shm_ring_c.h).
+//
+// The ring owns the shared memory and doorbell; the helper receives copies of both
+// descriptors via get_shm_fd() and get_event_fd().  A consumer thread hands each
+// ready slot to the frame callback, which must copy out anything it needs; the slot
+// is released back to the helper as soon as the callback returns.  The helper can
+// write the shared memory at any time, so the callback must check the frame length
+// against get_slot_capacity(), and the ring only ever uses the geometry it was
+// created with, never the copy in the shared header.
+//
+// Only available on Linux; create() returns nullptr elsewhere or on failure.
+class kis_shm_ring : public std::enable_shared_from_this<kis_shm_ring> {
+public:
+    using frame_cb_t = std::function<void (std::shared_ptr<kis_shm_ring>, kis_shm_ring_slot_t *)>;
+
+    static std::shared_ptr<kis_shm_ring> create(uint32_t num_slots, uint32_t slot_sz);
+
+    ~kis_shm_ring();
+
+    int get_shm_fd() const { return shm_fd; }
+    int get_event_fd() const { return event_fd; }
+
+    // Start consuming frames.  The callback runs on the ring thread.
+    void start(frame_cb_t cb);
+
+    // Stop consuming; does not wait for the ring thread, which may be in the
+    // callback, and which holds a reference to the ring until it exits.
+    void stop();
+
+    // Record that a data report from the IPC pipe has been handed to the packetchain,
+    // so the helper knows when it may use the ring again
+    void ipc_consumed();
+
+    uint64_t get_produced() const;
+    uint64_t get_fallback() const;
+
+    // Largest frame a slot can hold
+    uint32_t get_slot_capacity() const {
+        return slot_sz - sizeof(kis_shm_ring_slot_t);
+    }
+
+protected:
+    kis_shm_ring();
+
+    kis_shm_ring_slot_t *get_slot(uint32_t idx);
+
+    void consumer(std::shared_ptr<kis_shm_ring> ref, frame_cb_t cb);
+
+    // Wait on the doorbell; returns false if the ring is stopping
+    bool wait_doorbell();
+
+    int shm_fd;
+    int event_fd;
+
+    kis_shm_ring_header_t *ring;
+    size_t ring_sz;
+
+    uint32_t num_slots;
+    uint32_t slot_sz;
+
+    std::atomic<bool> stopping;
+};
+
+#endif
+
@@ -0,0 +1,132 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Shared-memory packet ring between a locally launched capture helper and the
+ * Kismet server.
+ *
+ * The server creates the ring in an anonymous shared memory file and passes the
+ * file descriptor, and an eventfd used as a doorbell, to the helper on the command
+ * line.  The helper copies captured frames directly into ring slots instead of
+ * encoding them as DATAREPORT protobufs over the IPC pipe, and the server builds
+ * packets which reference the slot data in place.
+ *
+ * There is one producer (the helper) and one consumer (the server).  Each slot
+ * carries its own state:
+ *
+ *   FREE   owned by the helper, which may fill it
+ *   READY  filled, owned by the server until it has copied the frame out
+ *
+ * The helper fills slots in order, and the server copies each frame into a packet,
+ * hands it to the packetchain, and frees the slot, also in order.  When the slot
+ * before the helper's next slot is free, the server has taken every frame.
+ *
+ * Frames which can't use the ring (too large for a slot, or carrying records, see
+ * below) are sent as data reports over the IPC pipe, which the server reads on a
+ * different thread.  To keep packets in order, only one path has frames outstanding
+ * at a time:  the helper counts the data reports it sends, and the server counts
+ * the ones it has handled in ipc_consumed.  The helper only fills a slot once the
+ * two match (sending any batch of packets it is holding first), and only sends a packet over the pipe once the ring is empty, waiting
+ * for the server to catch up otherwise.  When the ring is full the helper waits for
+ * a free slot, as it would for room in the IPC buffer, so frames are never dropped
+ * or reordered because of the ring.
+ *
+ * Before sleeping on the doorbell, the server sets consumer_waiting and checks the
+ * next slot again; after publishing a slot the helper rings the doorbell if the
+ * server is waiting.
+ *
+ * Only frames with no message, signal, or GPS records attached use the ring;
+ * those are carried in the DATAREPORT as usual.
+ */
+
+#ifndef __KIS_SHM_RING_C_H__
+#define __KIS_SHM_RING_C_H__
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define KIS_SHM_RING_MAGIC      0x4B53484D
+#define KIS_SHM_RING_VERSION    2
+
+#define KIS_SHM_SLOT_FREE       0
+#define KIS_SHM_SLOT_READY      1
+
+/* Defaults used by the server */
+#define KIS_SHM_RING_SLOTS      1024
+#define KIS_SHM_RING_SLOT_SZ    8192
+
+struct kis_shm_ring_header {
+    uint32_t magic;
+    uint32_t version;
+
+    uint32_t num_slots;
+    /* Size of each slot, including the slot header */
+    uint32_t slot_sz;
+
+    /* Set by the server before waiting on the doorbell */
+    uint32_t consumer_waiting;
+    uint32_t reserved0;
+
+    /* Frames sent through the ring and frames which fell back to the pipe,
+     * maintained by the helper */
+    uint64_t produced;
+    uint64_t fallback;
+
+    /* Data reports received over the IPC pipe and handed to the packetchain,
+     * maintained by the server */
+    uint64_t ipc_consumed;
+
+    uint8_t reserved1[16];
+};
+typedef struct kis_shm_ring_header kis_shm_ring_header_t;
+
+struct kis_shm_ring_slot {
+    uint32_t state;
+    uint32_t dlt;
+    uint64_t ts_sec;
+    uint32_t ts_usec;
+    uint32_t caplen;
+    uint8_t data[];
+};
+typedef struct kis_shm_ring_slot kis_shm_ring_slot_t;
+
+static inline size_t kis_shm_ring_size(uint32_t num_slots, uint32_t slot_sz) {
+    return sizeof(kis_shm_ring_header_t) + (size_t) num_slots * slot_sz;
+}
+
+static inline kis_shm_ring_slot_t *kis_shm_ring_slot(kis_shm_ring_header_t *ring,
+        uint32_t slot) {
+    return (kis_shm_ring_slot_t *) ((uint8_t *) ring + sizeof(kis_shm_ring_header_t) +
+            (size_t) slot * ring->slot_sz);
+}
+
+static inline uint32_t kis_shm_ring_slot_capacity(kis_shm_ring_header_t *ring) {
+    return ring->slot_sz - sizeof(kis_shm_ring_slot_t);
+}
+
+static inline uint32_t kis_shm_ring_slot_state(kis_shm_ring_slot_t *slot) {
+    return __atomic_load_n(&slot->state, __ATOMIC_ACQUIRE);
+}
+
+static inline void kis_shm_ring_set_slot_state(kis_shm_ring_slot_t *slot, uint32_t state) {
+    __atomic_store_n(&slot->state, state, __ATOMIC_RELEASE);
+}
+
+#endif
+
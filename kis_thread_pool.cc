@@ -0,0 +1,168 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#include "config.h"
+
+#include <chrono>
+#include <thread>
+
+#include "kis_thread_pool.h"
+#include "messagebus.h"
+#include "util.h"
+
+thread_local std::shared_ptr<kis_thread_pool::pool_state> kis_thread_pool::current_pool;
+thread_local bool kis_thread_pool::current_released = false;
+
+kis_thread_pool::kis_thread_pool(const std::string& name, size_t max_threads, size_t max_idle) :
+    state{std::make_shared<pool_state>()} {
+
+    state->name = name;
+    state->max_threads = max_threads;
+    state->max_idle = max_idle;
+    state->stopping = false;
+    state->threads = 0;
+    state->idle = 0;
+    state->completed = 0;
+    state->released = 0;
+}
+
+kis_thread_pool::~kis_thread_pool() {
+    // Pending tasks are discarded outside of the lock, since they may hold references
+    // which do more work as they are released
+    std::deque<std::function<void ()>> discard;
+
+    {
+        std::lock_guard<std::mutex> l(state->mutex);
+        state->stopping = true;
+        discard.swap(state->queue);
+    }
+
+    state->cv.notify_all();
+}
+
+void kis_thread_pool::post(std::function<void ()> task) {
+    {
+        std::lock_guard<std::mutex> l(state->mutex);
+
+        if (state->stopping)
+            return;
+
+        state->queue.push_back(task);
+
+        if (state->idle < state->queue.size() &&
+                (state->max_threads == 0 || state->threads < state->max_threads))
+            spawn(state);
+    }
+
+    state->cv.notify_one();
+}
+
+void kis_thread_pool::release_current() {
+    if (current_pool == nullptr || current_released)
+        return;
+
+    auto st = current_pool;
+
+    std::lock_guard<std::mutex> l(st->mutex);
+
+    current_released = true;
+    st->threads--;
+    st->released++;
+
+    // Replace ourselves if there is work waiting
+    if (!st->stopping && st->idle < st->queue.size() && 
+            (st->max_threads == 0 || st->threads < st->max_threads))
+        spawn(st);
+}
+
+kis_thread_pool::pool_stats kis_thread_pool::get_stats() {
+    std::lock_guard<std::mutex> l(state->mutex);
+
+    pool_stats ret;
+
+    ret.threads = state->threads;
+    ret.busy = state->threads - state->idle;
+    ret.queued = state->queue.size();
+    ret.completed = state->completed;
+    ret.released = state->released;
+
+    return ret;
+}
+
+void kis_thread_pool::spawn(std::shared_ptr<pool_state> st) {
+    st->threads++;
+
+    auto t = std::thread(&kis_thread_pool::worker, st);
+    t.detach();
+}
+
+void kis_thread_pool::worker(std::shared_ptr<pool_state> st) {
+    thread_set_process_name(st->name);
+
+    current_pool = st;
+    current_released = false;
+
+    std::unique_lock<std::mutex> l(st->mutex);
+
+    while (true) {
+        st->idle++;
+
+        auto ready = st->cv.wait_for(l, std::chrono::seconds(30), 
+                [&st]() { return st->stopping || st->queue.size() > 0; });
+
+        st->idle--;
+
+        if (st->stopping)
+            break;
+
+        if (!ready) {
+            if (st->threads > st->max_idle)
+                break;
+            continue;
+        }
+
+        auto task = std::move(st->queue.front());
+        st->queue.pop_front();
+
+        l.unlock();
+
+        try {
+            task();
+        } catch (const std::exception& e) {
+            _MSG_ERROR("Unhandled error in {} worker: {}", st->name, e.what());
+        }
+
+        // Release anything the task captured before we go idle
+        task = nullptr;
+
+        l.lock();
+
+        st->completed++;
+
+        // A released thread has already left the pool
+        if (current_released)
+            break;
+    }
+
+    if (!current_released)
+        st->threads--;
+
+    l.unlock();
+
+    current_pool.reset();
+}
@@ -0,0 +1,95 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KIS_THREAD_POOL_H__
+#define __KIS_THREAD_POOL_H__
+
+#include "config.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+// Pool of worker threads for blocking tasks, such as serving http requests.
+//
+// Threads are started as tasks arrive, up to max_threads (0 for no limit), and are
+// re-used for later tasks; once the limit is reached, tasks wait in order for a 
+// thread.  Threads which have been idle for a while exit, down to max_idle.
+//
+// Tasks which will run for a long time (streams, websockets) should call
+// release_current(); their thread then no longer counts against the limit, and
+// exits when the task completes.
+//
+// Worker threads are detached and hold their own reference to the pool state, so
+// destroying the pool does not wait for running tasks.
+class kis_thread_pool {
+public:
+    kis_thread_pool(const std::string& name, size_t max_threads, size_t max_idle);
+    ~kis_thread_pool();
+
+    kis_thread_pool(const kis_thread_pool&) = delete;
+    kis_thread_pool& operator=(const kis_thread_pool&) = delete;
+
+    void post(std::function<void ()> task);
+
+    // Release the calling thread from the pool it is working for, if any
+    static void release_current();
+
+    struct pool_stats {
+        size_t threads;
+        size_t busy;
+        size_t queued;
+        uint64_t completed;
+        uint64_t released;
+    };
+
+    pool_stats get_stats();
+
+protected:
+    struct pool_state {
+        std::string name;
+        size_t max_threads;
+        size_t max_idle;
+
+        std::mutex mutex;
+        std::condition_variable cv;
+        std::deque<std::function<void ()>> queue;
+        bool stopping;
+
+        size_t threads;
+        size_t idle;
+        uint64_t completed;
+        uint64_t released;
+    };
+
+    std::shared_ptr<pool_state> state;
+
+    // Start a thread; the state mutex must be held
+    static void spawn(std::shared_ptr<pool_state> st);
+    static void worker(std::shared_ptr<pool_state> st);
+
+    static thread_local std::shared_ptr<pool_state> current_pool;
+    static thread_local bool current_released;
+};
+
+#endif
+
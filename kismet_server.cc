@@ -115,6 +115,7 @@
 #include "manuf.h"
 #include "entrytracker.h"
 #include "json_adapter.h"
+#include "columnar_adapter.h"
 
 #include "kis_server_announce.h"
 
@@ -760,6 +761,7 @@ int main(int argc, char *argv[], char *envp[]) {
     entrytracker->register_serializer("itjson", std::make_shared<it_json_adapter::serializer>());
     entrytracker->register_serializer("prettyjson", std::make_shared<pretty_json_adapter::serializer>());
     entrytracker->register_serializer("storagejson", std::make_shared<storage_json_adapter::serializer>());
+    entrytracker->register_serializer("kcol", std::make_shared<columnar_adapter::serializer>());
 
     entrytracker->register_serializer("jcmd", std::make_shared<json_adapter::serializer>());
     entrytracker->register_serializer("cmd", std::make_shared<json_adapter::serializer>());
@@ -0,0 +1,269 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+/* Compressed blobs in kismetdb logs, shared by the server, the log tools, and
+ * the kismetdb capture source.
+ *
+ * Starting with kismetdb version 7, the packets and devices tables carry a
+ * 'compression' column.  When it is KISMETDB_COMP_ZLIB, the packet or device
+ * blob is:
+ *
+ *   uint32_t dict_id    (little endian) dictionary id, or 0 for none
+ *   uint32_t length     (little endian) uncompressed length
+ *   ...                 raw deflate stream
+ *
+ * Dictionaries are stored in the compression_dicts table by id, and are built by
+ * the server from the first records of each packet DLT and device phy; they are
+ * used as zlib preset dictionaries.
+ *
+ * Streams are re-used between records; init them once, and end them when done.
+ */
+
+#ifndef __KISMETDB_COMPRESS_H__
+#define __KISMETDB_COMPRESS_H__
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sqlite3.h>
+#include <zlib.h>
+
+#define KISMETDB_COMP_NONE      0
+#define KISMETDB_COMP_ZLIB      1
+
+#define KISMETDB_COMP_HDR_SZ    8
+
+/* zlib only uses the last 32k of a preset dictionary */
+#define KISMETDB_DICT_MAX       32768
+
+static inline uint32_t kismetdb_comp_get32(const uint8_t *p) {
+    return (uint32_t) p[0] | ((uint32_t) p[1] << 8) |
+        ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static inline void kismetdb_comp_put32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+/* Read the header of a compressed blob; returns -1 if the blob is too short */
+static inline int kismetdb_comp_header(const uint8_t *blob, size_t blob_len,
+        uint32_t *dict_id, uint32_t *length) {
+    if (blob_len < KISMETDB_COMP_HDR_SZ)
+        return -1;
+
+    *dict_id = kismetdb_comp_get32(blob);
+    *length = kismetdb_comp_get32(blob + 4);
+
+    return 0;
+}
+
+/* Largest compressed blob for a record */
+static inline size_t kismetdb_comp_bound(size_t in_len) {
+    return KISMETDB_COMP_HDR_SZ + compressBound(in_len);
+}
+
+static inline int kismetdb_deflate_init(z_stream *zs, int level) {
+    memset(zs, 0, sizeof(z_stream));
+    return deflateInit2(zs, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) == Z_OK ? 0 : -1;
+}
+
+static inline int kismetdb_inflate_init(z_stream *zs) {
+    memset(zs, 0, sizeof(z_stream));
+    return inflateInit2(zs, -15) == Z_OK ? 0 : -1;
+}
+
+/* Compress a record into out, which must hold kismetdb_comp_bound(in_len); returns
+ * the size of the blob, or -1 on error */
+static inline long kismetdb_compress(z_stream *zs, const uint8_t *in, size_t in_len,
+        uint32_t dict_id, const uint8_t *dict, size_t dict_len,
+        uint8_t *out, size_t out_sz) {
+    if (out_sz < KISMETDB_COMP_HDR_SZ || in_len > UINT32_MAX)
+        return -1;
+
+    if (deflateReset(zs) != Z_OK)
+        return -1;
+
+    if (dict != NULL && dict_len > 0 &&
+            deflateSetDictionary(zs, dict, dict_len) != Z_OK)
+        return -1;
+
+    kismetdb_comp_put32(out, dict_id);
+    kismetdb_comp_put32(out + 4, in_len);
+
+    zs->next_in = (Bytef *) in;
+    zs->avail_in = in_len;
+    zs->next_out = out + KISMETDB_COMP_HDR_SZ;
+    zs->avail_out = out_sz - KISMETDB_COMP_HDR_SZ;
+
+    if (deflate(zs, Z_FINISH) != Z_STREAM_END)
+        return -1;
+
+    return (long) (out_sz - zs->avail_out);
+}
+
+/* Decompress a blob into out, which must hold the length from the header; the
+ * dictionary must be the one named in the header.  Returns the uncompressed length,
+ * or -1 on error */
+static inline long kismetdb_decompress(z_stream *zs, const uint8_t *blob, size_t blob_len,
+        const uint8_t *dict, size_t dict_len, uint8_t *out, size_t out_sz) {
+    uint32_t dict_id, length;
+    int r;
+
+    if (kismetdb_comp_header(blob, blob_len, &dict_id, &length) < 0)
+        return -1;
+
+    if (length > out_sz)
+        return -1;
+
+    if (length == 0)
+        return 0;
+
+    if (inflateReset(zs) != Z_OK)
+        return -1;
+
+    if (dict_id != 0) {
+        if (dict == NULL || inflateSetDictionary(zs, dict, dict_len) != Z_OK)
+            return -1;
+    }
+
+    zs->next_in = (Bytef *) blob + KISMETDB_COMP_HDR_SZ;
+    zs->avail_in = blob_len - KISMETDB_COMP_HDR_SZ;
+    zs->next_out = out;
+    zs->avail_out = length;
+
+    r = inflate(zs, Z_FINISH);
+
+    if (r != Z_STREAM_END || zs->avail_out != 0)
+        return -1;
+
+    return (long) length;
+}
+
+/* Fetch a dictionary by id into a buffer of KISMETDB_DICT_MAX; returns the length of
+ * the dictionary or -1 if it could not be found */
+static inline long kismetdb_fetch_dict(sqlite3 *db, uint32_t dict_id, uint8_t *dict) {
+    const char *sql = "SELECT dict FROM compression_dicts WHERE id = ?";
+    sqlite3_stmt *stmt = NULL;
+    long len = -1;
+    int blen;
+
+    if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK)
+        return -1;
+
+    sqlite3_bind_int64(stmt, 1, dict_id);
+
+    if (sqlite3_step(stmt) == SQLITE_ROW) {
+        blen = sqlite3_column_bytes(stmt, 0);
+
+        if (blen >= 0 && blen <= KISMETDB_DICT_MAX) {
+            if (blen > 0)
+                memcpy(dict, sqlite3_column_blob(stmt, 0), blen);
+            len = blen;
+        }
+    }
+
+    sqlite3_finalize(stmt);
+
+    return len;
+}
+
+#ifdef __cplusplus
+
+#include <map>
+#include <stdexcept>
+#include <string>
+
+/* Expands compressed blobs for the log tools, caching dictionaries as they are
+ * needed */
+class kismetdb_decompressor {
+public:
+    kismetdb_decompressor(sqlite3 *db) :
+        db{db} {
+        if (kismetdb_inflate_init(&zs) < 0)
+            throw std::runtime_error("unable to initialize zlib");
+    }
+
+    ~kismetdb_decompressor() {
+        inflateEnd(&zs);
+    }
+
+    kismetdb_decompressor(const kismetdb_decompressor&) = delete;
+    kismetdb_decompressor& operator=(const kismetdb_decompressor&) = delete;
+
+    // Return the original content of a blob stored with the given compression
+    std::string expand(const std::string& blob, int compression) {
+        if (compression == KISMETDB_COMP_NONE || blob.length() == 0)
+            return blob;
+
+        if (compression != KISMETDB_COMP_ZLIB)
+            throw std::runtime_error("unknown kismetdb compression type " +
+                    std::to_string(compression));
+
+        uint32_t dict_id, length;
+
+        if (kismetdb_comp_header((const uint8_t *) blob.data(), blob.length(),
+                    &dict_id, &length) < 0)
+            throw std::runtime_error("truncated compressed kismetdb record");
+
+        const std::string *dict = nullptr;
+
+        if (dict_id != 0) {
+            auto di = dicts.find(dict_id);
+
+            if (di == dicts.end()) {
+                std::string d(KISMETDB_DICT_MAX, '\0');
+                auto dlen = kismetdb_fetch_dict(db, dict_id, (uint8_t *) &d[0]);
+
+                if (dlen < 0)
+                    throw std::runtime_error("missing kismetdb compression dictionary " +
+                            std::to_string(dict_id));
+
+                d.resize(dlen);
+                di = dicts.emplace(dict_id, d).first;
+            }
+
+            dict = &di->second;
+        }
+
+        std::string ret(length, '\0');
+
+        if (kismetdb_decompress(&zs, (const uint8_t *) blob.data(), blob.length(),
+                    dict == nullptr ? nullptr : (const uint8_t *) dict->data(),
+                    dict == nullptr ? 0 : dict->length(),
+                    (uint8_t *) &ret[0], ret.length()) < 0)
+            throw std::runtime_error("corrupt compressed kismetdb record");
+
+        return ret;
+    }
+
+protected:
+    sqlite3 *db;
+    z_stream zs;
+    std::map<uint32_t, std::string> dicts;
+};
+
+#endif
+
+#endif
+
@@ -0,0 +1,164 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __KISMETDB_DELTA_H__
+#define __KISMETDB_DELTA_H__
+
+#include "config.h"
+
+#include <stdint.h>
+
+#include <map>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "json/json.h"
+
+// Device deltas in kismetdb logs, shared by the server and the log tools.
+//
+// Starting with kismetdb version 8, the server can log only the fields of a device
+// which changed since it was last logged.  Full device records are still written to
+// the devices table at each checkpoint; between checkpoints, changes are appended to
+// the device_deltas table, and the deltas for a device are removed when the next
+// checkpoint for it is written.  The current state of a device is the devices record
+// with each of its device_deltas applied in rowid order.
+//
+// A delta blob is a sequence of unsigned LEB128 varints and bytes:
+//
+//   count                   number of changes
+//   per change:
+//     path_len              number of fields in the path
+//     field ids             ids of each field, named in the delta_fields table
+//     value_len + 1         0 if the field was removed
+//     value                 JSON value of the field
+
+namespace kismetdb_delta {
+
+inline void put_varint(std::string& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((char) ((v & 0x7F) | 0x80));
+        v >>= 7;
+    }
+
+    out.push_back((char) v);
+}
+
+inline uint64_t get_varint(const std::string& in, size_t& pos) {
+    uint64_t v = 0;
+    unsigned int shift = 0;
+
+    while (pos < in.length() && shift < 64) {
+        uint8_t b = in[pos++];
+
+        v |= (uint64_t) (b & 0x7F) << shift;
+
+        if ((b & 0x80) == 0)
+            return v;
+
+        shift += 7;
+    }
+
+    throw std::runtime_error("truncated kismetdb device delta");
+}
+
+struct change {
+    std::vector<uint64_t> path;
+    std::string value;
+    bool removed;
+};
+
+inline std::vector<change> decode(const std::string& blob) {
+    std::vector<change> ret;
+    size_t pos = 0;
+
+    auto count = get_varint(blob, pos);
+
+    for (uint64_t c = 0; c < count; c++) {
+        change ch;
+
+        auto path_len = get_varint(blob, pos);
+
+        for (uint64_t p = 0; p < path_len; p++)
+            ch.path.push_back(get_varint(blob, pos));
+
+        auto vlen = get_varint(blob, pos);
+
+        ch.removed = (vlen == 0);
+
+        if (vlen > 0) {
+            vlen--;
+
+            if (vlen > blob.length() - pos)
+                throw std::runtime_error("truncated kismetdb device delta");
+
+            ch.value = blob.substr(pos, vlen);
+            pos += vlen;
+        }
+
+        ret.push_back(ch);
+    }
+
+    return ret;
+}
+
+// Apply a delta blob to a device record, naming fields from the delta_fields table
+inline void apply(Json::Value& device, const std::string& blob,
+        const std::map<uint64_t, std::string>& field_names) {
+    for (const auto& ch : decode(blob)) {
+        if (ch.path.size() == 0)
+            continue;
+
+        Json::Value *node = &device;
+        std::string key;
+
+        for (size_t p = 0; p < ch.path.size(); p++) {
+            auto ni = field_names.find(ch.path[p]);
+
+            if (ni == field_names.end())
+                throw std::runtime_error("unknown field in kismetdb device delta");
+
+            key = ni->second;
+
+            if (p == ch.path.size() - 1)
+                break;
+
+            if (!(*node)[key].isObject())
+                (*node)[key] = Json::Value(Json::objectValue);
+
+            node = &(*node)[key];
+        }
+
+        if (ch.removed) {
+            node->removeMember(key);
+            continue;
+        }
+
+        Json::Value v;
+        std::stringstream ss(ch.value);
+        ss >> v;
+
+        (*node)[key] = v;
+    }
+}
+
+}
+
+#endif
+
@@ -38,6 +38,8 @@
 
 #include "fmt.h"
 #include "json/json.h"
+#include "kismetdb_compress.h"
+#include "kismetdb_delta.h"
 #include "sqlite3_cpp11.h"
 
 void print_help(char *argv) {
@@ -246,7 +248,27 @@ int main(int argc, char *argv[]) {
     if (!ekjson)
         fprintf(ofile, "[\n");
 
-    auto query = _SELECT(db, "devices", {"device"});
+    std::list<std::string> device_fields{"device"};
+
+    if (db_version >= 7)
+        device_fields.push_back("compression");
+
+    // Apply any changes logged since each device was last logged in full
+    std::map<uint64_t, std::string> delta_field_names;
+
+    if (db_version >= 8) {
+        device_fields.push_back("devkey");
+
+        auto fields_q = _SELECT(db, "delta_fields", {"id", "name"});
+
+        for (auto f : fields_q)
+            delta_field_names[sqlite3_column_as<uint64_t>(f, 0)] = 
+                sqlite3_column_as<std::string>(f, 1);
+    }
+
+    auto query = _SELECT(db, "devices", device_fields);
+
+    kismetdb_decompressor decompressor(db);
 
     unsigned long n_logs = 0;
     unsigned long n_division = (n_devices_db / 20);
@@ -266,15 +288,26 @@ int main(int argc, char *argv[]) {
 
         }
 
-        auto json = sqlite3_column_as<std::string>(d, 0);
-
         try {
+            auto json = decompressor.expand(sqlite3_column_as<std::string>(d, 0),
+                    db_version >= 7 ? sqlite3_column_as<int>(d, 1) : KISMETDB_COMP_NONE);
+
             std::stringstream ss(json);
 
             Json::Value parsed_json;
 
             ss >> parsed_json;
 
+            if (db_version >= 8) {
+                auto deltas_q = _SELECT(db, "device_deltas", {"delta"},
+                        _WHERE("devkey", EQ, sqlite3_column_as<std::string>(d, 2)),
+                        ORDERBY, "rowid");
+
+                for (auto dd : deltas_q)
+                    kismetdb_delta::apply(parsed_json, sqlite3_column_as<std::string>(dd, 0),
+                            delta_field_names);
+            }
+
             if (reformat)
                 transform_json(parsed_json);
 
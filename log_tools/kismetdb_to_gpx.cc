@@ -41,6 +41,7 @@
 
 #include "getopt.h"
 #include "json/json.h"
+#include "kismetdb_compress.h"
 #include "sqlite3_cpp11.h"
 #include "fmt.h"
 #include "packet_ieee80211.h"
@@ -420,10 +421,17 @@ int main(int argc, char *argv[]) {
 
     std::vector<gpx_waypoint> waypoint_vec;
 
+    kismetdb_decompressor decompressor(db);
+
     if (basiclocation) {
+        std::list<std::string> device_fields{"min_lat", "min_lon", "max_lat", "max_lon", 
+            "avg_lat", "avg_lon", "device"};
+
+        if (db_version >= 7)
+            device_fields.push_back("compression");
+
         auto basic_q = 
-            _SELECT(db, "devices", 
-                    {"min_lat", "min_lon", "max_lat", "max_lon", "avg_lat", "avg_lon", "device"}, 
+            _SELECT(db, "devices", device_fields,
                     _WHERE("avglat", NEQ, 0, AND, "avglon", NEQ, 0));
 
         for (auto d : basic_q) {
@@ -452,9 +460,11 @@ int main(int argc, char *argv[]) {
             }
 
             Json::Value json;
-            std::stringstream ss(sqlite3_column_as<std::string>(d, 6));
 
             try {
+                std::stringstream ss(decompressor.expand(sqlite3_column_as<std::string>(d, 6),
+                            db_version >= 7 ? sqlite3_column_as<int>(d, 7) : KISMETDB_COMP_NONE));
+
                 ss >> json;
 
                 if (avg_lat == 0 || avg_lon == 0)
@@ -475,8 +485,13 @@ int main(int argc, char *argv[]) {
 
         }
     } else {
+        std::list<std::string> device_fields{"phyname", "devmac", "device"};
+
+        if (db_version >= 7)
+            device_fields.push_back("compression");
+
         auto basic_q = 
-            _SELECT(db, "devices", {"phyname", "devmac", "device"});
+            _SELECT(db, "devices", device_fields);
 
         for (auto d : basic_q) {
             // Prep the packet list for different kismetdb versions
@@ -492,11 +507,12 @@ int main(int argc, char *argv[]) {
             auto devmac = sqlite3_column_as<std::string>(d, 1);
             Json::Value json;
 
-            std::stringstream ss(sqlite3_column_as<std::string>(d, 2));
-
             gpx_waypoint pl;
 
             try {
+                std::stringstream ss(decompressor.expand(sqlite3_column_as<std::string>(d, 2),
+                            db_version >= 7 ? sqlite3_column_as<int>(d, 3) : KISMETDB_COMP_NONE));
+
                 ss >> json;
                 pl.name = json["kismet.device.base.commonname"].asString();
             } catch (const std::exception& e) {
@@ -43,6 +43,7 @@
 #include "fmt.h"
 #include "getopt.h"
 #include "json/json.h"
+#include "kismetdb_compress.h"
 #include "packet_ieee80211.h"
 #include "pcapng.h"
 #include "sqlite3_cpp11.h"
@@ -736,9 +737,14 @@ int main(int argc, char *argv[]) {
         packet_filter_q = _WHERE(packet_filter_q, AND, uuid_clause);
     }
 
-    auto packets_q = _SELECT(db, "packets", 
-            {"ts_sec", "ts_usec", "dlt", "datasource", "packet", "tags"},
-            packet_filter_q);
+    std::list<std::string> packet_fields{"ts_sec", "ts_usec", "dlt", "datasource", "packet", "tags"};
+
+    if (db_version >= 7)
+        packet_fields.push_back("compression");
+
+    auto packets_q = _SELECT(db, "packets", packet_fields, packet_filter_q);
+
+    kismetdb_decompressor decompressor(db);
 
     try {
         for (auto pkt : packets_q) {
@@ -746,7 +752,8 @@ int main(int argc, char *argv[]) {
             auto ts_usec = sqlite3_column_as<unsigned long>(pkt, 1);
             auto pkt_dlt = sqlite3_column_as<unsigned int>(pkt, 2);
             auto datasource = sqlite3_column_as<std::string>(pkt, 3);
-            auto bytes = sqlite3_column_as<std::string>(pkt, 4);
+            auto bytes = decompressor.expand(sqlite3_column_as<std::string>(pkt, 4),
+                    db_version >= 7 ? sqlite3_column_as<int>(pkt, 6) : KISMETDB_COMP_NONE);
             auto tags = sqlite3_column_as<std::string>(pkt, 5);
 
             if (!pcapng) {
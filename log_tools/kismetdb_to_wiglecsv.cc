@@ -42,6 +42,7 @@
 
 #include "getopt.h"
 #include "json/json.h"
+#include "kismetdb_compress.h"
 #include "sqlite3_cpp11.h"
 #include "fmt.h"
 #include "packet_ieee80211.h"
@@ -406,6 +407,13 @@ int main(int argc, char *argv[]) {
         packet_fields = std::list<std::string>{"ts_sec", "sourcemac", "phyname", "lat", "lon", "signal", "frequency", "alt", "speed"};
     }
 
+    std::list<std::string> device_fields{"device"};
+
+    if (db_version >= 7)
+        device_fields.push_back("compression");
+
+    kismetdb_decompressor decompressor(db);
+
     auto query = _SELECT(db, "packets", packet_fields,
             _WHERE("sourcemac", NEQ, "00:00:00:00:00:00", 
                 AND, 
@@ -471,7 +479,7 @@ int main(int argc, char *argv[]) {
         if (ci != device_cache_map.end()) {
             cached = ci->second;
         } else {
-            auto dev_query = _SELECT(db, "devices", {"device"},
+            auto dev_query = _SELECT(db, "devices", device_fields,
                     _WHERE("devmac", EQ, sourcemac,
                         AND,
                         "phyname", EQ, phy));
@@ -498,9 +506,11 @@ int main(int argc, char *argv[]) {
             }
 
             Json::Value json;
-            std::stringstream ss(sqlite3_column_as<std::string>(*dev, 0));
 
             try {
+                std::stringstream ss(decompressor.expand(sqlite3_column_as<std::string>(*dev, 0),
+                            db_version >= 7 ? sqlite3_column_as<int>(*dev, 1) : KISMETDB_COMP_NONE));
+
                 ss >> json;
 
                 auto timestamp = json["kismet.device.base.first_time"].asUInt64();
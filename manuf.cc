@@ -19,13 +19,17 @@
 #include "config.h"
 
 #include <stdio.h>
+
+#include <algorithm>
+
 #include "configfile.h"
 #include "entrytracker.h"
 #include "messagebus.h"
 #include "util.h"
 #include "manuf.h"
 
-kis_manuf::kis_manuf() {
+kis_manuf::kis_manuf() :
+    zmfile{nullptr} {
     auto entrytracker = Globalreg::fetch_mandatory_global_as<entry_tracker>();
 
     manuf_id = 
@@ -78,18 +82,40 @@ kis_manuf::kis_manuf() {
         return;
     }
 
+    // Files which don't exist are only worth mentioning if nothing else opens; the
+    // prebuilt table is listed first but is only installed when python is available
+    std::vector<std::string> missing;
+
     for (auto f : fname) {
         auto expanded = Globalreg::globalreg->kismet_config->expand_log_path(f, "", "", 0, 1);
 
+        // Prebuilt tables are searched in place and need no indexing
+        if (kis_lookup_db::is_lookup_db(expanded)) {
+            if (oui_db.open(expanded, "OUI", 1)) {
+                _MSG_INFO("Opened OUI table '{}', {} records", expanded, oui_db.size());
+                return;
+            }
+
+            continue;
+        }
+
         if ((zmfile = gzopen(expanded.c_str(), "r")) != nullptr) {
             _MSG("Opened OUI file '" + expanded, MSGFLAG_INFO);
             break;
         }
 
+        if (errno == ENOENT) {
+            missing.push_back(expanded);
+            continue;
+        }
+
         _MSG("Could not open OUI file '" + expanded + "': " + std::string(strerror(errno)), MSGFLAG_INFO);
     }
 
     if (zmfile == nullptr) {
+        for (const auto& m : missing)
+            _MSG("Could not open OUI file '" + m + "': " + std::string(strerror(ENOENT)), MSGFLAG_INFO);
+
         _MSG("No OUI files were available, will not resolve manufacturer "
              "names for MAC addresses", MSGFLAG_ERROR);
         return;
@@ -160,93 +186,7 @@ void kis_manuf::IndexOUI() {
 }
 
 std::shared_ptr<tracker_element_string> kis_manuf::lookup_oui(mac_addr in_mac) {
-    uint32_t soui = in_mac.OUI(), toui;
-    int matched = -1;
-    char buf[1024];
-    short int m[3];
-
-    if (zmfile == nullptr)
-        return unknown_manuf;
-
-    {
-        local_shared_locker sl(&mutex);
-
-        // Use the cache first
-        if (oui_map.find(soui) != oui_map.end()) {
-            return oui_map[soui].manuf;
-        }
-
-        for (unsigned int x = 0; x < index_vec.size(); x++) {
-            if (soui > index_vec[x].oui) {
-                matched = x;
-                continue;
-            }
-
-            break;
-        }
-
-        // Cache unknown to save us effort in the future
-        if (matched < 0) {
-            manuf_data md;
-            md.oui = soui;
-            md.manuf = unknown_manuf;
-            oui_map[soui] = md;
-
-            return md.manuf;
-        }
-
-        // Jump backwards one index in the matching unless we're in the first block
-        if (matched > 0)
-            matched -= 1;
-    }
-
-    {
-        local_locker l(&mutex);
-
-        gzseek(zmfile, index_vec[matched].pos, SEEK_SET);
-
-        while (!gzeof(zmfile)) {
-            if (gzgets(zmfile, buf, 1024) == nullptr || gzeof(zmfile))
-                break;
-
-            if (strlen(buf) < 10)
-                continue;
-
-            // Trim \n
-            auto mlen = strlen(buf + 9) - 1;
-
-            if (mlen == 0)
-                continue;
-
-
-            if (sscanf(buf, "%hx:%hx:%hx\t", &(m[0]), &(m[1]), &(m[2])) == 3) {
-
-                // Log a position at the previous pos - which is the line before
-                // this one, so we're inclusive
-                toui = mac_addr::OUI(m);
-
-                if (toui == soui) {
-                    manuf_data md;
-                    md.oui = soui;
-
-                    md.manuf = std::make_shared<tracker_element_string>(manuf_id);
-                    md.manuf->set(munge_to_printable(std::string(buf + 9, mlen)));
-                    oui_map[soui] = md;
-                    return md.manuf;
-                }
-
-                if (toui > soui) {
-                    manuf_data md;
-                    md.oui = soui;
-                    md.manuf = unknown_manuf;
-                    oui_map[soui] = md;
-                    return md.manuf;
-                }
-            }
-        }
-    }
-
-    return unknown_manuf;
+    return lookup_oui(in_mac.OUI());
 }
 
 std::shared_ptr<tracker_element_string> kis_manuf::lookup_oui(uint32_t in_oui) {
@@ -255,83 +195,91 @@ std::shared_ptr<tracker_element_string> kis_manuf::lookup_oui(uint32_t in_oui) {
     char buf[1024];
     short int m[3];
 
-    if (zmfile == nullptr)
+    if (zmfile == nullptr && !oui_db.is_open())
         return unknown_manuf;
 
     {
         local_shared_locker sl(&mutex);
 
         // Use the cache first
-        if (oui_map.find(soui) != oui_map.end()) {
-            return oui_map[soui].manuf;
-        }
+        auto cached = oui_map.find(soui);
+        if (cached != oui_map.end())
+            return cached->second.manuf;
+    }
 
-        for (unsigned int x = 0; x < index_vec.size(); x++) {
-            if (soui > index_vec[x].oui) {
-                matched = x;
-                continue;
-            }
+    // The prebuilt table is read-only and needs no locking to search
+    if (oui_db.is_open()) {
+        manuf_data md;
+        md.oui = soui;
 
-            break;
-        }
+        auto rec = oui_db.find(soui);
 
-        // Cache unknown to save us effort in the future
-        if (matched < 0) {
-            manuf_data md;
-            md.oui = soui;
+        if (rec == nullptr) {
             md.manuf = unknown_manuf;
-            oui_map[soui] = md;
-
-            return md.manuf;
+        } else {
+            md.manuf = std::make_shared<tracker_element_string>(manuf_id);
+            md.manuf->set(munge_to_printable(oui_db.field(rec, 0)));
         }
 
-        // Jump backwards one index in the matching unless we're in the first block
-        if (matched > 0)
-            matched -= 1;
+        local_locker l(&mutex);
+        oui_map[soui] = md;
+        return md.manuf;
     }
 
-    {
-        local_locker l(&mutex); 
+    local_locker l(&mutex);
 
-        gzseek(zmfile, index_vec[matched].pos, SEEK_SET);
+    auto ii = std::lower_bound(index_vec.begin(), index_vec.end(), soui,
+            [](const index_pos& ip, uint32_t oui) { return ip.oui < oui; });
+    matched = (int) (ii - index_vec.begin()) - 1;
 
-        while (!gzeof(zmfile)) {
-            if (gzgets(zmfile, buf, 1024) == nullptr || gzeof(zmfile))
-                break;
+    // Cache unknown to save us effort in the future
+    if (matched < 0) {
+        manuf_data md;
+        md.oui = soui;
+        md.manuf = unknown_manuf;
+        oui_map[soui] = md;
 
-            if (strlen(buf) < 10)
-                continue;
+        return md.manuf;
+    }
 
-            // Trim \n
-            auto mlen = strlen(buf + 9) - 1;
+    // Jump backwards one index in the matching unless we're in the first block
+    if (matched > 0)
+        matched -= 1;
 
-            if (mlen == 0)
-                continue;
+    gzseek(zmfile, index_vec[matched].pos, SEEK_SET);
 
+    while (!gzeof(zmfile)) {
+        if (gzgets(zmfile, buf, 1024) == nullptr || gzeof(zmfile))
+            break;
 
-            if (sscanf(buf, "%hx:%hx:%hx\t", &(m[0]), &(m[1]), &(m[2])) == 3) {
+        if (strlen(buf) < 10)
+            continue;
 
-                // Log a position at the previous pos - which is the line before
-                // this one, so we're inclusive
-                toui = mac_addr::OUI(m);
+        // Trim \n
+        auto mlen = strlen(buf + 9) - 1;
+
+        if (mlen == 0)
+            continue;
 
-                if (toui == soui) {
-                    manuf_data md;
-                    md.oui = soui;
+        if (sscanf(buf, "%hx:%hx:%hx\t", &(m[0]), &(m[1]), &(m[2])) == 3) {
+            toui = mac_addr::OUI(m);
 
-                    md.manuf = std::make_shared<tracker_element_string>(manuf_id);
-                    md.manuf->set(munge_to_printable(std::string(buf + 9, mlen)));
-                    oui_map[soui] = md;
-                    return md.manuf;
-                }
+            if (toui == soui) {
+                manuf_data md;
+                md.oui = soui;
 
-                if (toui > soui) {
-                    manuf_data md;
-                    md.oui = soui;
-                    md.manuf = unknown_manuf;
-                    oui_map[soui] = md;
-                    return md.manuf;
-                }
+                md.manuf = std::make_shared<tracker_element_string>(manuf_id);
+                md.manuf->set(munge_to_printable(std::string(buf + 9, mlen)));
+                oui_map[soui] = md;
+                return md.manuf;
+            }
+
+            if (toui > soui) {
+                manuf_data md;
+                md.oui = soui;
+                md.manuf = unknown_manuf;
+                oui_map[soui] = md;
+                return md.manuf;
             }
         }
     }
@@ -37,6 +37,7 @@
 #include <string>
 
 #include "globalregistry.h"
+#include "kis_lookup_db.h"
 #include "robin_hood.h"
 #include "trackedelement.h"
 #include "util.h"
@@ -71,6 +72,9 @@ public:
 protected:
     kis_recursive_timed_mutex mutex;
 
+    // Prebuilt table, used instead of the text file when available
+    kis_lookup_db oui_db;
+
     std::vector<index_pos> index_vec;
 
     robin_hood::unordered_node_map<uint32_t, manuf_data> oui_map;
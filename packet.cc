@@ -37,6 +37,10 @@
 #include "packet_ieee80211.h"
 
 
+std::atomic<uint64_t> kis_packet_pool_stats::hits {0};
+std::atomic<uint64_t> kis_packet_pool_stats::misses {0};
+std::atomic<size_t> kis_packet_pool_stats::max_pooled {4096};
+
 kis_packet::kis_packet(global_registry *in_globalreg) {
 	globalreg = in_globalreg;
 
@@ -62,6 +66,29 @@ kis_packet::~kis_packet() {
             delete pcm;
     }
 }
+
+void kis_packet::reset() {
+    for (unsigned int i = 0; i < content_vec.size(); i++) {
+        if (content_vec[i] == nullptr)
+            continue;
+
+        if (content_vec[i]->self_destruct)
+            delete content_vec[i];
+
+        content_vec[i] = nullptr;
+    }
+
+    error = 0;
+    crc_ok = 0;
+    filtered = 0;
+    duplicate = 0;
+
+    ts.tv_sec = 0;
+    ts.tv_usec = 0;
+
+    process_complete_events.clear();
+    tag_vec.clear();
+}
    
 void kis_packet::insert(const unsigned int index, packet_component *data) {
 	if (index >= MAX_PACKET_COMPONENTS) 
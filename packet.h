@@ -29,6 +29,7 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
 #include <string>
 #include <vector>
 #include <map>
@@ -40,6 +41,8 @@
 #include "trackedelement.h"
 #include "trackedcomponent.h"
 
+#include "moodycamel/concurrentqueue.h"
+
 // This is the main switch for how big the vector is.  If something ever starts
 // bumping up against this we'll need to increase it, but that'll slow down 
 // generating a packet (slightly) so I'm leaving it relatively low.
@@ -60,6 +63,64 @@ public:
     int self_destruct;
 };
 
+// Recycling statistics shared by the packet pool and all pooled packet components
+class kis_packet_pool_stats {
+public:
+    static std::atomic<uint64_t> hits;
+    static std::atomic<uint64_t> misses;
+
+    // Maximum number of free objects retained per pooled type
+    static std::atomic<size_t> max_pooled;
+};
+
+// Pooled allocation for frequently created packet components; derive from this
+// (alongside packet_component) to have new/delete of the component recycle the
+// memory instead of returning it to the heap.
+//
+// Components are typically created on a capture thread and deleted on a packet 
+// chain thread, so the free list is a lock-free queue shared between threads.
+// Only objects of exactly the pooled type are recycled; a larger derived class
+// falls through to the normal allocator.
+template<class T>
+class kis_pooled_alloc {
+public:
+    static void *operator new(size_t sz) {
+        if (sz == sizeof(T)) {
+            void *p;
+
+            if (free_list().try_dequeue(p)) {
+                kis_packet_pool_stats::hits++;
+                return p;
+            }
+
+            kis_packet_pool_stats::misses++;
+        }
+
+        return ::operator new(sz);
+    }
+
+    static void operator delete(void *p, size_t sz) {
+        if (p == nullptr)
+            return;
+
+        if (sz == sizeof(T) && 
+                free_list().size_approx() < kis_packet_pool_stats::max_pooled) {
+            free_list().enqueue(p);
+            return;
+        }
+
+        ::operator delete(p);
+    }
+
+protected:
+    static moodycamel::ConcurrentQueue<void *>& free_list() {
+        // Intentionally never freed so that components deleted during shutdown
+        // never touch a destroyed pool
+        static auto pool = new moodycamel::ConcurrentQueue<void *>();
+        return *pool;
+    }
+};
+
 // Overall packet container that holds packet information
 class kis_packet {
 public:
@@ -96,6 +157,10 @@ public:
     kis_packet(global_registry *in_globalreg);
     ~kis_packet();
 
+    // Release all components and return the packet to a freshly constructed
+    // state so it can be recycled by the packet chain
+    void reset();
+
     void insert(const unsigned int index, packet_component *data);
     void *fetch(const unsigned int index) const;
     template<class T> T* fetch(const unsigned int index) {
@@ -194,7 +259,7 @@ protected:
 };
 
 // Arbitrary data chunk, decapsulated from the link headers
-class kis_datachunk : public packet_component {
+class kis_datachunk : public packet_component, public kis_pooled_alloc<kis_datachunk> {
 public:
     uint8_t *data;
     unsigned int length;
@@ -301,7 +366,7 @@ enum kis_packet_direction {
 
 // Common info item which is aggregated into a packet under 
 // the packet_info_map type
-class kis_common_info : public packet_component {
+class kis_common_info : public packet_component, public kis_pooled_alloc<kis_common_info> {
 public:
     kis_common_info() {
         self_destruct = 1;
@@ -435,7 +500,7 @@ enum kis_layer1_packinfo_signal_type {
     kis_l1_signal_type_rssi
 };
 
-class kis_layer1_packinfo : public packet_component {
+class kis_layer1_packinfo : public packet_component, public kis_pooled_alloc<kis_layer1_packinfo> {
 public:
     kis_layer1_packinfo() {
         self_destruct = 1;  // Safe to delete us
@@ -0,0 +1,151 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+#ifndef __PACKET_DEDUP_H__
+#define __PACKET_DEDUP_H__
+
+#include "config.h"
+
+#include <stdint.h>
+#include <vector>
+
+#include "xxhash.h"
+
+// Set of recently seen packet hashes, used to drop the copies of a frame seen by
+// multiple overlapping sources.
+//
+// The most recent N hashes are kept in a ring in arrival order; an open-addressed
+// table (linear probing, at least twice the ring size) indexes the ring by hash, so
+// lookups, insertions, and evicting the oldest hash are constant time instead of a
+// scan of the whole history.
+//
+// Optionally, a hash is only considered a duplicate if it was seen within a time
+// window; a frame which legitimately repeats (such as an unchanged management frame)
+// after the window is treated as new.
+//
+// Not locked; the owner must serialize access.
+class packet_dedup_set {
+public:
+    packet_dedup_set(size_t in_size, uint64_t in_window_usec = 0) :
+        window_usec{in_window_usec},
+        ring_pos{0},
+        ring_used{0} {
+
+        ring.resize(in_size);
+
+        size_t table_sz = 16;
+        while (table_sz < in_size * 2)
+            table_sz <<= 1;
+
+        table.resize(table_sz, 0);
+        table_mask = table_sz - 1;
+    }
+
+    static uint64_t hash(const void *data, size_t len) {
+        return XXH64(data, len, 0);
+    }
+
+    // Check a hash, recording it if it has not been seen.  Returns true if the hash
+    // is a duplicate of a hash seen within the window.
+    bool check_insert(uint64_t h, uint64_t ts_usec) {
+        if (ring.size() == 0)
+            return false;
+
+        for (size_t s = h & table_mask; table[s] != 0; s = (s + 1) & table_mask) {
+            auto& e = ring[table[s] - 1];
+
+            if (e.hash != h)
+                continue;
+
+            if (window_usec == 0 || ts_usec < e.ts_usec || ts_usec - e.ts_usec <= window_usec)
+                return true;
+
+            // Seen, but outside the window; refresh it and treat it as new
+            e.ts_usec = ts_usec;
+            return false;
+        }
+
+        if (ring_used == ring.size())
+            table_remove(ring_pos);
+        else
+            ring_used++;
+
+        ring[ring_pos] = entry{h, ts_usec};
+        table_insert(ring_pos);
+
+        ring_pos = (ring_pos + 1) % ring.size();
+
+        return false;
+    }
+
+protected:
+    struct entry {
+        uint64_t hash;
+        uint64_t ts_usec;
+    };
+
+    void table_insert(size_t ring_slot) {
+        size_t s = ring[ring_slot].hash & table_mask;
+
+        while (table[s] != 0)
+            s = (s + 1) & table_mask;
+
+        table[s] = ring_slot + 1;
+    }
+
+    // Remove the table entry for a ring slot, shifting back any later entries of the
+    // probe run so lookups never stop early on the hole
+    void table_remove(size_t ring_slot) {
+        size_t i = ring[ring_slot].hash & table_mask;
+
+        while (table[i] != ring_slot + 1) {
+            if (table[i] == 0)
+                return;
+            i = (i + 1) & table_mask;
+        }
+
+        table[i] = 0;
+
+        for (size_t j = (i + 1) & table_mask; table[j] != 0; j = (j + 1) & table_mask) {
+            size_t home = ring[table[j] - 1].hash & table_mask;
+
+            // Move j into the hole unless its home lies cyclically in (i, j]
+            bool stays = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+
+            if (stays)
+                continue;
+
+            table[i] = table[j];
+            table[j] = 0;
+            i = j;
+        }
+    }
+
+    uint64_t window_usec;
+
+    std::vector<entry> ring;
+    size_t ring_pos;
+    size_t ring_used;
+
+    // Ring slot + 1 for each occupied bucket, 0 for empty
+    std::vector<uint32_t> table;
+    size_t table_mask;
+};
+
+#endif
+
@@ -103,6 +103,37 @@ packet_chain::packet_chain() {
     packet_processed_rrd =
         std::make_shared<kis_tracked_rrd<>>(packet_processed_rrd_id);
 
+    packet_worker_queue_rrd_id =
+        entrytracker->register_field("kismet.packetchain.worker_queued_packets_rrd",
+                tracker_element_factory<kis_tracked_rrd<kis_tracked_rrd_extreme_aggregator>>(),
+                "per-worker dissection backlog queue rrd");
+    packet_worker_queue_rrd_vec =
+        entrytracker->register_and_get_field_as<tracker_element_vector>("kismet.packetchain.worker_queues",
+                tracker_element_factory<tracker_element_vector>(),
+                "per-worker dissection backlog queue rrds");
+
+    packet_workers_count =
+        entrytracker->register_and_get_field_as<tracker_element_uint32>("kismet.packetchain.dissect_threads",
+                tracker_element_factory<tracker_element_uint32>(),
+                "number of packet dissection threads (0 for single-threaded processing)");
+
+    packet_batch_size_elem =
+        entrytracker->register_and_get_field_as<tracker_element_uint32>("kismet.packetchain.batch_size",
+                tracker_element_factory<tracker_element_uint32>(),
+                "maximum number of packets processed per chain stage at a time");
+
+    packet_pool_hits =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.packetchain.pool_hits",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets and packet components allocated from the recycle pool");
+    packet_pool_misses =
+        entrytracker->register_and_get_field_as<tracker_element_uint64>("kismet.packetchain.pool_misses",
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets and packet components allocated from the heap");
+
+    kis_packet_pool_stats::max_pooled =
+        Globalreg::globalreg->kismet_config->fetch_opt_as<size_t>("packet_pool_size", 4096);
+
     packet_stats_map = 
         std::make_shared<tracker_element_map>();
     packet_stats_map->insert(packet_rate_rrd);
@@ -111,6 +142,11 @@ packet_chain::packet_chain() {
     packet_stats_map->insert(packet_queue_rrd);
     packet_stats_map->insert(packet_drop_rrd);
     packet_stats_map->insert(packet_processed_rrd);
+    packet_stats_map->insert(packet_worker_queue_rrd_vec);
+    packet_stats_map->insert(packet_workers_count);
+    packet_stats_map->insert(packet_batch_size_elem);
+    packet_stats_map->insert(packet_pool_hits);
+    packet_stats_map->insert(packet_pool_misses);
 
     auto httpd = Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>();
 
@@ -132,10 +168,54 @@ packet_chain::packet_chain() {
 
     packetchain_shutdown = false;
 
-    packet_thread = std::thread([this]() {
-            thread_set_process_name("packethandler");
-            packet_queue_processor();
-            });
+    pack_comp_linkframe = register_packet_component("LINKFRAME");
+    pack_comp_decap = register_packet_component("DECAP");
+
+    packet_batch_size =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_batch_size", 1);
+    if (packet_batch_size == 0)
+        packet_batch_size = 1;
+
+    packet_batch_size_elem->set(packet_batch_size);
+
+    n_packet_workers = 
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_dissect_threads", 0);
+
+    if (n_packet_workers == 0) {
+        packet_thread = std::thread([this]() {
+                thread_set_process_name("packethandler");
+                packet_queue_processor();
+                });
+    } else {
+        _MSG_INFO("Processing packets with {} dissection threads", n_packet_workers);
+
+        packet_workers_count->set(n_packet_workers);
+
+        for (unsigned int w = 0; w < n_packet_workers; w++) {
+            auto worker = std::unique_ptr<packet_worker>(new packet_worker());
+            worker->queue_rrd = 
+                std::make_shared<kis_tracked_rrd<kis_tracked_rrd_extreme_aggregator>>(packet_worker_queue_rrd_id);
+            packet_worker_queue_rrd_vec->push_back(worker->queue_rrd);
+            packet_workers.push_back(std::move(worker));
+        }
+
+        for (unsigned int w = 0; w < n_packet_workers; w++) {
+            packet_workers[w]->thread = std::thread([this, w]() {
+                    thread_set_process_name(fmt::format("packetdissect{}", w));
+                    packet_worker_processor(w);
+                    });
+        }
+
+        tracking_thread = std::thread([this]() {
+                thread_set_process_name("packettracker");
+                packet_tracking_processor();
+                });
+
+        packet_thread = std::thread([this]() {
+                thread_set_process_name("packethandler");
+                packet_dispatch_processor();
+                });
+    }
 
     timetracker = Globalreg::fetch_mandatory_global_as<time_tracker>();
     eventbus = Globalreg::fetch_mandatory_global_as<event_bus>();
@@ -144,6 +224,9 @@ packet_chain::packet_chain() {
         timetracker->register_timer(std::chrono::seconds(1), true, 
                 [this](int) -> int {
 
+                packet_pool_hits->set(kis_packet_pool_stats::hits);
+                packet_pool_misses->set(kis_packet_pool_stats::misses);
+
                 auto evt = eventbus->get_eventbus_event(event_packetstats());
                 evt->get_event_content()->insert(event_packetstats(), packet_stats_map);
                 eventbus->publish(evt);
@@ -160,6 +243,23 @@ packet_chain::~packet_chain() {
         packetchain_shutdown = true;
         packet_queue.enqueue(nullptr);
         packet_thread.join();
+
+        // Shut down the dissection workers, then the tracking thread; each
+        // drains its queue before exiting, and is joined before the next stage
+        // is told to stop so nothing is left behind in a later queue
+        for (auto& w : packet_workers) {
+            w->queue.enqueue(nullptr);
+            w->thread.join();
+        }
+
+        if (tracking_thread.joinable()) {
+            tracking_queue.enqueue(nullptr);
+            tracking_thread.join();
+        }
+
+        kis_packet *pooled = nullptr;
+        while (packet_pool.try_dequeue(pooled))
+            delete pooled;
     }
 
     {
@@ -251,91 +351,233 @@ std::string packet_chain::fetch_packet_component_name(int in_id) {
 }
 
 kis_packet *packet_chain::generate_packet() {
-    kis_packet *newpack = new kis_packet(Globalreg::globalreg);
+    kis_packet *newpack = nullptr;
+
+    if (packet_pool.try_dequeue(newpack)) {
+        kis_packet_pool_stats::hits++;
+        return newpack;
+    }
+
+    kis_packet_pool_stats::misses++;
+
+    newpack = new kis_packet(Globalreg::globalreg);
 
     return newpack;
 }
 
+void packet_chain::process_chain_stage(const std::vector<packet_chain::pc_link *>& chain,
+        kis_packet **packets, size_t n_packets) {
+    // Run each handler across the whole batch before moving to the next handler
+    for (const auto& pcl : chain) {
+        if (pcl->callback != NULL) {
+            for (size_t p = 0; p < n_packets; p++)
+                pcl->callback(Globalreg::globalreg, pcl->auxdata, packets[p]);
+        } else if (pcl->l_callback != NULL) {
+            for (size_t p = 0; p < n_packets; p++)
+                pcl->l_callback(packets[p]);
+        }
+    }
+}
+
+size_t packet_chain::dequeue_batch(moodycamel::BlockingConcurrentQueue<kis_packet *>& queue,
+        std::vector<kis_packet *>& batch, bool& shutdown) {
+    size_t n_packets;
+
+    // Once shutdown has been seen, drain whatever is left without blocking
+    if (shutdown)
+        n_packets = queue.try_dequeue_bulk(batch.begin(), batch.size());
+    else
+        n_packets = queue.wait_dequeue_bulk(batch.begin(), batch.size());
+
+    // A null packet marks shutdown; the queue is not strictly ordered between 
+    // producers, so keep any packets which came out alongside it
+    size_t n_valid = 0;
+
+    for (size_t p = 0; p < n_packets; p++) {
+        if (batch[p] == nullptr) {
+            shutdown = true;
+            continue;
+        }
+
+        batch[n_valid++] = batch[p];
+    }
+
+    return n_valid;
+}
+
+void packet_chain::finish_packet(kis_packet *in_pack) {
+    if (in_pack->error)
+        packet_error_rrd->add_sample(1, time(0));
+
+    if (in_pack->duplicate)
+        packet_dupe_rrd->add_sample(1, time(0));
+
+    packet_processed_rrd->add_sample(1, time(0));
+
+    destroy_packet(in_pack);
+}
+
 void packet_chain::packet_queue_processor() {
-    kis_packet *packet = NULL;
+    std::vector<kis_packet *> batch(packet_batch_size);
+    bool shutdown = false;
 
-    while (!packetchain_shutdown && 
+    while (!shutdown && 
+            !packetchain_shutdown && 
             !Globalreg::globalreg->spindown && 
             !Globalreg::globalreg->fatal_condition &&
             !Globalreg::globalreg->complete) {
 
-        packet_queue.wait_dequeue(packet);
+        auto n_packets = dequeue_batch(packet_queue, batch, shutdown);
 
-        if (packet == nullptr)
-            break;
+        if (n_packets == 0)
+            continue;
 
-        // Lock the chain mutexes until we're done processing this packet
-        local_locker chainl(&packetchain_mutex, "packet_chain::packet_queue_processor");
+        {
+            // Lock the chain mutexes until we're done processing this batch
+            local_locker chainl(&packetchain_mutex, "packet_chain::packet_queue_processor");
 
-        // These can only be perturbed inside a sync, which can only occur when
-        // the worker thread is in the sync block above, so we shouldn't
-        // need to worry about the integrity of these vectors while running
+            // These can only be perturbed inside a sync, which can only occur when
+            // the worker thread is in the sync block above, so we shouldn't
+            // need to worry about the integrity of these vectors while running
 
-        for (const auto& pcl : postcap_chain) {
-            if (pcl->callback != NULL)
-                pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-            else if (pcl->l_callback != NULL)
-                pcl->l_callback(packet);
+            process_chain_stage(postcap_chain, batch.data(), n_packets);
+            process_chain_stage(llcdissect_chain, batch.data(), n_packets);
+            process_chain_stage(decrypt_chain, batch.data(), n_packets);
+            process_chain_stage(datadissect_chain, batch.data(), n_packets);
+            process_chain_stage(classifier_chain, batch.data(), n_packets);
+            process_chain_stage(tracker_chain, batch.data(), n_packets);
+            process_chain_stage(logging_chain, batch.data(), n_packets);
         }
 
-        for (const auto& pcl : llcdissect_chain) {
-            if (pcl->callback != NULL)
-                pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-            else if (pcl->l_callback != NULL)
-                pcl->l_callback(packet);
-        }
+        for (size_t p = 0; p < n_packets; p++)
+            finish_packet(batch[p]);
+    }
+}
+
+unsigned int packet_chain::packet_shard(kis_packet *in_pack) {
+    if (n_packet_workers <= 1)
+        return 0;
+
+    auto chunk = in_pack->fetch<kis_datachunk>(pack_comp_decap);
+
+    if (chunk == nullptr)
+        chunk = in_pack->fetch<kis_datachunk>(pack_comp_linkframe);
 
-        for (const auto& pcl : decrypt_chain) {
-            if (pcl->callback != NULL)
-                pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-            else if (pcl->l_callback != NULL)
-                pcl->l_callback(packet);
+    if (chunk == nullptr || chunk->dlt != KDLT_IEEE802_11 || chunk->length < 10)
+        return 0;
+
+    // Shard on the transmitter (addr2) when the frame has one, and the
+    // receiver (addr1) for short control frames like ack and cts
+    const uint8_t *addr = chunk->data + 4;
+    if (chunk->length >= 16)
+        addr = chunk->data + 10;
+
+    uint64_t key = 0;
+    for (unsigned int i = 0; i < 6; i++)
+        key = (key << 8) | addr[i];
+
+    key *= 0x9E3779B97F4A7C15ULL;
+
+    return (key >> 32) % n_packet_workers;
+}
+
+size_t packet_chain::packet_backlog() {
+    size_t backlog = packet_queue.size_approx();
+
+    for (const auto& w : packet_workers)
+        backlog += w->queue.size_approx();
+
+    return backlog + tracking_queue.size_approx();
+}
+
+void packet_chain::packet_dispatch_processor() {
+    std::vector<kis_packet *> batch(packet_batch_size);
+    bool shutdown = false;
+
+    // Threaded stages run until their queue has been drained after the shutdown
+    // marker, so packets already accepted are still tracked and logged
+    while (!Globalreg::globalreg->fatal_condition) {
+        auto n_packets = dequeue_batch(packet_queue, batch, shutdown);
+
+        if (n_packets == 0) {
+            if (shutdown)
+                break;
+
+            continue;
         }
 
-        for (const auto& pcl : datadissect_chain) {
-            if (pcl->callback != NULL)
-                pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-            else if (pcl->l_callback != NULL)
-                pcl->l_callback(packet);
+        {
+            local_shared_locker chainl(&packetchain_mutex, "packet_chain::packet_dispatch_processor");
+            process_chain_stage(postcap_chain, batch.data(), n_packets);
         }
 
-        for (const auto& pcl : classifier_chain) {
-            if (pcl->callback != NULL)
-                pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-            else if (pcl->l_callback != NULL)
-                pcl->l_callback(packet);
+        for (size_t p = 0; p < n_packets; p++) {
+            auto& worker = packet_workers[packet_shard(batch[p])];
+            worker->queue.enqueue(batch[p]);
         }
 
-        for (const auto& pcl : tracker_chain) {
-            if (pcl->callback != NULL)
-                pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-            else if (pcl->l_callback != NULL)
-                pcl->l_callback(packet);
+        for (auto& w : packet_workers)
+            w->queue_rrd->add_sample(w->queue.size_approx(), time(0));
+    }
+}
+
+void packet_chain::packet_worker_processor(unsigned int worker_num) {
+    std::vector<kis_packet *> batch(packet_batch_size);
+    bool shutdown = false;
+    auto& worker = packet_workers[worker_num];
+
+    // Threaded stages run until their queue has been drained after the shutdown
+    // marker, so packets already accepted are still tracked and logged
+    while (!Globalreg::globalreg->fatal_condition) {
+        auto n_packets = dequeue_batch(worker->queue, batch, shutdown);
+
+        if (n_packets == 0) {
+            if (shutdown)
+                break;
+
+            continue;
         }
 
-        for (const auto& pcl : logging_chain) {
-            if (pcl->callback != NULL)
-                pcl->callback(Globalreg::globalreg, pcl->auxdata, packet);
-            else if (pcl->l_callback != NULL)
-                pcl->l_callback(packet);
+        {
+            local_shared_locker chainl(&packetchain_mutex, "packet_chain::packet_worker_processor");
+
+            process_chain_stage(llcdissect_chain, batch.data(), n_packets);
+            process_chain_stage(decrypt_chain, batch.data(), n_packets);
+            process_chain_stage(datadissect_chain, batch.data(), n_packets);
         }
 
-        if (packet->error)
-            packet_error_rrd->add_sample(1, time(0));
+        // Each worker is a single producer so packets from the same shard arrive 
+        // at the tracking thread in order
+        tracking_queue.enqueue_bulk(batch.begin(), n_packets);
+    }
+}
+
+void packet_chain::packet_tracking_processor() {
+    std::vector<kis_packet *> batch(packet_batch_size);
+    bool shutdown = false;
+
+    // Threaded stages run until their queue has been drained after the shutdown
+    // marker, so packets already accepted are still tracked and logged
+    while (!Globalreg::globalreg->fatal_condition) {
+        auto n_packets = dequeue_batch(tracking_queue, batch, shutdown);
 
-        if (packet->duplicate)
-            packet_dupe_rrd->add_sample(1, time(0));
+        if (n_packets == 0) {
+            if (shutdown)
+                break;
 
-        packet_processed_rrd->add_sample(1, time(0));
+            continue;
+        }
+
+        {
+            local_shared_locker chainl(&packetchain_mutex, "packet_chain::packet_tracking_processor");
 
-        destroy_packet(packet);
+            process_chain_stage(classifier_chain, batch.data(), n_packets);
+            process_chain_stage(tracker_chain, batch.data(), n_packets);
+            process_chain_stage(logging_chain, batch.data(), n_packets);
+        }
 
-        continue;
+        for (size_t p = 0; p < n_packets; p++)
+            finish_packet(batch[p]);
     }
 }
 
@@ -343,7 +585,9 @@ int packet_chain::process_packet(kis_packet *in_pack) {
     // Total packet rate always gets added, even when we drop, so we can compare
     packet_rate_rrd->add_sample(1, time(0));
 
-    if (packet_queue_drop != 0 && packet_queue.size_approx() > packet_queue_drop) {
+    auto backlog = packet_backlog();
+
+    if (packet_queue_drop != 0 && backlog > packet_queue_drop) {
         time_t offt = time(0) - last_packet_drop_user_warning;
 
         if (offt > 30) {
@@ -366,7 +610,7 @@ int packet_chain::process_packet(kis_packet *in_pack) {
         return 1;
     }
 
-    if (packet_queue.size_approx() > packet_queue_warning && packet_queue_warning != 0) {
+    if (backlog > packet_queue_warning && packet_queue_warning != 0) {
         time_t offt = time(0) - last_packet_queue_user_warning;
 
         if (offt > 30) {
@@ -392,6 +636,12 @@ int packet_chain::process_packet(kis_packet *in_pack) {
 }
 
 void packet_chain::destroy_packet(kis_packet *in_pack) {
+    // Recycle the packet and its component vector if the pool has room
+    if (packet_pool.size_approx() < kis_packet_pool_stats::max_pooled) {
+        in_pack->reset();
+        packet_pool.enqueue(in_pack);
+        return;
+    }
 
 	delete in_pack;
 }
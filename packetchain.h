@@ -29,6 +29,8 @@
 #endif
 
 #include <algorithm>
+#include <atomic>
+#include <memory>
 #include <string>
 #include <vector>
 #include <map>
@@ -52,6 +54,27 @@
  * They are then processed by the packet consumption thread(s) via the registered
  * chain handlers.
  *
+ * By default a single thread walks each packet through every stage.  When
+ * packet_dissect_threads is set, the packet thread only runs the post-capture
+ * stage and then shards the packet by transmitter MAC to one of N dissection
+ * workers, which run the dissect, decrypt, and data-dissect stages.  Dissected
+ * packets are then handed to a single tracking thread which runs the classifier,
+ * tracker, and logging stages.  Every packet from a given transmitter is handled
+ * by the same worker, so per-device ordering is preserved.  Handlers in the
+ * dissect stages must not depend on being serialized against each other when
+ * threaded dissection is enabled:  they may only modify the packet, and any
+ * state they keep outside of it must be locked or atomic (the 802.11 dedup set
+ * and WEP key counters, for instance).  The built-in btle, mousejack, and IP
+ * data dissectors only read configuration outside of the packet.
+ *
+ * On shutdown each threaded stage drains its queue before exiting, so packets
+ * which were accepted are still tracked and logged.
+ *
+ * Each thread pulls up to packet_batch_size packets from its queue at a time,
+ * and runs each handler in a stage across the whole batch before moving to
+ * the next handler.  Handlers still see packets in order, but the stages of
+ * multiple packets are interleaved.
+ *
  * Once being inserted into the packet chain, the packet pointer may no longer be
  * considered valid by the generating thread.
  *
@@ -141,6 +164,28 @@ public:
 protected:
     void packet_queue_processor();
 
+    // Threaded dissection; post-capture and sharding, per-worker dissection, and
+    // serialized classifier/tracking/logging
+    void packet_dispatch_processor();
+    void packet_worker_processor(unsigned int worker_num);
+    void packet_tracking_processor();
+
+    // Pick a dissection worker by the transmitter of the frame; non-802.11 frames 
+    // are always placed on the first worker
+    unsigned int packet_shard(kis_packet *in_pack);
+
+    // Total backlog across the input queue and any worker queues
+    size_t packet_backlog();
+
+    // Dequeue up to a full batch of packets, blocking until at least one is available
+    size_t dequeue_batch(moodycamel::BlockingConcurrentQueue<kis_packet *>& queue,
+            std::vector<kis_packet *>& batch, bool& shutdown);
+
+    // Run a chain stage across a batch of packets
+    void process_chain_stage(const std::vector<packet_chain::pc_link *>& chain, 
+            kis_packet **packets, size_t n_packets);
+    void finish_packet(kis_packet *in_pack);
+
     // Common function for both insertion methods
     int register_int_handler(pc_callback in_cb, void *in_aux, 
             std::function<int (kis_packet *)> in_l_cb, 
@@ -169,7 +214,36 @@ protected:
     std::thread packet_thread;
 
     moodycamel::BlockingConcurrentQueue<kis_packet *> packet_queue;
-    bool packetchain_shutdown;
+    std::atomic<bool> packetchain_shutdown;
+
+    // Threaded dissection workers; each worker has its own queue so that packets
+    // from the same transmitter are always dissected in order
+    class packet_worker {
+    public:
+        std::thread thread;
+        moodycamel::BlockingConcurrentQueue<kis_packet *> queue;
+        std::shared_ptr<kis_tracked_rrd<kis_tracked_rrd_extreme_aggregator>> queue_rrd;
+    };
+
+    // Maximum number of packets pulled from a queue and run through each chain
+    // stage together
+    unsigned int packet_batch_size;
+    std::shared_ptr<tracker_element_uint32> packet_batch_size_elem;
+
+    unsigned int n_packet_workers;
+    std::vector<std::unique_ptr<packet_worker>> packet_workers;
+
+    std::thread tracking_thread;
+    moodycamel::BlockingConcurrentQueue<kis_packet *> tracking_queue;
+
+    int pack_comp_linkframe, pack_comp_decap;
+
+    // Recycled packets; packets are reset when they are destroyed and handed back
+    // out by generate_packet, which keeps their component vectors allocated
+    moodycamel::ConcurrentQueue<kis_packet *> packet_pool;
+
+    std::shared_ptr<tracker_element_uint64> packet_pool_hits;
+    std::shared_ptr<tracker_element_uint64> packet_pool_misses;
 
     // Warning and discard levels for packet queue being full
     unsigned int packet_queue_warning, packet_queue_drop;
@@ -193,6 +267,11 @@ protected:
     std::shared_ptr<kis_tracked_rrd<>> packet_processed_rrd;
     int packet_processed_rrd_id;
 
+    std::shared_ptr<tracker_element_vector> packet_worker_queue_rrd_vec;
+    int packet_worker_queue_rrd_id;
+
+    std::shared_ptr<tracker_element_uint32> packet_workers_count;
+
     std::shared_ptr<tracker_element_map> packet_stats_map;
 
     std::shared_ptr<time_tracker> timetracker;
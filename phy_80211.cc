@@ -488,13 +488,48 @@ kis_80211_phy::kis_80211_phy(global_registry *in_globalreg, int in_phyid) :
     ssidtracker = phy_80211_ssid_tracker::create_dot11_ssidtracker();
 
     // Set up the de-duplication list
-    recent_packet_checksums_sz = 
+    auto dedup_sz =
         Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_dedup_size", 2048);
-    recent_packet_checksums = new uint32_t[recent_packet_checksums_sz];
-    for (unsigned int x = 0; x < recent_packet_checksums_sz; x++) {
-        recent_packet_checksums[x] = 0;
-    }
-    recent_packet_checksum_pos = 0;
+    auto dedup_window_ms =
+        Globalreg::globalreg->kismet_config->fetch_opt_uint("packet_dedup_window", 0);
+    recent_packet_checksums =
+        std::unique_ptr<packet_dedup_set>(new packet_dedup_set(dedup_sz, dedup_window_ms * 1000));
+
+    dedup_stats =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_map>("dot11.dedup", 
+                tracker_element_factory<tracker_element_map>(),
+                "802.11 duplicate packet filtering");
+    dedup_checked =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("dot11.dedup.checked", 
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets checked for duplicates");
+    dedup_hits =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_uint64>("dot11.dedup.hits", 
+                tracker_element_factory<tracker_element_uint64>(),
+                "packets discarded as duplicates");
+    dedup_hit_rate =
+        Globalreg::globalreg->entrytracker->register_and_get_field_as<tracker_element_double>("dot11.dedup.hit_rate", 
+                tracker_element_factory<tracker_element_double>(),
+                "fraction of checked packets which were duplicates");
+    ssid_fingerprint_checked = 0;
+    ssid_fingerprint_hits = 0;
+
+    ssid_fingerprint_checked_id =
+        Globalreg::globalreg->entrytracker->register_field("dot11.ssid_fingerprint.checked", 
+                tracker_element_factory<tracker_element_uint64>(),
+                "beacons and probe responses checked against recent fingerprints");
+    ssid_fingerprint_hits_id =
+        Globalreg::globalreg->entrytracker->register_field("dot11.ssid_fingerprint.hits", 
+                tracker_element_factory<tracker_element_uint64>(),
+                "beacons and probe responses which skipped dissection");
+    ssid_fingerprint_hit_rate_id =
+        Globalreg::globalreg->entrytracker->register_field("dot11.ssid_fingerprint.hit_rate", 
+                tracker_element_factory<tracker_element_double>(),
+                "fraction of beacons and probe responses which skipped dissection");
+
+    dedup_stats->insert(dedup_checked);
+    dedup_stats->insert(dedup_hits);
+    dedup_stats->insert(dedup_hit_rate);
 
     // Parse the ssid regex options
     auto apspoof_lines = Globalreg::globalreg->kismet_config->fetch_opt_vec("apspoof");
@@ -668,6 +703,25 @@ kis_80211_phy::kis_80211_phy(global_registry *in_globalreg, int in_phyid) :
 
     auto httpd = Globalreg::fetch_mandatory_global_as<kis_net_beast_httpd>();
 
+    httpd->register_route("/phy/phy80211/dedup", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(dedup_stats, &recent_packet_checksum_mutex));
+
+    httpd->register_route("/phy/phy80211/ssid_fingerprint_cache", {"GET", "POST"}, httpd->RO_ROLE, {},
+            std::make_shared<kis_net_web_tracked_endpoint>(
+                [this](std::shared_ptr<kis_net_beast_httpd_connection> con) -> std::shared_ptr<tracker_element> {
+                    auto ret = std::make_shared<tracker_element_map>();
+
+                    uint64_t checked = ssid_fingerprint_checked;
+                    uint64_t hits = ssid_fingerprint_hits;
+
+                    ret->insert(std::make_shared<tracker_element_uint64>(ssid_fingerprint_checked_id, checked));
+                    ret->insert(std::make_shared<tracker_element_uint64>(ssid_fingerprint_hits_id, hits));
+                    ret->insert(std::make_shared<tracker_element_double>(ssid_fingerprint_hit_rate_id, 
+                                checked == 0 ? 0 : (double) hits / checked));
+
+                    return ret;
+                }));
+
     httpd->register_route("/phy/phy80211/clients-of/:key/clients", {"GET", "POST"}, httpd->RO_ROLE, {},
             std::make_shared<kis_net_web_tracked_endpoint>(
                 [this](std::shared_ptr<kis_net_beast_httpd_connection> con) {
@@ -844,8 +898,6 @@ kis_80211_phy::~kis_80211_phy() {
 	packetchain->remove_handler(&packet_dot11_common_classifier, CHAINPOS_CLASSIFIER);
 
     timetracker->remove_timer(device_idle_timer);
-
-    delete[] recent_packet_checksums;
 }
 
 const std::string kis_80211_phy::khz_to_channel(const double in_khz) {
@@ -2171,27 +2223,36 @@ void kis_80211_phy::handle_ssid(std::shared_ptr<kis_tracked_device_base> basedev
         return;
     }
 
-    // If we've processed an identical ssid, don't waste time parsing again, just tweak
-    // the few fields we need to update
-    if (dot11dev->get_last_adv_ie_csum() == dot11info->ietag_csum) {
-        ssid = dot11dev->get_last_adv_ssid();
+    // If we've recently processed an identical beacon or response from this bssid, don't 
+    // waste time parsing again, just tweak the few fields we need to update.  A beacon we
+    // need to snapshot for a handshake always goes through the full path below.
+    ssid_fingerprint_checked++;
+
+    if (dot11info->ietag_fingerprint != 0 &&
+            !(dot11info->subtype == packet_sub_beacon && dot11dev->get_snap_next_beacon()) &&
+            dot11dev->find_adv_fingerprint(dot11info->ietag_fingerprint, ssid)) {
+        ssid_fingerprint_hits++;
 
         if (ssid != nullptr) {
             if (ssid->get_last_time() < in_pack->ts.tv_sec)
                 ssid->set_last_time(in_pack->ts.tv_sec);
 
+            dot11dev->set_last_adv_ssid(ssid);
+
             if (dot11info->subtype == packet_sub_beacon) {
                 ssid->inc_beacons_sec();
+                dot11dev->get_last_beaconed_ssid_record()->set(ssid);
             }
         }
 
         return;
     }
 
-    dot11dev->set_last_adv_ie_csum(dot11info->ietag_csum);
-
-    // If we fail parsing...
+    // If we fail parsing, remember it so we don't re-parse (and re-alert) the same broken
+    // frame
     if (packet_dot11_ie_dissector(in_pack, dot11info) < 0) {
+        if (dot11info->ietag_fingerprint != 0)
+            dot11dev->cache_adv_fingerprint(dot11info->ietag_fingerprint, nullptr);
         return;
     }
 
@@ -2427,6 +2488,8 @@ void kis_80211_phy::handle_ssid(std::shared_ptr<kis_tracked_device_base> basedev
     }
 
     dot11dev->set_last_adv_ssid(ssid);
+    if (dot11info->ietag_fingerprint != 0)
+        dot11dev->cache_adv_fingerprint(dot11info->ietag_fingerprint, ssid);
 
     ssid->set_ietag_checksum(dot11info->ietag_csum);
 
@@ -25,6 +25,7 @@
 
 #include <stdio.h>
 #include <time.h>
+#include <atomic>
 #include <list>
 #include <map>
 #include <vector>
@@ -39,6 +40,7 @@
 #include "packetchain.h"
 #include "timetracker.h"
 #include "packet.h"
+#include "packet_dedup.h"
 #include "gpstracker.h"
 #include "uuid.h"
 #include "streamtracker.h"
@@ -77,8 +79,9 @@ class dot11_wep_key {
         mac_addr bssid;
         unsigned char key[DOT11_WEPKEY_MAX];
         unsigned int len;
-        unsigned int decrypted;
-        unsigned int failed;
+        // Updated by the decrypt stage, which may run on several dissection threads
+        std::atomic<unsigned int> decrypted;
+        std::atomic<unsigned int> failed;
 };
 
 // dot11 packet components
@@ -106,7 +109,7 @@ class dot11_packinfo_dot11d_entry {
 // Packet info decoded by the dot11 phy decoder
 // 
 // Injected into the packet chain and processed later into the device records
-class dot11_packinfo : public packet_component {
+class dot11_packinfo : public packet_component, public kis_pooled_alloc<dot11_packinfo> {
     public:
         dot11_packinfo() {
             self_destruct = 1; // Our delete() handles this
@@ -140,6 +143,7 @@ class dot11_packinfo : public packet_component {
 
             // Many of thse will not be available until the IE tags are parsed
             ietag_csum = 0;
+            ietag_fingerprint = 0;
 
             dot11d_country = "";
 
@@ -228,6 +232,10 @@ class dot11_packinfo : public packet_component {
         uint32_t ssid_csum;
         uint32_t ietag_csum;
 
+        // Strong hash of the beacon or probe response contents which are dissected,
+        // excluding per-beacon noise like the TIM; 0 if not an SSID-carrying frame
+        uint64_t ietag_fingerprint;
+
         // Tupled hash map
         std::multimap<std::tuple<uint8_t, uint32_t, uint8_t>, size_t> ietag_hash_map;
 
@@ -402,10 +410,22 @@ protected:
     std::shared_ptr<entry_tracker> entrytracker;
     std::shared_ptr<stream_tracker> streamtracker;
 
-    // Checksum of recent packets for duplication filtering
-    uint32_t *recent_packet_checksums;
-    size_t recent_packet_checksums_sz;
-    unsigned int recent_packet_checksum_pos;
+    // Hashes of recent packets for duplication filtering; locked because the
+    // dissector may run on multiple packet chain threads
+    kis_recursive_timed_mutex recent_packet_checksum_mutex;
+    std::unique_ptr<packet_dedup_set> recent_packet_checksums;
+
+    // Dedup statistics, updated under the checksum mutex
+    std::shared_ptr<tracker_element_map> dedup_stats;
+    std::shared_ptr<tracker_element_uint64> dedup_checked;
+    std::shared_ptr<tracker_element_uint64> dedup_hits;
+    std::shared_ptr<tracker_element_double> dedup_hit_rate;
+
+    // Beacons and probe responses matching a recently dissected fingerprint of the
+    // same BSSID, which skip IE dissection
+    std::atomic<uint64_t> ssid_fingerprint_checked;
+    std::atomic<uint64_t> ssid_fingerprint_hits;
+    int ssid_fingerprint_checked_id, ssid_fingerprint_hits_id, ssid_fingerprint_hit_rate_id;
 
     // Handle advertised SSIDs
     void handle_ssid(std::shared_ptr<kis_tracked_device_base> basedev, 
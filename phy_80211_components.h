@@ -388,7 +388,7 @@ public:
     __Proxy(tag_vendor_or_sub, int16_t, int16_t, int16_t, tag_vendor_or_sub);
     __Proxy(complete_tag_data, std::string, std::string, std::string, complete_tag_data);
 
-    void set_from_tag(std::shared_ptr<dot11_ie::dot11_ie_tag> ie);
+    void set_from_tag(const dot11_ie::dot11_ie_tag& ie);
 
 protected:
     virtual void register_fields() override;
@@ -1066,6 +1066,7 @@ public:
         tracker_component() {
 
         last_adv_ie_csum = 0;
+        adv_fingerprint_pos = 0;
         last_bss_invalid = 0;
         bss_invalid_count = 0;
         snapshot_next_beacon = false;
@@ -1078,6 +1079,7 @@ public:
         tracker_component(in_id) { 
 
         last_adv_ie_csum = 0;
+        adv_fingerprint_pos = 0;
         last_bss_invalid = 0;
         bss_invalid_count = 0;
         snapshot_next_beacon = false;
@@ -1090,6 +1092,7 @@ public:
         tracker_component(in_id) {
 
         last_adv_ie_csum = 0;
+        adv_fingerprint_pos = 0;
         last_bss_invalid = 0;
         bss_invalid_count = 0;
         snapshot_next_beacon = false;
@@ -1102,6 +1105,7 @@ public:
         tracker_component{p} {
 
         last_adv_ie_csum = 0;
+        adv_fingerprint_pos = 0;
         last_bss_invalid = 0;
         bss_invalid_count = 0;
         snapshot_next_beacon = false;
@@ -1282,6 +1286,29 @@ public:
         return std::make_shared<dot11_tracked_nonce>(wpa_nonce_entry_id);
     }
 
+    // Look up the SSID record produced by a recently dissected beacon or probe response
+    // fingerprint; the record is null if the frame failed to dissect
+    bool find_adv_fingerprint(uint64_t fingerprint, std::shared_ptr<dot11_advertised_ssid>& ssid) {
+        for (const auto& f : adv_fingerprints) {
+            if (f.first == fingerprint) {
+                ssid = f.second;
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void cache_adv_fingerprint(uint64_t fingerprint, std::shared_ptr<dot11_advertised_ssid> ssid) {
+        if (adv_fingerprints.size() < adv_fingerprint_cache_sz) {
+            adv_fingerprints.push_back(std::make_pair(fingerprint, ssid));
+            return;
+        }
+
+        adv_fingerprints[adv_fingerprint_pos] = std::make_pair(fingerprint, ssid);
+        adv_fingerprint_pos = (adv_fingerprint_pos + 1) % adv_fingerprint_cache_sz;
+    }
+
     uint32_t get_last_adv_ie_csum() { return last_adv_ie_csum; }
     void set_last_adv_ie_csum(uint32_t csum) { last_adv_ie_csum = csum; }
     std::shared_ptr<dot11_advertised_ssid> get_last_adv_ssid() {
@@ -1629,6 +1656,12 @@ protected:
     uint32_t last_adv_ie_csum;
     std::shared_ptr<dot11_advertised_ssid> last_adv_ssid;
 
+    // Recent beacon and probe response fingerprints; enough to cover a beacon and 
+    // probe responses alternating between a few SSIDs
+    static constexpr size_t adv_fingerprint_cache_sz = 4;
+    std::vector<std::pair<uint64_t, std::shared_ptr<dot11_advertised_ssid>>> adv_fingerprints;
+    size_t adv_fingerprint_pos;
+
     // Advertised in association requests but device-centric
     std::shared_ptr<tracker_element_uint8> min_tx_power;
     std::shared_ptr<tracker_element_uint8> max_tx_power;
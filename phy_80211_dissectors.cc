@@ -38,6 +38,7 @@
 #include "packetchain.h"
 #include "alertracker.h"
 #include "configfile.h"
+#include "xxhash.h"
 
 #include "kaitai/kaitaistream.h"
 #include "dot11_parsers/dot11_wpa_eap.h"
@@ -280,6 +281,41 @@ int kis_80211_phy::wpa_key_mgt_conv(uint8_t mgt_index) {
     return ret;
 }
 
+// Fingerprint the parts of a beacon or probe response which are dissected and tracked:
+// the beacon interval, capabilities, and IE tags.  The timestamp and the TIM change in
+// nearly every beacon and are not tracked, so they are skipped; every other change to 
+// the tags changes the fingerprint.
+static uint64_t ssid_fingerprint(unsigned int subtype, const char *fixparm, size_t len) {
+    // timestamp, interval, capabilities
+    if (len < 12)
+        return 0;
+
+    uint64_t h = XXH64(fixparm + 8, 4, subtype);
+
+    const char *tags = fixparm + 12;
+    size_t tags_len = len - 12;
+
+    // Hash each run of tags between TIM tags
+    size_t run_start = 0;
+    size_t pos = 0;
+
+    while (pos + 2 <= tags_len) {
+        size_t tag_end = pos + 2 + (uint8_t) tags[pos + 1];
+
+        if ((uint8_t) tags[pos] == 5) {
+            h = XXH64(tags + run_start, pos - run_start, h);
+            run_start = tag_end < tags_len ? tag_end : tags_len;
+        }
+
+        pos = tag_end;
+    }
+
+    h = XXH64(tags + run_start, tags_len - run_start, h);
+
+    // 0 is reserved for no fingerprint
+    return h == 0 ? 1 : h;
+}
+
 // This needs to be optimized and it needs to not use casting to do its magic
 int kis_80211_phy::packet_dot11_dissector(kis_packet *in_pack) {
     if (in_pack->error) {
@@ -304,24 +340,28 @@ int kis_80211_phy::packet_dot11_dissector(kis_packet *in_pack) {
     if (chunk->dlt != KDLT_IEEE802_11)
         return 0;
 
-    // Compare the checksum and see if we've recently seen this exact packet
-    uint32_t chunk_csum = adler32_checksum((const char *) chunk->data, chunk->length);
+    // Compare the hash and see if we've recently seen this exact packet
+    auto chunk_hash = packet_dedup_set::hash(chunk->data, chunk->length);
+    auto chunk_ts = (uint64_t) in_pack->ts.tv_sec * 1000000 + in_pack->ts.tv_usec;
 
-    for (unsigned int c = 0; c < recent_packet_checksums_sz; c++) {
-        if (recent_packet_checksums[c] == 0)
-            break;
+    {
+        local_locker csuml(&recent_packet_checksum_mutex, "dot11 packet dedup");
+
+        bool dupe = recent_packet_checksums->check_insert(chunk_hash, chunk_ts);
 
-        if (recent_packet_checksums[c] == chunk_csum) {
+        *dedup_checked += 1;
+        if (dupe)
+            *dedup_hits += 1;
+
+        dedup_hit_rate->set((double) dedup_hits->get() / dedup_checked->get());
+
+        if (dupe) {
             in_pack->filtered = 1;
             in_pack->duplicate = 1;
             return 0;
         }
     }
 
-    if (recent_packet_checksums_sz > 0)
-        recent_packet_checksums[(recent_packet_checksum_pos++ % recent_packet_checksums_sz)] = 
-            chunk_csum;
-
     // Flat-out dump if it's not big enough to be 80211, don't even bother making a
     // packinfo record for it because we're completely broken
     if (chunk->length < 10) {
@@ -762,11 +802,11 @@ int kis_80211_phy::packet_dot11_dissector(kis_packet *in_pack) {
                         return 0;
                     }
 
-                    for (auto t : *(rmm_tags->tags())) {
-                        if (t->tag_num() == 52) {
+                    for (const auto& t : rmm_tags->tags()) {
+                        if (t.tag_num() == 52) {
                             try {
                                 dot11_ie_52_rmm ie_rmm;
-                                ie_rmm.parse(t->tag_data_stream());
+                                ie_rmm.parse(t.tag_data_stream());
 
                                 if (ie_rmm.channel_number() > 0xE0) {
                                     std::stringstream ss;
@@ -865,6 +905,11 @@ int kis_80211_phy::packet_dot11_dissector(kis_packet *in_pack) {
                 adler32_checksum((const char *) (chunk->data + packinfo->header_offset),
                                 chunk->length - packinfo->header_offset);
 
+            if (fc->subtype == packet_sub_beacon || fc->subtype == packet_sub_probe_resp)
+                packinfo->ietag_fingerprint = 
+                    ssid_fingerprint(fc->subtype, (const char *) chunk->data + 24, 
+                            chunk->length - 24);
+
         } else if (fc->subtype == packet_sub_deauthentication) {
             if ((packinfo->mgt_reason_code >= 25 && packinfo->mgt_reason_code <= 31) ||
                 packinfo->mgt_reason_code > 45) {
@@ -1251,45 +1296,25 @@ std::vector<kis_80211_phy::ie_tag_tuple> kis_80211_phy::PacketDot11IElist(kis_pa
         if (chunk->dlt != KDLT_IEEE802_11)
             return ret;
 
-        membuf tags_membuf((char *) &(chunk->data[packinfo->header_offset]), 
-                (char *) &(chunk->data[chunk->length]));
-        std::istream istream_ietags(&tags_membuf);
-
         packinfo->ie_tags = std::make_shared<dot11_ie>();
 
         try {
-            std::shared_ptr<kaitai::kstream> stream_ietags(new kaitai::kstream(&istream_ietags));
-            packinfo->ie_tags->parse(stream_ietags);
+            packinfo->ie_tags->parse((const char *) &(chunk->data[packinfo->header_offset]),
+                    chunk->length - packinfo->header_offset);
         } catch (const std::exception& e) {
             return ret;
         }
     }
 
-    for (auto ie_tag : *(packinfo->ie_tags->tags())) {
-        if (ie_tag->tag_num() == 150) {
+    for (const auto& ie_tag : packinfo->ie_tags->tags()) {
+        if (ie_tag.tag_num() == 150 || ie_tag.tag_num() == 221) {
             try {
-                ie_tag->tag_data_stream()->seek(0);
-
-                std::shared_ptr<dot11_ie_150_vendor> vendor(new dot11_ie_150_vendor());
-                vendor->parse(ie_tag->tag_data_stream());
-
-                ret.push_back(ie_tag_tuple{150, vendor->vendor_oui_int(), vendor->vendor_oui_type()});
-            } catch (const std::exception &e) {
-                return ret;
-            }
-        } else if (ie_tag->tag_num() == 221) {
-            try {
-                ie_tag->tag_data_stream()->seek(0);
-
-                std::shared_ptr<dot11_ie_221_vendor> vendor(new dot11_ie_221_vendor());
-                vendor->parse(ie_tag->tag_data_stream());
-
-                ret.push_back(ie_tag_tuple{221, vendor->vendor_oui_int(), vendor->vendor_oui_type()});
+                ret.push_back(ie_tag_tuple{ie_tag.tag_num(), ie_tag.vendor_oui_int(), ie_tag.vendor_oui_type()});
             } catch (const std::exception &e) {
                 return ret;
             }
         } else {
-            ret.push_back(ie_tag_tuple{ie_tag->tag_num(), 0, 0});
+            ret.push_back(ie_tag_tuple{ie_tag.tag_num(), 0, 0});
         }
     }
 
@@ -1322,15 +1347,11 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         return 0;
 
     if (packinfo->ie_tags == nullptr) {
-        membuf tags_membuf((char *) &(chunk->data[packinfo->header_offset]), 
-                (char *) &(chunk->data[chunk->length]));
-        std::istream istream_ietags(&tags_membuf);
-
         packinfo->ie_tags = std::make_shared<dot11_ie>();
 
         try {
-            std::shared_ptr<kaitai::kstream> stream_ietags(new kaitai::kstream(&istream_ietags));
-            packinfo->ie_tags->parse(stream_ietags);
+            packinfo->ie_tags->parse((const char *) &(chunk->data[packinfo->header_offset]),
+                    chunk->length - packinfo->header_offset);
         } catch (const std::exception& e) {
             // fmt::print(stderr, "debug - IE tag structure corrupt\n");
             packinfo->corrupt = 1;
@@ -1348,35 +1369,23 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
     // bool seen_mcsrates = false;
     unsigned int wmmtspec_responses = 0;
 
-    for (auto ie_tag : *(packinfo->ie_tags->tags())) {
-        auto hash = std::hash<std::string>{};
+    for (const auto& ie_tag : packinfo->ie_tags->tags()) {
+        auto hash = std::hash<nonstd::string_view>{};
 
-        if (ie_tag->tag_num() == 150) {
+        if (ie_tag.tag_num() == 150 || ie_tag.tag_num() == 221) {
             try {
-                auto vendor = std::make_shared<dot11_ie_150_vendor>();
-                vendor->parse(ie_tag->tag_data_stream());
-
-                packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{150, vendor->vendor_oui_int(), vendor->vendor_oui_type()}, hash(ie_tag->tag_data())));
-            } catch (const std::exception& e) {
-                packinfo->corrupt = 1;
-                return -1;
-            }
-        } else if (ie_tag->tag_num() == 221) {
-            try {
-                auto vendor = std::make_shared<dot11_ie_221_vendor>();
-                vendor->parse(ie_tag->tag_data_stream());
-
-                packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{221, vendor->vendor_oui_int(), vendor->vendor_oui_type()}, hash(ie_tag->tag_data())));
+                packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{ie_tag.tag_num(), 
+                            ie_tag.vendor_oui_int(), ie_tag.vendor_oui_type()}, hash(ie_tag.tag_data_view())));
             } catch (const std::exception& e) {
                 packinfo->corrupt = 1;
                 return -1;
             }
         } else {
-            packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{ie_tag->tag_num(), 0, 0}, hash(ie_tag->tag_data())));
+            packinfo->ietag_hash_map.insert(std::make_pair(ie_tag_tuple{ie_tag.tag_num(), 0, 0}, hash(ie_tag.tag_data_view())));
         }
 
         // IE 0 SSID
-        if (ie_tag->tag_num() == 0) {
+        if (ie_tag.tag_num() == 0) {
             /*
             if (seen_ssid) {
                 fprintf(stderr, "debug - multiple SSID ie tags?\n");
@@ -1385,9 +1394,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             seen_ssid = true;
             */
 
-            packinfo->ssid_len = ie_tag->tag_data().length();
-            packinfo->ssid_csum = kis_80211_phy::ssid_hash(ie_tag->tag_data().data(), 
-                    ie_tag->tag_data().length());
+            auto ssid_data = ie_tag.tag_data_view();
+
+            packinfo->ssid_len = ssid_data.length();
+            packinfo->ssid_csum = kis_80211_phy::ssid_hash(ssid_data.data(), ssid_data.length());
 
             if (packinfo->ssid_len == 0) {
                 packinfo->ssid_blank = true;
@@ -1395,10 +1405,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             }
 
             if (packinfo->ssid_len <= DOT11_PROTO_SSID_LEN) {
-                if (ie_tag->tag_data().find_first_not_of('\0') == std::string::npos) {
+                if (ssid_data.find_first_not_of('\0') == nonstd::string_view::npos) {
                     packinfo->ssid_blank = true;
                 } else {
-                    packinfo->ssid = munge_to_printable(ie_tag->tag_data().data());
+                    packinfo->ssid = munge_to_printable(ssid_data.data(), ssid_data.length(), 1);
                 }
             } else { 
                 _ALERT(alert_longssid_ref, in_pack, packinfo,
@@ -1415,8 +1425,8 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
 
         // IE 1 Basic Rates
         // IE 50 Extended Rates
-        if (ie_tag->tag_num() == 1 || ie_tag->tag_num() == 50) {
-            if (ie_tag->tag_num() == 1) {
+        if (ie_tag.tag_num() == 1 || ie_tag.tag_num() == 50) {
+            if (ie_tag.tag_num() == 1) {
                 /*
                 if (seen_basicrates) {
                     fprintf(stderr, "debug - seen multiple basicrates?\n");
@@ -1427,7 +1437,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
 
             }
 
-            if (ie_tag->tag_num() == 50) {
+            if (ie_tag.tag_num() == 50) {
                 /*
                 if (seen_extendedrates) {
                     fprintf(stderr, "debug - seen multiple extendedrates?\n");
@@ -1437,7 +1447,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
                 */
             }
 
-            if (ie_tag->tag_data().find("\x75\xEB\x49") != std::string::npos) {
+            if (ie_tag.tag_data_view().find("\x75\xEB\x49") != nonstd::string_view::npos) {
                 _ALERT(alert_msfdlinkrate_ref, in_pack, packinfo,
                         "MSF-style poisoned rate field in beacon for network " +
                         packinfo->bssid_mac.mac_to_string() + ", exploit attempt "
@@ -1448,7 +1458,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             }
 
             std::vector<std::string> basicrates;
-            for (uint8_t r : ie_tag->tag_data()) {
+            for (uint8_t r : ie_tag.tag_data_view()) {
                 std::string rate;
 
                 switch (r) {
@@ -1594,14 +1604,14 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 3 channel
-        if (ie_tag->tag_num() == 3) {
-            if (ie_tag->tag_len() > 1) {
+        if (ie_tag.tag_num() == 3) {
+            if (ie_tag.tag_len() > 1) {
                 std::string al = fmt::format("IEEE80211 packet from {0} to {1} BSSID {2} included an IE "
                         "tag {3} entry with an invalid length; IE {3} should be {4} bytes, but was {5}. "
                         "This may be indicative of an as-yet-unknown buffer overflow attempt against "
                         "the Wi-Fi drivers or firmware, but could also be caused by a misconfigured device.",
                         packinfo->source_mac, packinfo->dest_mac, packinfo->bssid_mac, 
-                        3, 1, ie_tag->tag_len());
+                        3, 1, ie_tag.tag_len());
 
                 alertracker->raise_alert(alert_bad_fixlen_ie, in_pack, 
                         packinfo->bssid_mac, packinfo->source_mac, 
@@ -1611,17 +1621,17 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
                 return -1;
             }
                 
-            packinfo->channel = fmt::format("{}", (uint8_t) (ie_tag->tag_data()[0]));
+            packinfo->channel = fmt::format("{}", (uint8_t) (ie_tag.tag_data()[0]));
             continue;
         }
 
         // IE 7 802.11d
-        if (ie_tag->tag_num() == 7) {
+        if (ie_tag.tag_num() == 7) {
             try {
                 dot11_ie_7_country dot11d;
                 // Allow fragmented 11d, take what we can parse
                 dot11d.set_allow_fragments(true);
-                dot11d.parse(ie_tag->tag_data_stream());
+                dot11d.parse(ie_tag.tag_data_stream());
 
                 packinfo->dot11d_country = munge_to_printable(dot11d.country_code());
 
@@ -1644,11 +1654,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 11 QBSS
-        if (ie_tag->tag_num() == 11) {
+        if (ie_tag.tag_num() == 11) {
             try {
                 std::shared_ptr<dot11_ie_11_qbss> qbss(new dot11_ie_11_qbss());
-                ie_tag->tag_data_stream()->seek(0);
-                qbss->parse(ie_tag->tag_data_stream());
+                qbss->parse(ie_tag.tag_data_stream());
                 packinfo->qbss = qbss;
             } catch (const std::exception& e) {
                 // fprintf(stderr, "debug - corrupt QBSS %s\n", e.what());
@@ -1660,10 +1669,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 33 advertised txpower in probe req
-        if (ie_tag->tag_num() == 33) {
+        if (ie_tag.tag_num() == 33) {
             try {
                 packinfo->tx_power = std::make_shared<dot11_ie_33_power>();
-                packinfo->tx_power->parse(ie_tag->tag_data_stream());
+                packinfo->tx_power->parse(ie_tag.tag_data_stream());
             } catch (const std::exception& e) {
                 // fmt::print(stderr, "debug - corrupt IE33 power: {}\n", e.what());
             }
@@ -1671,16 +1680,16 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 36, advertised supported channels in probe req
-        if (ie_tag->tag_num() == 36) {
+        if (ie_tag.tag_num() == 36) {
             try {
                 packinfo->supported_channels = std::make_shared<dot11_ie_36_supported_channels>();
-                packinfo->supported_channels->parse(ie_tag->tag_data_stream());
+                packinfo->supported_channels->parse(ie_tag.tag_data_stream());
             } catch (const std::exception& e) {
                 // fmt::print(stderr, "debug  corrupt ie36 supported channels: {}\n", e.what());
             }
         }
 
-        if (ie_tag->tag_num() == 45) {
+        if (ie_tag.tag_num() == 45) {
             /*
             if (seen_mcsrates) {
                 fprintf(stderr, "debug - duplicate ie45 mcs rates\n");
@@ -1693,7 +1702,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
 
             try {
                 std::shared_ptr<dot11_ie_45_ht_cap> ht(new dot11_ie_45_ht_cap());
-                ht->parse(ie_tag->tag_data_stream());
+                ht->parse(ie_tag.tag_data_stream());
 
                 std::stringstream mcsstream;
 
@@ -1761,12 +1770,12 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 48, RSN
-        if (ie_tag->tag_num() == 48) {
+        if (ie_tag.tag_num() == 48) {
             bool rsn_invalid = false;
 
             try {
                 std::shared_ptr<dot11_ie_48_rsn> rsn(new dot11_ie_48_rsn());
-                rsn->parse(ie_tag->tag_data_stream());
+                rsn->parse(ie_tag.tag_data_stream());
 
                 // TODO - don't aggregate these in the future
 
@@ -1807,8 +1816,7 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             if (rsn_invalid) {
                 try {
                     std::shared_ptr<dot11_ie_48_rsn_partial> rsn(new dot11_ie_48_rsn_partial());
-                    ie_tag->tag_data_stream()->seek(0);
-                    rsn->parse(ie_tag->tag_data_stream());
+                    rsn->parse(ie_tag.tag_data_stream());
 
                     if (rsn->pairwise_count() > 1024) {
                         alertracker->raise_alert(alert_atheros_rsnloop_ref, 
@@ -1832,10 +1840,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 54 Mobility
-        if (ie_tag->tag_num() == 54) {
+        if (ie_tag.tag_num() == 54) {
             try {
                 std::shared_ptr<dot11_ie_54_mobility> mobility(new dot11_ie_54_mobility());
-                mobility->parse(ie_tag->tag_data_stream());
+                mobility->parse(ie_tag.tag_data_stream());
                 packinfo->dot11r_mobility = mobility;
             } catch (const std::exception& e) {
                 packinfo->corrupt = 1;
@@ -1845,10 +1853,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 61 HT
-        if (ie_tag->tag_num() == 61) {
+        if (ie_tag.tag_num() == 61) {
             try {
                 std::shared_ptr<dot11_ie_61_ht_op> ht(new dot11_ie_61_ht_op());
-                ht->parse(ie_tag->tag_data_stream());
+                ht->parse(ie_tag.tag_data_stream());
                 packinfo->dot11ht = ht;
             } catch (const std::exception& e) {
                 // fprintf(stderr, "debug - unparsable HT\n");
@@ -1860,10 +1868,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 133 CISCO CCX
-        if (ie_tag->tag_num() == 133) {
+        if (ie_tag.tag_num() == 133) {
             try {
                 std::shared_ptr<dot11_ie_133_cisco_ccx> ccx1(new dot11_ie_133_cisco_ccx());
-                ccx1->parse(ie_tag->tag_data_stream());
+                ccx1->parse(ie_tag.tag_data_stream());
                 packinfo->beacon_info = munge_to_printable(ccx1->ap_name());
             } catch (const std::exception& e) {
                 // fprintf(stderr, "debug - ccx error %s\n", e.what());
@@ -1873,13 +1881,13 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             continue;
         }
 
-        if (ie_tag->tag_num() == 127) {
-            if (ie_tag->tag_len() > 10) {
+        if (ie_tag.tag_num() == 127) {
+            if (ie_tag.tag_len() > 10) {
                 std::string al = fmt::format("IEEE80211 Access Point BSSID {} sent a beacon with "
                     "an invalid IE 127 Extended Capabilities tag; this may indicate attempts to "
                     "exploit Qualcomm drivers using the CVE-2019-10539 vulnerability.  Extended "
                     "capability tags should typically have 10-11 bytes, but saw {}.",
-                    packinfo->bssid_mac, ie_tag->tag_len());
+                    packinfo->bssid_mac, ie_tag.tag_len());
 
                 alertracker->raise_alert(alert_qcom_extended_ref, in_pack, 
                         packinfo->bssid_mac, packinfo->source_mac, 
@@ -1891,10 +1899,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
 
         // IE 191 VHT Capabilities TODO compbine with VHT OP to derive actual usable
         // rate
-        if (ie_tag->tag_num() == 191) {
+        if (ie_tag.tag_num() == 191) {
             try {
                 std::shared_ptr<dot11_ie_191_vht_cap> vht(new dot11_ie_191_vht_cap());
-                vht->parse(ie_tag->tag_data_stream());
+                vht->parse(ie_tag.tag_data_stream());
 
                 bool gi80 = vht->vht_cap_80mhz_shortgi();
                 bool gi160 = vht->vht_cap_160mhz_shortgi();
@@ -1969,11 +1977,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
 
 
         // Vendor 150 collection
-        if (ie_tag->tag_num() == 150) {
+        if (ie_tag.tag_num() == 150) {
             try {
                 auto vendor = std::make_shared<dot11_ie_150_vendor>();
-                ie_tag->tag_data_stream()->seek(0);
-                vendor->parse(ie_tag->tag_data_stream());
+                vendor->parse(ie_tag.tag_data_stream());
 
                 if (vendor->vendor_oui_int() == dot11_ie_150_cisco_powerlevel::cisco_oui()) {
                     auto ccx_power = std::make_shared<dot11_ie_150_cisco_powerlevel>();
@@ -1988,10 +1995,10 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
         }
 
         // IE 192 VHT Operation
-        if (ie_tag->tag_num() == 192) {
+        if (ie_tag.tag_num() == 192) {
             try {
                 auto vht = std::make_shared<dot11_ie_192_vht_op>();
-                vht->parse(ie_tag->tag_data_stream());
+                vht->parse(ie_tag.tag_data_stream());
                 packinfo->dot11vht = vht;
 
             } catch (const std::exception& e) {
@@ -2002,17 +2009,16 @@ int kis_80211_phy::packet_dot11_ie_dissector(kis_packet *in_pack, dot11_packinfo
             continue;
         }
 
-        if (ie_tag->tag_num() == 221) {
+        if (ie_tag.tag_num() == 221) {
             try {
                 auto vendor = std::make_shared<dot11_ie_221_vendor>();
-                ie_tag->tag_data_stream()->seek(0);
-                vendor->parse(ie_tag->tag_data_stream());
+                vendor->parse(ie_tag.tag_data_stream());
 
                 // Match mis-sized WMM
                 if (packinfo->subtype == packet_sub_beacon &&
                         vendor->vendor_oui_int() == 0x0050f2 &&
                         vendor->vendor_oui_type() == 2 &&
-                        ie_tag->tag_data().length() > 24) {
+                        ie_tag.tag_len() > 24) {
 
                     std::string al = "IEEE80211 Access Point BSSID " + 
                         packinfo->bssid_mac.mac_to_string() + " sent association "
@@ -2779,11 +2785,10 @@ std::shared_ptr<dot11_tracked_eapol>
                 std::shared_ptr<dot11_ie> ietags(new dot11_ie());
                 ietags->parse(rsnkey->wpa_key_data_stream());
 
-                for (auto ie_tag : *(ietags->tags())) {
-                    if (ie_tag->tag_num() == 221) {
+                for (const auto& ie_tag : ietags->tags()) {
+                    if (ie_tag.tag_num() == 221) {
                         auto vendor = std::make_shared<dot11_ie_221_vendor>();
-                        ie_tag->tag_data_stream()->seek(0);
-                        vendor->parse(ie_tag->tag_data_stream());
+                        vendor->parse(ie_tag.tag_data_stream());
 
                         if (vendor->vendor_oui_int() == dot11_ie_221_rsn_pmkid::vendor_oui() &&
                                 vendor->vendor_oui_type() == dot11_ie_221_rsn_pmkid::rsnpmkid_subtype()) {
@@ -0,0 +1,141 @@
+/*
+    This file is part of Kismet
+
+    Kismet is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation; either version 2 of the License, or
+    (at your option) any later version.
+
+    Kismet is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with Kismet; if not, write to the Free Software
+    Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+*/
+
+// Compares the windows returned by the view sort index against the full sort the
+// view falls back to (device_tracker_view::device_endpoint_handler), for both
+// directions, with and without a minimum, and with devices missing the sort field.
+
+#include "config.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "devicetracker_view_index.h"
+
+typedef device_tracker_view_sort_index::sort_value sort_value;
+
+struct test_device {
+    unsigned int id;
+    bool missing;
+    double num;
+};
+
+static int failures = 0;
+
+// The comparator of the full sort, with a missing field standing in for a null element
+static std::vector<test_device> full_sort(std::vector<test_device> devices, int in_order_direction,
+        bool use_min, double min) {
+
+    if (use_min) {
+        devices.erase(std::remove_if(devices.begin(), devices.end(),
+                    [&](const test_device& d) { return d.missing || d.num < min; }),
+                devices.end());
+    }
+
+    std::stable_sort(devices.begin(), devices.end(),
+            [&](const test_device& a, const test_device& b) -> bool {
+                if (a.missing)
+                    return in_order_direction == 0;
+
+                if (b.missing)
+                    return in_order_direction != 0;
+
+                if (in_order_direction == 0)
+                    return a.num < b.num;
+
+                return b.num < a.num;
+            });
+
+    return devices;
+}
+
+static void check_window(const std::vector<test_device>& devices,
+        const std::map<sort_value, test_device>& ordered, int in_order_direction,
+        size_t start, size_t len, bool use_min, double min) {
+
+    auto sorted = full_sort(devices, in_order_direction, use_min, min);
+
+    std::vector<test_device> window;
+    auto filtered_sz = device_tracker_view_sort_index::walk_window(ordered, in_order_direction != 0,
+            start, len, window, use_min, min);
+
+    std::vector<test_device> expected;
+    for (size_t i = start; i < sorted.size() && (len == 0 || i < start + len); i++)
+        expected.push_back(sorted[i]);
+
+    bool ok = filtered_sz == sorted.size() && window.size() == expected.size();
+
+    // Devices with equal values may come back in either order; only the keys have to match
+    for (size_t i = 0; ok && i < window.size(); i++) {
+        if (window[i].missing != expected[i].missing ||
+                (!window[i].missing && window[i].num != expected[i].num))
+            ok = false;
+    }
+
+    if (!ok) {
+        fprintf(stderr, "FAIL: direction %d start %zu len %zu min %s%f: got %zu/%zu devices, "
+                "expected %zu/%zu\n", in_order_direction, start, len, use_min ? "" : "(unused) ",
+                min, window.size(), filtered_sz, expected.size(), sorted.size());
+        failures++;
+    }
+}
+
+int main(void) {
+    std::mt19937 rng(1);
+
+    for (unsigned int round = 0; round < 50; round++) {
+        std::vector<test_device> devices;
+        std::map<sort_value, test_device> ordered;
+
+        unsigned int n_devices = rng() % 200;
+
+        for (unsigned int i = 0; i < n_devices; i++) {
+            test_device d;
+            d.id = i;
+            d.missing = (rng() % 8) == 0;
+            d.num = d.missing ? 0 : (double) (rng() % 50);
+
+            devices.push_back(d);
+            ordered.emplace(sort_value{d.missing, d.num, "", i}, d);
+        }
+
+        for (int direction = 0; direction < 2; direction++) {
+            check_window(devices, ordered, direction, 0, 0, false, 0);
+            check_window(devices, ordered, direction, 0, 0, true, 25);
+
+            for (unsigned int w = 0; w < 10; w++) {
+                size_t start = rng() % (n_devices + 10);
+                size_t len = rng() % 30;
+                double min = (double) (rng() % 60);
+
+                check_window(devices, ordered, direction, start, len, false, 0);
+                check_window(devices, ordered, direction, start, len, true, min);
+            }
+        }
+    }
+
+    if (failures) {
+        fprintf(stderr, "%d sort window checks failed\n", failures);
+        return 1;
+    }
+
+    printf("Sort windows match the full sort\n");
+    return 0;
+}
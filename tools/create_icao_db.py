@@ -4,16 +4,67 @@
 # to generate the aircraft ICAO database.
 # 
 # Used during Kismet release tagging to generate the aircraft db
+#
+# The text database is printed to stdout.  With --bin, a prebuilt lookup table is
+# also written, which Kismet can map directly instead of indexing the text file.
+# With --convert, the lookup table is generated from an existing text database
+# instead of downloading the registries.
 
+import argparse
 import csv
-import requests
-import urllib3
+import gzip
 import io
 import zipfile
 
 import os
 import sys
 
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from kismet_lookup_db import write_lookup_db
+
+parser = argparse.ArgumentParser(description="Generate the Kismet ADSB ICAO database")
+parser.add_argument("--bin", dest="binfile", help="also write a lookup table to this file")
+parser.add_argument("--convert", dest="convert", help="read an existing text database (optionally gzipped) instead of downloading")
+args = parser.parse_args()
+
+if args.convert is not None and args.binfile is None:
+    parser.error("--convert requires --bin")
+
+# ICAO, [CALL, TYPE, MODEL, OWNER, ATYPE]
+records = []
+
+def add_record(icao, fields):
+    if len(icao) == 0:
+        return
+
+    try:
+        records.append((int(icao, 16), [f.strip('"') for f in fields]))
+    except ValueError:
+        print("Invalid ICAO '{}', skipping lookup table entry".format(icao), file=sys.stderr)
+
+if args.convert is not None:
+    opener = gzip.open if args.convert.endswith(".gz") else open
+
+    with opener(args.convert, "rt", encoding="UTF-8", errors="replace") as f:
+        for l in f:
+            if len(l) == 0 or l[0] == '#':
+                continue
+
+            fields = l.rstrip("\r\n").split("\t")
+
+            if len(fields) != 6:
+                print("Invalid ICAO entry, skipping: {}".format(l.rstrip()), file=sys.stderr)
+                continue
+
+            add_record(fields[0], fields[1:])
+
+    n = write_lookup_db(args.binfile, "ICAO", records)
+    print("Wrote {} ICAO records to {}".format(n, args.binfile), file=sys.stderr)
+    sys.exit(0)
+
+import requests
+import urllib3
+
 # Kluge up request lib because the canadian server later in the script has an invalid DH key
 requests.packages.urllib3.disable_warnings()
 requests.packages.urllib3.util.ssl_.DEFAULT_CIPHERS += ':HIGH:!DH:!aNULL'
@@ -60,6 +111,8 @@ with requests.get("http://registry.faa.gov/database/ReleasableAircraft.zip") as
             # ICAO, CALL, TYPE, MODEL, OWNER, ATYPE
             try:
                 if row[0] in res.keys():
+                    add_record(row[33].rstrip().lower(),
+                            [row[0], mdl[row[2]], acft[row[2]], res[row[0]].rstrip(), row[18]])
                     print("{}\t{}\t{}\t\"{}\"\t\"{}\"\t{}".format(
                         row[33].rstrip().lower(),
                         row[0],
@@ -68,6 +121,8 @@ with requests.get("http://registry.faa.gov/database/ReleasableAircraft.zip") as
                         res[row[0]].rstrip(),
                         row[18]))
                 else:
+                    add_record(row[33].rstrip().lower(),
+                            [row[0], mdl[row[2]], acft[row[2]], row[6].rstrip(), row[18]])
                     print("{}\t{}\t{}\t\"{}\"\t\"{}\"\t{}".format(
                         row[33].rstrip().lower(),
                         row[0],
@@ -116,6 +171,9 @@ with requests.get("https://wwwapps.tc.gc.ca/Saf-Sec-Sur/2/CCARCS-RIACC/download/
             elif (row[10] == "Ornithopter"):
                 type="O"
 
+            add_record(str(hex(int(row[42],2)))[2:],
+                    ["C-" + row[0].lstrip(), row[4], row[7], owner[row[0].lstrip()], type])
+
             print("{}\tC-{}\t{}\t\"{}\"\t\"{}\"\t{}".format(
                     str(hex(int(row[42],2)))[2:],
                     row[0].lstrip(),
@@ -124,3 +182,9 @@ with requests.get("https://wwwapps.tc.gc.ca/Saf-Sec-Sur/2/CCARCS-RIACC/download/
                     owner[row[0].lstrip()],
                     type))
 
+if args.binfile is not None:
+    # The text database is sorted by line; match it so the same record wins for
+    # duplicate ICAOs
+    records.sort(key=lambda r: (r[0], "\t".join(r[1])))
+    n = write_lookup_db(args.binfile, "ICAO", records)
+    print("Wrote {} ICAO records to {}".format(n, args.binfile), file=sys.stderr)
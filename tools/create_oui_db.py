@@ -1,33 +1,78 @@
 #!/usr/bin/env python3
 
+# Generates the OUI manufacturer database from the IEEE registry, printing the
+# text database to stdout.  With --bin, also writes a prebuilt lookup table,
+# which Kismet can map directly instead of indexing the text file.
+#
+# With --convert, the lookup table is generated from an existing text database
+# instead of downloading the registry.
+
 from __future__ import print_function
+import argparse
+import gzip
 import os
 import sys
 import re
-import requests
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+from kismet_lookup_db import write_lookup_db
+
+parser = argparse.ArgumentParser(description="Generate the Kismet OUI database")
+parser.add_argument("--bin", dest="binfile", help="also write a lookup table to this file")
+parser.add_argument("--convert", dest="convert", help="read an existing text database (optionally gzipped) instead of downloading")
+args = parser.parse_args()
+
+if args.convert is not None and args.binfile is None:
+    parser.error("--convert requires --bin")
 
 manufs = []
+records = []
+
+if args.convert is not None:
+    opener = gzip.open if args.convert.endswith(".gz") else open
+
+    with opener(args.convert, "rt", encoding="UTF-8", errors="replace") as f:
+        for l in f:
+            l = l.rstrip("\r\n")
+
+            if len(l) < 10 or l[0] == '#':
+                continue
+
+            try:
+                oui = int(l[0:8].replace(":", ""), 16)
+            except ValueError:
+                continue
+
+            records.append((oui, [l[9:]]))
+else:
+    import requests
+
+    # Original IEEE URI
+    # OUIURI = "http://standards-oui.ieee.org/oui.txt"
+
+    # Sanitized and cleaned up maintained version
+    OUIURI = "http://linuxnet.ca/ieee/oui.txt"
+
+    with requests.get(OUIURI) as r:
+        for rl in r.iter_lines():
+            l = rl.decode('UTF-8')
+            p = re.compile("([0-9A-F]{2}-[0-9A-F]{2}-[0-9A-F]{2}) +\(hex\)\t+(.*)")
+            m = p.match(l)
 
-# Original IEEE URI
-# OUIURI = "http://standards-oui.ieee.org/oui.txt"
+            if m is not None and len(m.groups()) == 2:
+                oui = m.group(1).replace("-", ":")
+                manufs.append("{}\t{}".format(oui, m.group(2)))
+                records.append((int(m.group(1).replace("-", ""), 16), [m.group(2)]))
 
-# Sanitized and cleaned up maintained version
-OUIURI = "http://linuxnet.ca/ieee/oui.txt"
+    print("Parsed {} manufs".format(len(manufs)), file=sys.stderr)
 
-with requests.get(OUIURI) as r:
-    for rl in r.iter_lines():
-        l = rl.decode('UTF-8')
-        p = re.compile("([0-9A-F]{2}-[0-9A-F]{2}-[0-9A-F]{2}) +\(hex\)\t+(.*)")
-        m = p.match(l)
-        
-        if m is not None and len(m.groups()) == 2:
-            oui = m.group(1).replace("-", ":")
-            manufs.append("{}\t{}".format(oui, m.group(2)))
+    manufs.sort()
+    records.sort()
 
-print("Parsed {} manufs".format(len(manufs)), file=sys.stderr)
+    for m in manufs:
+        print(m)
 
-manufs.sort()
+if args.binfile is not None:
+    n = write_lookup_db(args.binfile, "OUI", records)
+    print("Wrote {} OUI records to {}".format(n, args.binfile), file=sys.stderr)
 
-for m in manufs:
-    print(m)
-    
@@ -0,0 +1,83 @@
+#!/usr/bin/env python3
+
+# Writes prebuilt lookup tables (such as the OUI and ICAO databases) which Kismet
+# maps and searches in place; see kis_lookup_db.h for the format.
+#
+# Used by create_oui_db.py and create_icao_db.py
+
+import os
+import struct
+import tempfile
+
+MAGIC = b"KLDB"
+VERSION = 1
+
+def write_lookup_db(fname, tag, records):
+    """
+    Write a lookup table.
+
+    tag     table type, up to 4 characters (such as "OUI" or "ICAO")
+    records list of (key, [field strings]); keys are 32 bit, every record must
+            have the same number of fields, and the first record for a key wins
+    """
+
+    by_key = {}
+    num_fields = None
+
+    for (key, fields) in records:
+        if num_fields is None:
+            num_fields = len(fields)
+        elif len(fields) != num_fields:
+            raise ValueError("record {:x} has {} fields, expected {}".format(key, len(fields), num_fields))
+
+        if key < 0 or key > 0xFFFFFFFF:
+            raise ValueError("record key {} out of range".format(key))
+
+        if key not in by_key:
+            by_key[key] = fields
+
+    if num_fields is None:
+        num_fields = 0
+
+    # Strings are shared between records; offset 0 is always the empty string
+    strings = bytearray(b"\0")
+    string_offsets = {"": 0}
+
+    def string_offset(s):
+        if s not in string_offsets:
+            string_offsets[s] = len(strings)
+            strings.extend(s.replace("\0", "").encode("UTF-8"))
+            strings.append(0)
+
+        return string_offsets[s]
+
+    body = bytearray()
+
+    for key in sorted(by_key.keys()):
+        body.extend(struct.pack("<I", key))
+
+        for f in by_key[key]:
+            body.extend(struct.pack("<I", string_offset(f)))
+
+    # A running Kismet maps the installed table; writing over it in place would change
+    # (or truncate) the pages under it, so write a new file and rename it into place
+    (fd, tmpname) = tempfile.mkstemp(dir=os.path.dirname(os.path.abspath(fname)),
+            prefix=".{}.".format(os.path.basename(fname)))
+
+    try:
+        with os.fdopen(fd, "wb") as f:
+            f.write(MAGIC)
+            f.write(struct.pack("<I", VERSION))
+            f.write(tag.encode("ascii")[:4].ljust(4, b"\0"))
+            f.write(struct.pack("<III", len(by_key), num_fields, len(strings)))
+            f.write(body)
+            f.write(strings)
+
+        os.chmod(tmpname, 0o644)
+        os.replace(tmpname, fname)
+    except:
+        os.unlink(tmpname)
+        raise
+
+    return len(by_key)
+
@@ -19,6 +19,7 @@
 #include "config.h"
 
 #include "trackedcomponent.h"
+#include "xxhash.h"
 
 std::string tracker_component::get_name() {
     return Globalreg::globalreg->entrytracker->get_field_name(get_id());
@@ -50,6 +51,9 @@ void tracker_component::reserve_fields(std::shared_ptr<tracker_element_map> e) {
     if (registered_fields == nullptr)
         return;
 
+    // Grow the field storage once for this level of the component
+    map.reserve(map.size() + registered_fields->size());
+
     for (auto& rf : *registered_fields) {
         if (rf->assign != nullptr) {
             // We use negative IDs to indicate dynamic to eke out 4 more bytes
@@ -143,3 +147,78 @@ shared_tracker_element tracker_component::get_child_path(const std::vector<std::
     return next_elem;
 }
 
+
+void tracker_component::collect_changes(tracker_component_delta& state,
+        const tracker_component_delta::packer_t& packer,
+        std::vector<tracker_component_delta::change>& changes,
+        unsigned int max_depth) {
+
+    state.generation++;
+
+    std::vector<int> path;
+    std::string scratch;
+
+    collect_map_changes(this, path, 0, state, packer, changes, max_depth, scratch);
+
+    // Anything we didn't see this pass has been removed
+    for (auto fi = state.fields.begin(); fi != state.fields.end(); ) {
+        if (fi->second.generation != state.generation) {
+            changes.push_back(tracker_component_delta::change{fi->second.path, "", true});
+            fi = state.fields.erase(fi);
+        } else {
+            ++fi;
+        }
+    }
+}
+
+void tracker_component::collect_map_changes(tracker_element_map *m, 
+        std::vector<int>& path, uint64_t path_hash,
+        tracker_component_delta& state,
+        const tracker_component_delta::packer_t& packer,
+        std::vector<tracker_component_delta::change>& changes,
+        unsigned int depth, std::string& scratch) {
+
+    for (const auto& fi : *m) {
+        // Unset dynamic fields aren't part of the record
+        if (fi.second == nullptr)
+            continue;
+
+        path.push_back(fi.first);
+
+        int id = fi.first;
+        auto fhash = XXH64(&id, sizeof(id), path_hash);
+
+        if (depth > 1 && fi.second->get_type() == tracker_type::tracker_map) {
+            // Let nested components update any derived fields first
+            fi.second->pre_serialize();
+            collect_map_changes(static_cast<tracker_element_map *>(fi.second.get()),
+                    path, fhash, state, packer, changes, depth - 1, scratch);
+            fi.second->post_serialize();
+            path.pop_back();
+            continue;
+        }
+
+        scratch.clear();
+        packer(fi.second, scratch);
+
+        auto vhash = XXH64(scratch.data(), scratch.length(), 0);
+
+        auto si = state.fields.find(fhash);
+
+        if (si == state.fields.end()) {
+            state.fields.emplace(fhash, 
+                    tracker_component_delta::field_state{vhash, state.generation, path});
+            changes.push_back(tracker_component_delta::change{path, scratch, false});
+        } else {
+            si->second.generation = state.generation;
+
+            if (si->second.hash != vhash) {
+                si->second.hash = vhash;
+                changes.push_back(tracker_component_delta::change{path, scratch, false});
+            }
+        }
+
+        path.pop_back();
+    }
+}
+
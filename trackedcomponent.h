@@ -29,6 +29,8 @@
 
 #include <vector>
 #include <map>
+#include <functional>
+#include <unordered_map>
 
 #include <memory>
 
@@ -39,6 +41,48 @@
 #include "json/json.h"
 
 
+// Fingerprints of the fields of a component as of the last flush, used to find the
+// fields which changed since.  Each field is packed and hashed as the component is
+// walked, so a field is dirty whenever its content changed, no matter how it was
+// modified; nested maps are walked field by field up to a depth, and anything below
+// that (or any other container) is treated as a single field.
+class tracker_component_delta {
+public:
+    // Pack a field into a string for hashing and output
+    using packer_t = std::function<void (const shared_tracker_element&, std::string&)>;
+
+    struct change {
+        std::vector<int> path;
+        // Packed value; empty if the field was removed
+        std::string value;
+        bool removed;
+    };
+
+    tracker_component_delta() :
+        generation{0} { }
+
+    void clear() {
+        fields.clear();
+        generation = 0;
+    }
+
+    size_t size() const {
+        return fields.size();
+    }
+
+protected:
+    friend class tracker_component;
+
+    struct field_state {
+        uint64_t hash;
+        uint32_t generation;
+        std::vector<int> path;
+    };
+
+    std::unordered_map<uint64_t, field_state> fields;
+    uint32_t generation;
+};
+
 // Complex trackable unit based on trackertype dataunion.
 //
 // All tracker_components are built from maps.
@@ -794,7 +838,22 @@ public:
     shared_tracker_element get_child_path(const std::string& in_path);
     shared_tracker_element get_child_path(const std::vector<std::string>& in_path);
 
+    // Find the fields which changed since the last call with the same delta state, and
+    // update the state.  Nested maps are descended up to max_depth levels.  The caller
+    // is responsible for locking the component.
+    void collect_changes(tracker_component_delta& state, 
+            const tracker_component_delta::packer_t& packer,
+            std::vector<tracker_component_delta::change>& changes,
+            unsigned int max_depth = 3);
+
 protected:
+    static void collect_map_changes(tracker_element_map *m, 
+            std::vector<int>& path, uint64_t path_hash,
+            tracker_component_delta& state, 
+            const tracker_component_delta::packer_t& packer,
+            std::vector<tracker_component_delta::change>& changes,
+            unsigned int depth, std::string& scratch);
+
     // Register a field via the entrytracker, using standard entrytracker build methods.
     // This field will be automatically assigned or created during the reservefields 
     // stage.
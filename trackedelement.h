@@ -40,6 +40,7 @@
 
 #include "fmt.h"
 
+#include "kis_flat_map.h"
 #include "kis_mutex.h"
 #include "macaddr.h"
 #include "uuid.h"
@@ -282,6 +283,10 @@ public:
         return "";
     }
 
+    bool has_local_name() const {
+        return local_name != nullptr && local_name->length() != 0;
+    }
+
     void set_dynamic_entity(const std::string& in_name) {
         set_local_name(in_name);
         set_id(adler32_checksum(in_name));
@@ -1125,9 +1130,10 @@ using tracker_element_double = tracker_element_core_numeric<double, tracker_type
 
 
 
-// Superclass for generic access to maps via multiple key structures; use a std::map tree
-// map;  alternate implementation available as core_unordered_map for structures which don't
-// need comparator operations
+// Superclass for generic access to maps via multiple key structures; the container is
+// a template parameter.  Component field maps (tracker_element_map) use the kis_flat_map
+// sorted vector, mac maps use a std::map tree, and the other keyed maps use unordered
+// maps since they don't need comparator operations
 template <typename MT, typename K, typename V, tracker_type T>
 class tracker_element_core_map : public tracker_element {
 public:
@@ -1302,17 +1308,20 @@ protected:
     uint8_t present_set;
 };
 
-// Dictionary / map-by-id
-class tracker_element_map : public tracker_element_core_map<std::unordered_map<int, std::shared_ptr<tracker_element>>, int, std::shared_ptr<tracker_element>, tracker_type::tracker_map> {
+// Dictionary / map-by-id; backed by a sorted vector since maps are typically
+// tracked components with a small, fixed set of fields.  Fields iterate, and so
+// serialize, in order of field id; the order was unspecified when this was an
+// unordered map, and clients must still look fields up by name.
+class tracker_element_map : public tracker_element_core_map<kis_flat_map<int, std::shared_ptr<tracker_element>>, int, std::shared_ptr<tracker_element>, tracker_type::tracker_map> {
 public:
     tracker_element_map() :
-        tracker_element_core_map<std::unordered_map<int, std::shared_ptr<tracker_element>>, int, std::shared_ptr<tracker_element>, tracker_type::tracker_map>() { }
+        tracker_element_core_map<kis_flat_map<int, std::shared_ptr<tracker_element>>, int, std::shared_ptr<tracker_element>, tracker_type::tracker_map>() { }
 
     tracker_element_map(int id) :
-        tracker_element_core_map<std::unordered_map<int, std::shared_ptr<tracker_element>>, int, std::shared_ptr<tracker_element>, tracker_type::tracker_map>(id) { }
+        tracker_element_core_map<kis_flat_map<int, std::shared_ptr<tracker_element>>, int, std::shared_ptr<tracker_element>, tracker_type::tracker_map>(id) { }
 
     tracker_element_map(const tracker_element_map *p) :
-        tracker_element_core_map<std::unordered_map<int, std::shared_ptr<tracker_element>>, int, std::shared_ptr<tracker_element>, tracker_type::tracker_map>(p) { }
+        tracker_element_core_map<kis_flat_map<int, std::shared_ptr<tracker_element>>, int, std::shared_ptr<tracker_element>, tracker_type::tracker_map>(p) { }
 
     shared_tracker_element get_sub(int id) {
         auto v = map.find(id);
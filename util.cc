@@ -31,6 +31,10 @@
 #include <cctype>
 #include <string>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
 
 #ifdef HAVE_LIBUTIL_H
 # include <libutil.h>
@@ -776,6 +780,201 @@ unsigned int crc32_le_80211(unsigned int *crc32_table, const unsigned char *buf,
 	return crc;
 }
 
+// Slicing-by-8 tables for the reflected IEEE 802.3 polynomial, generated on
+// first use
+static uint32_t crc32_80211_slice_table[8][256];
+
+static void crc32_80211_init_slice_table() {
+    for (unsigned int i = 0; i < 256; i++) {
+        uint32_t crc = i;
+
+        for (unsigned int j = 0; j < 8; j++)
+            crc = (crc & 1) ? (crc >> 1) ^ IEEE_802_3_CRC32_POLY : (crc >> 1);
+
+        crc32_80211_slice_table[0][i] = crc;
+    }
+
+    for (unsigned int i = 0; i < 256; i++) {
+        for (unsigned int t = 1; t < 8; t++) {
+            uint32_t prev = crc32_80211_slice_table[t - 1][i];
+            crc32_80211_slice_table[t][i] = 
+                (prev >> 8) ^ crc32_80211_slice_table[0][prev & 0xFF];
+        }
+    }
+}
+
+static uint32_t crc32_80211_slice8(uint32_t crc, const uint8_t *buf, size_t len) {
+    const auto& t = crc32_80211_slice_table;
+
+    while (len >= 8) {
+        uint32_t lo, hi;
+        memcpy(&lo, buf, 4);
+        memcpy(&hi, buf + 4, 4);
+
+#ifdef WORDS_BIGENDIAN
+        lo = __builtin_bswap32(lo);
+        hi = __builtin_bswap32(hi);
+#endif
+
+        lo ^= crc;
+
+        crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^
+            t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+            t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+            t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+
+        buf += 8;
+        len -= 8;
+    }
+
+    while (len--)
+        crc = (crc >> 8) ^ t[0][(crc ^ *buf++) & 0xFF];
+
+    return crc;
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+// Carry-less multiply folding of 64 byte blocks, per the Intel "Fast CRC 
+// Computation for Generic Polynomials Using PCLMULQDQ" paper; constants are for
+// the bit-reflected 802.3 polynomial.  Requires at least 64 bytes; the remainder
+// under 16 bytes is finished with the slicing tables.
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t crc32_80211_pclmul(uint32_t crc, const uint8_t *buf, size_t len) {
+    if (len < 64)
+        return crc32_80211_slice8(crc, buf, len);
+
+    alignas(16) static const uint64_t k1k2[] = { 0x0154442bd4, 0x01c6e41596 };
+    alignas(16) static const uint64_t k3k4[] = { 0x01751997d0, 0x00ccaa009e };
+    alignas(16) static const uint64_t k5k0[] = { 0x0163cd6124, 0x0000000000 };
+    alignas(16) static const uint64_t poly[] = { 0x01db710641, 0x01f7011641 };
+
+    __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8, y5, y6, y7, y8;
+
+    x1 = _mm_loadu_si128((const __m128i *) (buf + 0x00));
+    x2 = _mm_loadu_si128((const __m128i *) (buf + 0x10));
+    x3 = _mm_loadu_si128((const __m128i *) (buf + 0x20));
+    x4 = _mm_loadu_si128((const __m128i *) (buf + 0x30));
+
+    x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128(crc));
+
+    x0 = _mm_load_si128((const __m128i *) k1k2);
+
+    buf += 64;
+    len -= 64;
+
+    // Fold four 128 bit lanes in parallel
+    while (len >= 64) {
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+        x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+        x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+        x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+        x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+
+        y5 = _mm_loadu_si128((const __m128i *) (buf + 0x00));
+        y6 = _mm_loadu_si128((const __m128i *) (buf + 0x10));
+        y7 = _mm_loadu_si128((const __m128i *) (buf + 0x20));
+        y8 = _mm_loadu_si128((const __m128i *) (buf + 0x30));
+
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x5), y5);
+        x2 = _mm_xor_si128(_mm_xor_si128(x2, x6), y6);
+        x3 = _mm_xor_si128(_mm_xor_si128(x3, x7), y7);
+        x4 = _mm_xor_si128(_mm_xor_si128(x4, x8), y8);
+
+        buf += 64;
+        len -= 64;
+    }
+
+    // Fold the four lanes into one
+    x0 = _mm_load_si128((const __m128i *) k3k4);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x3), x5);
+
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x4), x5);
+
+    // Fold any remaining 16 byte blocks
+    while (len >= 16) {
+        x2 = _mm_loadu_si128((const __m128i *) buf);
+
+        x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+        x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+        x1 = _mm_xor_si128(_mm_xor_si128(x1, x2), x5);
+
+        buf += 16;
+        len -= 16;
+    }
+
+    // Fold 128 bits to 64 bits
+    x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+    x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+    x1 = _mm_srli_si128(x1, 8);
+    x1 = _mm_xor_si128(x1, x2);
+
+    x0 = _mm_loadl_epi64((const __m128i *) k5k0);
+
+    x2 = _mm_srli_si128(x1, 4);
+    x1 = _mm_and_si128(x1, x3);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    // Barrett reduction to 32 bits
+    x0 = _mm_load_si128((const __m128i *) poly);
+
+    x2 = _mm_and_si128(x1, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+    x2 = _mm_and_si128(x2, x3);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x1 = _mm_xor_si128(x1, x2);
+
+    crc = (uint32_t) _mm_extract_epi32(x1, 1);
+
+    return crc32_80211_slice8(crc, buf, len);
+}
+#endif
+
+typedef uint32_t (*crc32_80211_func)(uint32_t, const uint8_t *, size_t);
+
+struct crc32_80211_impl {
+    crc32_80211_func func;
+    const char *name;
+};
+
+static crc32_80211_impl crc32_80211_select() {
+    crc32_80211_init_slice_table();
+
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"))
+        return { crc32_80211_pclmul, "pclmul" };
+#endif
+
+    return { crc32_80211_slice8, "slicing-by-8" };
+}
+
+static const crc32_80211_impl& crc32_80211_selected() {
+    static const crc32_80211_impl impl = crc32_80211_select();
+    return impl;
+}
+
+uint32_t crc32_80211(const uint8_t *buf, size_t len) {
+    return crc32_80211_selected().func(0xFFFFFFFF, buf, len) ^ 0xFFFFFFFF;
+}
+
+const char *crc32_80211_impl_name() {
+    return crc32_80211_selected().name;
+}
+
 void subtract_timeval(struct timeval *in_tv1, struct timeval *in_tv2,
 					 struct timeval *out_tv) {
 	if (in_tv1->tv_sec < in_tv2->tv_sec ||
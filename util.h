@@ -230,6 +230,13 @@ void crc32_init_table_80211(unsigned int *crc32_table);
 unsigned int crc32_le_80211(unsigned int *crc32_table, const unsigned char *buf, 
 							int len);
 
+// Fast 802.11 FCS; the implementation (PCLMUL folding where the CPU supports it, 
+// otherwise slicing-by-8) is picked at runtime the first time it is called.
+// Returns the same value as crc32_le_80211
+uint32_t crc32_80211(const uint8_t *buf, size_t len);
+// Name of the FCS implementation selected for this CPU
+const char *crc32_80211_impl_name();
+
 
 // Simple lexer for "advanced" filter stuff and other tools
 #define _kis_lex_none			0